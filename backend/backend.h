@@ -3,11 +3,18 @@
 
 #include <cstddef>
 #include <ctime>
+#include <functional>
 #include <memory>
 #include <string>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <vector>
 
+#include "backend/inflight_tuner.h"
+#include "backend/link_stats.h"
+#include "backend/rate_limiter.h"
+#include "cache/io_priority.h"
+
 namespace cache_fs {
 
 struct FileInfo {
@@ -17,20 +24,58 @@ struct FileInfo {
     bool        is_directory = false;
 };
 
+// Called with the number of bytes received so far as a download arrives.
+using Progress = std::function<void(std::size_t received)>;
+
 class Backend {
 public:
     virtual ~Backend() = default;
     virtual int init(const std::string& base_url, const std::string& bearer_token = "") = 0;
     virtual ssize_t download(const std::string& path, char* buffer, std::size_t size, off_t offset) = 0;
+    // Reads the range starting at `offset` into the slices in turn. This
+    // default makes one request per slice.
+    virtual ssize_t stream(const std::string& path, const iovec* iov, int iovcnt, off_t offset,
+                           const Progress& progress) {
+        std::size_t total = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            ssize_t got = download(path, static_cast<char*>(iov[i].iov_base), iov[i].iov_len, offset + total);
+            if (got < 0) return total ? static_cast<ssize_t>(total) : got;
+            total += static_cast<std::size_t>(got);
+            if (got && progress) progress(total);
+            if (static_cast<std::size_t>(got) < iov[i].iov_len) break;
+        }
+        return static_cast<ssize_t>(total);
+    }
     virtual ssize_t upload(const std::string& path, const char* buffer, std::size_t size, off_t offset) = 0;
     virtual int remove(const std::string& path) = 0;
 };
 
 std::shared_ptr<Backend> create_backend(const std::string& url);
 
-ssize_t backend_read_range(const std::string& path, char* buf, std::size_t len, off_t off);
-ssize_t backend_put_range (const std::string& path, const char* buf, std::size_t len, off_t off);
-int     backend_delete    (const std::string& path);
+// Requests wait for their traffic class's rate limit, then go through a
+// queue that runs a few at a time, most urgent class first.
+ssize_t backend_read_range(const std::string& path, char* buf, std::size_t len, off_t off,
+                           IoPriority prio = IoPriority::kDemand, const Progress& progress = nullptr);
+// Scatters one range across the slices, as one request.
+ssize_t backend_read_range(const std::string& path, const iovec* iov, int iovcnt, off_t off,
+                           IoPriority prio = IoPriority::kDemand, const Progress& progress = nullptr);
+ssize_t backend_put_range (const std::string& path, const char* buf, std::size_t len, off_t off,
+                           IoPriority prio = IoPriority::kWriteBack);
+int     backend_delete    (const std::string& path, IoPriority prio = IoPriority::kBackground);
+
+// A metadata lookup (/api/info, /api/list) on `api`, limited as
+// TrafficClass::kMetadata; its bytes are charged once they arrive.
+ssize_t backend_read_metadata(Backend& api, const std::string& path, char* buf, std::size_t len);
+
+// Limits a class from now on; a zero rate is unlimited, the default.
+void          backend_set_rate_limit(TrafficClass cls, const RateLimit& limit);
+ThrottleStats backend_throttle_stats(TrafficClass cls);
+
+// Measured over the range reads so far, from the time each was admitted.
+LinkEstimate backend_link_estimate();
+
+// How many requests run at once, retuned after every range read.
+InflightStats backend_inflight_stats();
 
 }
 
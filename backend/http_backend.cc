@@ -1,9 +1,11 @@
 #include "backend/backend.h"
+#include "backend/request_queue.h"
 
 #define ENABLE_PUT
 
 #include <curl/curl.h>
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <mutex>
 #include <memory>
@@ -12,20 +14,34 @@ namespace cache_fs {
 
 namespace {
 
+// Fills the slices in order; bytes past the last are dropped.
 struct SliceWriter {
-    char*  dst;
-    size_t cap;
-    size_t pos;
+    const iovec*    iov;
+    int             iovcnt;
+    int             cur;
+    size_t          at;      // bytes in iov[cur]
+    size_t          pos;     // bytes in all slices
+    const Progress* progress;
 };
 
 size_t write_slice_cb(void* ptr, size_t sz, size_t nm, void* ud) {
     auto* sw   = static_cast<SliceWriter*>(ud);
     size_t n   = sz * nm;
-    size_t cpy = std::min(n, sw->cap - sw->pos);
-    if (cpy) {
-        memcpy(sw->dst + sw->pos, ptr, cpy);
+    const char* src = static_cast<const char*>(ptr);
+    size_t done = 0;
+    while (done < n && sw->cur < sw->iovcnt) {
+        const iovec& v = sw->iov[sw->cur];
+        size_t cpy = std::min(n - done, v.iov_len - sw->at);
+        memcpy(static_cast<char*>(v.iov_base) + sw->at, src + done, cpy);
+        done    += cpy;
+        sw->at  += cpy;
         sw->pos += cpy;
+        if (sw->at == v.iov_len) {
+            ++sw->cur;
+            sw->at = 0;
+        }
     }
+    if (done && *sw->progress) (*sw->progress)(sw->pos);
     return n;
 }
 
@@ -62,6 +78,14 @@ public:
     }
 
     ssize_t download(const std::string& path, char* buffer, std::size_t size, off_t offset) override {
+        iovec iov{buffer, size};
+        return stream(path, &iov, 1, offset, nullptr);
+    }
+
+    ssize_t stream(const std::string& path, const iovec* iov, int iovcnt, off_t offset,
+                   const Progress& progress) override {
+        std::size_t size = 0;
+        for (int i = 0; i < iovcnt; ++i) size += iov[i].iov_len;
         CURL* curl = curl_easy_init();
         if (!curl) return -1;
 
@@ -80,7 +104,7 @@ public:
         }
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdrs);
 
-        SliceWriter sw{buffer, size, 0};
+        SliceWriter sw{iov, iovcnt, 0, 0, 0, &progress};
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_slice_cb);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sw);
 
@@ -170,8 +194,23 @@ private:
 };
 
 
+// Concurrent transfers to the backend, one of them kept for demand reads;
+// tuned between the bounds from the measured link.
+static constexpr std::size_t kInitialSlots = 4;
+static constexpr std::size_t kMinSlots = 2;
+static constexpr std::size_t kMaxSlots = 16;
+
 static std::mutex g_mtx;
 static std::shared_ptr<Backend> g_backend;
+static RequestQueue g_requests(kInitialSlots);
+static LinkStats g_link;
+static InflightTuner g_tuner(kMinSlots, kMaxSlots, kInitialSlots);
+static RateLimiter g_limiter;
+
+static std::shared_ptr<Backend> current_backend() {
+    std::lock_guard<std::mutex> lk(g_mtx);
+    return g_backend;
+}
 
 std::shared_ptr<Backend> create_backend(const std::string& url) {
     auto b = std::make_shared<HttpBackend>();
@@ -181,21 +220,64 @@ std::shared_ptr<Backend> create_backend(const std::string& url) {
     return b;
 }
 
-ssize_t backend_read_range(const std::string& path, char* buf, std::size_t len, off_t off) {
-    std::lock_guard<std::mutex> lk(g_mtx);
-    if (!g_backend) return -ENODEV;
-    return g_backend->download(path, buf, len, off);
+ssize_t backend_read_range(const std::string& path, char* buf, std::size_t len, off_t off, IoPriority prio,
+                           const Progress& progress) {
+    iovec iov{buf, len};
+    return backend_read_range(path, &iov, 1, off, prio, progress);
 }
 
-ssize_t backend_put_range(const std::string& path, const char* buf, std::size_t len, off_t off) {
-    std::lock_guard<std::mutex> lk(g_mtx);
-    if (!g_backend) return -ENODEV;
-    return g_backend->upload(path, buf, len, off);
+ssize_t backend_read_range(const std::string& path, const iovec* iov, int iovcnt, off_t off, IoPriority prio,
+                           const Progress& progress) {
+    std::shared_ptr<Backend> b = current_backend();
+    if (!b) return -ENODEV;
+    std::size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i) len += iov[i].iov_len;
+    g_limiter.acquire(traffic_class(prio), len);
+    RequestQueue::Slot slot(g_requests, prio);
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point first_byte;
+    ssize_t got = b->stream(path, iov, iovcnt, off, [&](std::size_t received) {
+        if (first_byte == Clock::time_point()) first_byte = Clock::now();
+        if (progress) progress(received);
+    });
+    if (got > 0 && first_byte != Clock::time_point()) {
+        auto secs = [&](Clock::time_point t) { return std::chrono::duration<double>(t - start).count(); };
+        g_link.record(secs(first_byte), secs(Clock::now()), static_cast<std::size_t>(got));
+        g_requests.resize(g_tuner.complete(secs(first_byte), static_cast<std::size_t>(got), g_link.estimate()));
+    }
+    return got;
 }
 
-int backend_delete(const std::string& path) {
-    std::lock_guard<std::mutex> lk(g_mtx);
-    if (!g_backend) return -ENODEV;
-    return g_backend->remove(path);
+ssize_t backend_put_range(const std::string& path, const char* buf, std::size_t len, off_t off, IoPriority prio) {
+    std::shared_ptr<Backend> b = current_backend();
+    if (!b) return -ENODEV;
+    g_limiter.acquire(traffic_class(prio), len);
+    RequestQueue::Slot slot(g_requests, prio);
+    return b->upload(path, buf, len, off);
+}
+
+int backend_delete(const std::string& path, IoPriority prio) {
+    std::shared_ptr<Backend> b = current_backend();
+    if (!b) return -ENODEV;
+    g_limiter.acquire(traffic_class(prio), 0);
+    RequestQueue::Slot slot(g_requests, prio);
+    return b->remove(path);
+}
+
+ssize_t backend_read_metadata(Backend& api, const std::string& path, char* buf, std::size_t len) {
+    g_limiter.acquire(TrafficClass::kMetadata, 0);
+    ssize_t got = api.download(path, buf, len, 0);
+    if (got > 0) g_limiter.charge(TrafficClass::kMetadata, static_cast<std::size_t>(got));
+    return got;
 }
+
+void backend_set_rate_limit(TrafficClass cls, const RateLimit& limit) { g_limiter.set_limit(cls, limit); }
+
+ThrottleStats backend_throttle_stats(TrafficClass cls) { return g_limiter.stats(cls); }
+
+LinkEstimate backend_link_estimate() { return g_link.estimate(); }
+
+InflightStats backend_inflight_stats() { return g_tuner.stats(); }
+
 }
@@ -0,0 +1,59 @@
+#include "backend/inflight_tuner.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cache_fs {
+
+namespace {
+
+// A time to first byte this many times the floor, and kQueueSlackSec
+// beyond it, means requests are queueing.
+constexpr double kQueueRatio = 2.0;
+constexpr double kQueueSlackSec = 0.002;
+// The floor follows a longer round trip (a new route, a busier origin)
+// over a few hundred requests.
+constexpr double kFloorDrift = 1.0 / 256;
+constexpr double kSizeGain = 1.0 / 8;
+
+}
+
+InflightTuner::InflightTuner(std::size_t min_limit, std::size_t max_limit, std::size_t initial)
+    : min_(std::max<std::size_t>(min_limit, 1)), max_(std::max(max_limit, min_)) {
+    stats_.limit  = std::clamp(initial, min_, max_);
+    stats_.target = stats_.limit;
+}
+
+std::size_t InflightTuner::complete(double first_byte_sec, std::size_t bytes, const LinkEstimate& link) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!base_rtt_ || first_byte_sec < base_rtt_) base_rtt_ = first_byte_sec;
+    else base_rtt_ += kFloorDrift * (first_byte_sec - base_rtt_);
+    avg_bytes_ = avg_bytes_ ? avg_bytes_ + kSizeGain * (bytes - avg_bytes_) : bytes;
+    // Until the rate is known the target holds where the limit is.
+    if (link.bytes_per_sec && avg_bytes_) {
+        const double want = std::ceil(1 + link.rtt_sec * link.bytes_per_sec / avg_bytes_);
+        stats_.target = static_cast<std::size_t>(std::clamp(want, double(min_), double(max_)));
+    }
+
+    ++acked_;
+    if (first_byte_sec > base_rtt_ * kQueueRatio + kQueueSlackSec) ++queued_;
+    if (acked_ < stats_.limit) return stats_.limit;
+    if (queued_ * 2 > acked_) {
+        if (stats_.limit > min_) ++stats_.backoffs;
+        stats_.limit = std::max(min_, stats_.limit / 2);
+    } else if (stats_.limit < stats_.target) {
+        ++stats_.limit;
+    } else if (stats_.limit > stats_.target) {
+        --stats_.limit;
+    }
+    acked_  = 0;
+    queued_ = 0;
+    return stats_.limit;
+}
+
+InflightStats InflightTuner::stats() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return stats_;
+}
+
+}
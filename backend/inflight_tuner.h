@@ -0,0 +1,52 @@
+#ifndef CACHE_FS_INFLIGHT_TUNER_H
+#define CACHE_FS_INFLIGHT_TUNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "backend/link_stats.h"
+
+namespace cache_fs {
+
+struct InflightStats {
+    std::size_t   limit = 0;      // requests allowed in flight now
+    std::size_t   target = 0;     // requests that would hold one BDP
+    std::uint64_t backoffs = 0;   // times the limit was halved
+};
+
+// Sizes the number of backend requests in flight at once. Requests of the
+// average size, each costing a round trip plus its transfer time, keep one
+// bandwidth-delay product in flight when 1 + BDP / size of them run
+// together; that is the target. The limit moves toward it by one request
+// per limit's worth of completions (additive increase). It halves instead
+// when most requests of such a window took well above the lowest time to
+// first byte seen lately, the sign of requests queueing at the origin or
+// on the link (multiplicative decrease).
+class InflightTuner {
+public:
+    InflightTuner(std::size_t min_limit, std::size_t max_limit, std::size_t initial);
+
+    // Feeds one completed request and the link estimate that includes it;
+    // returns the new limit.
+    std::size_t complete(double first_byte_sec, std::size_t bytes, const LinkEstimate& link);
+
+    InflightStats stats();
+
+    InflightTuner(const InflightTuner&) = delete;
+    InflightTuner& operator=(const InflightTuner&) = delete;
+
+private:
+    std::mutex    mu_;
+    std::size_t   min_;
+    std::size_t   max_;
+    InflightStats stats_;
+    double        base_rtt_ = 0;    // floor of time to first byte, drifting up slowly
+    double        avg_bytes_ = 0;
+    std::size_t   acked_ = 0;       // completions since the limit last moved
+    std::size_t   queued_ = 0;      // of those, ones that found a queue
+};
+
+}
+
+#endif
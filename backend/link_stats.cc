@@ -0,0 +1,31 @@
+#include "backend/link_stats.h"
+
+namespace cache_fs {
+
+namespace {
+
+constexpr double kGain = 1.0 / 8;
+// Below these a transfer says more about the clock than the link.
+constexpr std::size_t kMinRateBytes = 16 * 1024;
+constexpr double kMinRateSec = 0.001;
+
+double smooth(double avg, double sample, bool first) { return first ? sample : avg + kGain * (sample - avg); }
+
+}
+
+void LinkStats::record(double first_byte_sec, double total_sec, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mu_);
+    est_.rtt_sec = smooth(est_.rtt_sec, first_byte_sec, est_.samples == 0);
+    ++est_.samples;
+    const double flow_sec = total_sec - first_byte_sec;
+    if (bytes < kMinRateBytes || flow_sec < kMinRateSec) return;
+    est_.bytes_per_sec = smooth(est_.bytes_per_sec, bytes / flow_sec, !have_rate_);
+    have_rate_ = true;
+}
+
+LinkEstimate LinkStats::estimate() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return est_;
+}
+
+}
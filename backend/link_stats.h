@@ -0,0 +1,34 @@
+#ifndef CACHE_FS_LINK_STATS_H
+#define CACHE_FS_LINK_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace cache_fs {
+
+// Smoothed view of the link to the origin: the time from sending a request
+// to its first response byte, and the rate data arrives at after that.
+struct LinkEstimate {
+    double        rtt_sec = 0;
+    double        bytes_per_sec = 0;
+    std::uint64_t samples = 0;
+};
+
+// Fed one sample per completed download, averaged as TCP averages its RTT
+// (each sample weighs 1/8). Transfers too small or too quick to time leave
+// the rate alone.
+class LinkStats {
+public:
+    void record(double first_byte_sec, double total_sec, std::size_t bytes);
+    LinkEstimate estimate();
+
+private:
+    std::mutex   mu_;
+    LinkEstimate est_;
+    bool         have_rate_ = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "backend/rate_limiter.h"
+
+#include <algorithm>
+
+namespace cache_fs {
+
+namespace {
+
+// Buckets hold this many seconds of their rate.
+constexpr double kBurstSec = 1.0;
+// A waiting request looks for tokens to borrow at least this often.
+constexpr auto kMinWait = std::chrono::milliseconds(1);
+constexpr auto kMaxWait = std::chrono::milliseconds(50);
+
+}
+
+TrafficClass traffic_class(IoPriority prio) {
+    switch (prio) {
+        case IoPriority::kDemand:   return TrafficClass::kDemand;
+        case IoPriority::kPrefetch: return TrafficClass::kPrefetch;
+        default:                    return TrafficClass::kWriteBack;
+    }
+}
+
+RateLimiter::RateLimiter() : last_(Clock::now()) {}
+
+void RateLimiter::set_limit(TrafficClass cls, const RateLimit& limit) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        Class& c = classes_[static_cast<std::size_t>(cls)];
+        c.bytes.rate     = std::max(limit.bytes_per_sec, 0.0);
+        c.bytes.burst    = c.bytes.rate * kBurstSec;
+        c.bytes.tokens   = c.bytes.burst;
+        c.requests.rate  = std::max(limit.requests_per_sec, 0.0);
+        c.requests.burst = std::max(c.requests.rate * kBurstSec, 1.0);
+        c.requests.tokens = c.requests.burst;
+    }
+    cv_.notify_all();
+}
+
+void RateLimiter::refill(Clock::time_point now) {
+    const double dt = std::chrono::duration<double>(now - last_).count();
+    last_ = now;
+    if (dt <= 0) return;
+    for (Class& c : classes_) {
+        for (Bucket* b : {&c.bytes, &c.requests})
+            if (b->rate) b->tokens = std::min(b->burst, b->tokens + b->rate * dt);
+    }
+}
+
+RateLimiter::Bucket* RateLimiter::source(std::size_t cls, Bucket Class::*bucket, bool& borrowed) {
+    Bucket& own = classes_[cls].*bucket;
+    if (!own.rate || own.tokens >= 1) return &own;
+    for (std::size_t h = 0; h < cls; ++h) {
+        Bucket& lender = classes_[h].*bucket;
+        if (lender.rate && lender.tokens - lender.burst / 2 >= 1) {
+            borrowed = true;
+            return &lender;
+        }
+    }
+    return nullptr;
+}
+
+void RateLimiter::take(Bucket& from, Bucket& own, double n) {
+    if (&from == &own) {
+        if (own.rate) own.tokens -= n;
+        return;
+    }
+    const double lent = std::min(n, from.tokens - from.burst / 2);
+    from.tokens -= lent;
+    own.tokens -= n - lent;
+}
+
+void RateLimiter::acquire(TrafficClass tc, std::size_t bytes) {
+    const std::size_t cls = static_cast<std::size_t>(tc);
+    std::unique_lock<std::mutex> lock(mu_);
+    Class& c = classes_[cls];
+    ++c.stats.requests;
+    c.stats.bytes += bytes;
+    const Clock::time_point start = Clock::now();
+    for (bool waited = false;; waited = true) {
+        const Clock::time_point now = Clock::now();
+        refill(now);
+        bool borrowed = false;
+        Bucket* req = source(cls, &Class::requests, borrowed);
+        Bucket* byt = source(cls, &Class::bytes, borrowed);
+        if (req && byt) {
+            take(*req, c.requests, 1);
+            take(*byt, c.bytes, static_cast<double>(bytes));
+            if (borrowed) ++c.stats.borrowed;
+            if (waited) {
+                ++c.stats.throttled;
+                c.stats.wait_sec += std::chrono::duration<double>(now - start).count();
+            }
+            return;
+        }
+        // Sleep until the class's own buckets refill, or less, in case a
+        // more urgent class goes idle meanwhile.
+        double sec = 0;
+        if (!req) sec = std::max(sec, (1 - c.requests.tokens) / c.requests.rate);
+        if (!byt) sec = std::max(sec, (1 - c.bytes.tokens) / c.bytes.rate);
+        auto wait = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(sec));
+        cv_.wait_for(lock, std::clamp<Clock::duration>(wait, kMinWait, kMaxWait));
+    }
+}
+
+void RateLimiter::charge(TrafficClass tc, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mu_);
+    refill(Clock::now());
+    Class& c = classes_[static_cast<std::size_t>(tc)];
+    c.stats.bytes += bytes;
+    if (c.bytes.rate) c.bytes.tokens -= static_cast<double>(bytes);
+}
+
+ThrottleStats RateLimiter::stats(TrafficClass cls) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return classes_[static_cast<std::size_t>(cls)].stats;
+}
+
+}
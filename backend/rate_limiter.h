@@ -0,0 +1,95 @@
+#ifndef CACHE_FS_RATE_LIMITER_H
+#define CACHE_FS_RATE_LIMITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "cache/io_priority.h"
+
+namespace cache_fs {
+
+// Traffic to the origin as its limits see it, most urgent first. Metadata
+// is the /api/info and /api/list lookups behind getattr and readdir.
+enum class TrafficClass : std::uint8_t {
+    kDemand,
+    kMetadata,
+    kPrefetch,
+    kWriteBack,   // uploads, deletes and other background work
+};
+
+constexpr std::size_t kTrafficClasses = 4;
+
+TrafficClass traffic_class(IoPriority prio);
+
+// Sustained rates a class may use; zero leaves that dimension unlimited.
+struct RateLimit {
+    double bytes_per_sec = 0;
+    double requests_per_sec = 0;
+};
+
+struct ThrottleStats {
+    std::uint64_t requests = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t throttled = 0;   // requests that waited for tokens
+    std::uint64_t borrowed = 0;    // requests sent on a more urgent class's tokens
+    double        wait_sec = 0;
+};
+
+// One pair of token buckets (bytes, requests) per class, each holding a
+// second's worth of its rate. A request needs a request token and a byte
+// bucket that is not in debt; its bytes are then taken even if that leaves
+// the bucket below zero, so a transfer larger than the bucket still goes
+// and the class pays for it afterwards. A class short of tokens borrows
+// from a more urgent class whose bucket is more than half full, taking at
+// most what is above the half and charging the rest to its own bucket, so
+// idle capacity is used while the lender keeps half a second for itself.
+class RateLimiter {
+public:
+    RateLimiter();
+
+    void set_limit(TrafficClass cls, const RateLimit& limit);
+
+    // Blocks until a request of `bytes` may be sent.
+    void acquire(TrafficClass cls, std::size_t bytes);
+    // Charges bytes not known when the request was admitted.
+    void charge(TrafficClass cls, std::size_t bytes);
+
+    ThrottleStats stats(TrafficClass cls);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Bucket {
+        double rate = 0;      // tokens per second, 0 when unlimited
+        double burst = 0;
+        double tokens = 0;
+    };
+    struct Class {
+        Bucket        bytes;
+        Bucket        requests;
+        ThrottleStats stats;
+    };
+
+    void refill(Clock::time_point now);
+    // The class's own bucket if it holds a token, else a more urgent
+    // class's with a token above its half, else null.
+    Bucket* source(std::size_t cls, Bucket Class::*bucket, bool& borrowed);
+    // Takes `n` tokens from `from`; a lender gives only what is above its
+    // half and `own` is charged the rest.
+    static void take(Bucket& from, Bucket& own, double n);
+
+    std::mutex              mu_;
+    std::condition_variable cv_;
+    Class                   classes_[kTrafficClasses];
+    Clock::time_point       last_;
+};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "backend/request_queue.h"
+
+#include <algorithm>
+
+namespace cache_fs {
+
+RequestQueue::RequestQueue(std::size_t slots) : slots_(std::max<std::size_t>(slots, 2)) {}
+
+bool RequestQueue::admissible(std::size_t cls) const {
+    for (std::size_t c = 0; c < cls; ++c)
+        if (waiting_[c]) return false;
+    return active_ < (cls == 0 ? slots_ : slots_ - 1);
+}
+
+void RequestQueue::acquire(IoPriority prio) {
+    const std::size_t cls = static_cast<std::size_t>(prio);
+    std::unique_lock<std::mutex> lock(mu_);
+    ++waiting_[cls];
+    cv_.wait(lock, [&] { return admissible(cls); });
+    --waiting_[cls];
+    ++active_;
+    lock.unlock();
+    // Less urgent requests held back by this one may fit in a free slot.
+    cv_.notify_all();
+}
+
+void RequestQueue::release() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        --active_;
+    }
+    cv_.notify_all();
+}
+
+void RequestQueue::resize(std::size_t slots) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        slots_ = std::max<std::size_t>(slots, 2);
+    }
+    cv_.notify_all();
+}
+
+std::size_t RequestQueue::active() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return active_;
+}
+
+}
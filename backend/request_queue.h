@@ -0,0 +1,56 @@
+#ifndef CACHE_FS_REQUEST_QUEUE_H
+#define CACHE_FS_REQUEST_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+#include "cache/io_priority.h"
+
+namespace cache_fs {
+
+// Admits backend requests by priority: at most `slots` run at once, a
+// request waits while one of a more urgent class is waiting, and the last
+// slot is kept for demand reads so background transfers never leave a
+// blocking read queued behind them.
+class RequestQueue {
+public:
+    explicit RequestQueue(std::size_t slots);
+
+    void acquire(IoPriority prio);
+    void release();
+
+    // Changes the slot count; running requests beyond a smaller count
+    // finish, and no new ones start until they have.
+    void resize(std::size_t slots);
+
+    std::size_t active();
+
+    class Slot {
+    public:
+        Slot(RequestQueue& q, IoPriority prio) : q_(q) { q_.acquire(prio); }
+        ~Slot() { q_.release(); }
+
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+
+    private:
+        RequestQueue& q_;
+    };
+
+    RequestQueue(const RequestQueue&) = delete;
+    RequestQueue& operator=(const RequestQueue&) = delete;
+
+private:
+    bool admissible(std::size_t cls) const;
+
+    std::size_t             slots_;
+    std::size_t             active_ = 0;
+    std::size_t             waiting_[kIoPriorities] = {};
+    std::mutex              mu_;
+    std::condition_variable cv_;
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+// Cost of small block writes through BlockStore and the directory syscalls
+// they make. mkdir is interposed to count calls; before the shard bitset
+// every write made two.
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include <fcntl.h>
+
+#include "cache/block_store.h"
+#include "cache/path_hash.h"
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<std::size_t> g_mkdirs{0};
+
+extern "C" int mkdir(const char* path, mode_t mode) noexcept {
+    ++g_mkdirs;
+    return static_cast<int>(::syscall(SYS_mkdirat, AT_FDCWD, path, mode));
+}
+
+static void run(const char* label, BlockStore& store, const std::vector<std::string>& names) {
+    char buf[4096] = {};
+    g_mkdirs = 0;
+    auto t0 = Clock::now();
+    for (auto& n : names) store.write(n, buf, sizeof(buf), 0, false);
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::cout << label << names.size() / secs / 1e3 << " Kwrite/s, "
+              << double(g_mkdirs) / names.size() << " mkdir/write\n";
+}
+
+int main(int argc, char** argv) {
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50'000;
+    const std::string root = "./bench_cache_dir";
+    std::filesystem::remove_all(root);
+
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < n; ++i) names.push_back(path_hash_hex("/bench/" + std::to_string(i)) + ".b12");
+    {
+        BlockStore store(root, 4096);
+        if (!store.init()) return 1;
+        run("new shards:     ", store, names);
+        run("known shards:   ", store, names);
+    }
+    {
+        BlockStore store(root, 4096);
+        if (!store.init()) return 1;
+        run("after restart:  ", store, names);
+    }
+    std::filesystem::remove_all(root);
+    return 0;
+}
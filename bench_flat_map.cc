@@ -0,0 +1,80 @@
+// Lookup/insert throughput and memory per entry of FlatHashMap against
+// std::unordered_map, with the BlockKey -> index shape used by LruPolicy.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "cache/flat_hash_map.h"
+
+static std::size_t g_bytes = 0;
+
+template <class T>
+struct CountingAlloc {
+    using value_type = T;
+    CountingAlloc() = default;
+    template <class U> CountingAlloc(const CountingAlloc<U>&) {}
+    T* allocate(std::size_t n) { g_bytes += n * sizeof(T); return static_cast<T*>(::operator new(n * sizeof(T))); }
+    void deallocate(T* p, std::size_t n) { g_bytes -= n * sizeof(T); ::operator delete(p); }
+    template <class U> bool operator==(const CountingAlloc<U>&) const { return true; }
+    template <class U> bool operator!=(const CountingAlloc<U>&) const { return false; }
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double mops(std::size_t n, Clock::time_point t0) {
+    double s = std::chrono::duration<double>(Clock::now() - t0).count();
+    return n / s / 1e6;
+}
+
+// Lookups use a shuffled copy of the keys so that node-based maps do not get
+// a free ride from allocation order matching lookup order.
+template <class Map>
+static void run(const char* name, Map& m, const std::vector<std::uint64_t>& keys,
+                const std::vector<std::uint64_t>& lookups, const std::vector<std::uint64_t>& misses,
+                std::size_t bytes_fn(const Map&)) {
+    auto t0 = Clock::now();
+    for (std::size_t i = 0; i < keys.size(); ++i) m[keys[i]] = static_cast<std::uint32_t>(i);
+    double ins = mops(keys.size(), t0);
+
+    std::uint64_t sum = 0;
+    t0 = Clock::now();
+    for (auto k : lookups) sum += m.find(k)->second;
+    double hit = mops(lookups.size(), t0);
+
+    t0 = Clock::now();
+    for (auto k : misses) sum += m.find(k) == m.end();
+    double miss = mops(misses.size(), t0);
+
+    std::cout << name << ": insert " << ins << " Mops/s, hit " << hit << " Mops/s, miss " << miss
+              << " Mops/s, " << double(bytes_fn(m)) / m.size() << " B/entry (chk " << (sum & 1) << ")\n";
+}
+
+int main(int argc, char** argv) {
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    std::mt19937_64 rng(1);
+    std::vector<std::uint64_t> keys(n), misses(n);
+    for (auto& k : keys) k = rng() | 1;
+    for (auto& k : misses) k = rng() & ~1ULL;
+    std::vector<std::uint64_t> lookups = keys;
+    std::shuffle(lookups.begin(), lookups.end(), rng);
+
+    std::cout << "keys: " << n << "\n";
+    {
+        FlatHashMap<std::uint64_t, std::uint32_t> m;
+        run<decltype(m)>("FlatHashMap       ", m, keys, lookups, misses,
+                         [](const decltype(m)& x) { return x.memory_bytes(); });
+    }
+    {
+        std::unordered_map<std::uint64_t, std::uint32_t, std::hash<std::uint64_t>,
+                           std::equal_to<std::uint64_t>,
+                           CountingAlloc<std::pair<const std::uint64_t, std::uint32_t>>> m;
+        run<decltype(m)>("std::unordered_map", m, keys, lookups, misses,
+                         [](const decltype(m)&) { return g_bytes; });
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+// Per-access cost and per-block memory of LruPolicy. The default run tracks
+// 10M blocks; pass a larger count (e.g. 100000000) on a big enough box.
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "cache/policy/lru_policy.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    LruPolicy lru(n);
+
+    auto t0 = Clock::now();
+    for (std::size_t i = 0; i < n; ++i) lru.touch(make_block_key(ObjectId(i >> 16), i & 0xFFFF), 65536, 1.0);
+    double fill = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    std::mt19937_64 rng(7);
+    t0 = Clock::now();
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t b = rng() % n;
+        lru.touch(make_block_key(ObjectId(b >> 16), b & 0xFFFF), 65536, 0.25);
+    }
+    double retouch = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    std::cout << "blocks tracked: " << lru.size() << "\n"
+              << "insert:  " << n / fill / 1e6 << " Mtouch/s\n"
+              << "retouch: " << n / retouch / 1e6 << " Mtouch/s\n"
+              << "memory:  " << double(lru.memory_bytes()) / lru.size() << " B/block, "
+              << lru.memory_bytes() / (1024.0 * 1024 * 1024) << " GiB total\n";
+    return 0;
+}
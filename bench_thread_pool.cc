@@ -0,0 +1,103 @@
+// Task throughput and start latency of ThreadPool: tiny tasks posted by
+// several outside threads at once, a fan-out posted from inside a task (the
+// case work stealing spreads), and the delay from post to start while the
+// pool is idle and while it is flooded.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cache/thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::size_t kWorkers = 4;
+
+static double seconds_since(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static void wait_for(const std::atomic<std::size_t>& done, std::size_t n) {
+    while (done.load(std::memory_order_acquire) < n) std::this_thread::yield();
+}
+
+static void contended(std::size_t n, std::size_t producers, bool futures) {
+    ThreadPool pool(kWorkers);
+    std::atomic<std::size_t> done{0};
+    auto task = [&done] { done.fetch_add(1, std::memory_order_release); };
+    auto t0 = Clock::now();
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&] {
+            for (std::size_t i = 0; i < n / producers; ++i) {
+                if (futures) pool.enqueue(task);
+                else pool.post(task);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    wait_for(done, n / producers * producers);
+    std::cout << (futures ? "enqueue" : "post   ") << ", " << producers << " producers: "
+              << n / seconds_since(t0) / 1e6 << " Mtask/s\n";
+}
+
+static void fan_out(std::size_t n) {
+    ThreadPool pool(kWorkers);
+    std::atomic<std::size_t> done{0};
+    auto t0 = Clock::now();
+    pool.post([&] {
+        for (std::size_t i = 0; i < n; ++i) {
+            pool.post([&done] {
+                volatile unsigned x = 0;
+                for (unsigned k = 0; k < 200; ++k) x = x + k;
+                done.fetch_add(1, std::memory_order_release);
+            });
+        }
+    });
+    wait_for(done, n);
+    std::cout << "fan-out from a worker:  " << n / seconds_since(t0) / 1e6 << " Mtask/s\n";
+}
+
+// The flood is prefetch-class work kept at the queue bound; samples are demand.
+static void latency(const char* label, std::size_t samples, bool flooded) {
+    ThreadPool pool(kWorkers, 4096);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> flood;
+    if (flooded) {
+        for (int p = 0; p < 2; ++p) {
+            flood.emplace_back([&] {
+                while (!stop) {
+                    if (!pool.try_post([] {}, IoPriority::kPrefetch)) std::this_thread::yield();
+                }
+            });
+        }
+    }
+    std::vector<double> us;
+    for (std::size_t i = 0; i < samples; ++i) {
+        std::promise<double> started;
+        auto fut = started.get_future();
+        auto t0 = Clock::now();
+        pool.post([&started, t0] {
+            started.set_value(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        });
+        us.push_back(fut.get());
+    }
+    stop = true;
+    for (auto& t : flood) t.join();
+    std::sort(us.begin(), us.end());
+    std::cout << label << "p50 " << us[us.size() / 2] << " us, p99 " << us[us.size() * 99 / 100] << " us\n";
+}
+
+int main(int argc, char** argv) {
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    for (std::size_t producers : {1, 4, 8}) contended(n, producers, true);
+    for (std::size_t producers : {1, 4, 8}) contended(n, producers, false);
+    fan_out(n);
+    latency("latency, idle pool:     ", 20'000, false);
+    latency("latency, flooded pool:  ", 2'000, true);
+    return 0;
+}
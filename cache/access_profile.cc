@@ -0,0 +1,54 @@
+#include "access_profile.h"
+
+#include <limits>
+
+namespace {
+
+void put_u32(std::string& out, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+std::uint32_t get_u32(const char* p) {
+    std::uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<std::uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+}
+
+bool AccessProfile::covers(std::size_t blk) const {
+    for (const Range& r : ranges_)
+        if (blk >= r.first && blk - r.first < r.count) return true;
+    return false;
+}
+
+void AccessProfile::record(std::size_t first_blk, std::size_t last_blk) {
+    for (std::size_t blk = first_blk; blk <= last_blk; ++blk) {
+        if (blk >= std::numeric_limits<std::uint32_t>::max() || covers(blk)) continue;
+        if (!ranges_.empty() && ranges_.back().first + ranges_.back().count == blk) {
+            ++ranges_.back().count;
+        } else {
+            if (ranges_.size() == kMaxRanges) return;
+            ranges_.push_back(Range{static_cast<std::uint32_t>(blk), 1});
+        }
+    }
+}
+
+std::string AccessProfile::encode() const {
+    std::string out;
+    out.reserve(ranges_.size() * 8);
+    for (const Range& r : ranges_) {
+        put_u32(out, r.first);
+        put_u32(out, r.count);
+    }
+    return out;
+}
+
+AccessProfile AccessProfile::decode(std::string_view blob) {
+    AccessProfile p;
+    for (std::size_t off = 0; off + 8 <= blob.size() && p.ranges_.size() < kMaxRanges; off += 8) {
+        Range r{get_u32(blob.data() + off), get_u32(blob.data() + off + 4)};
+        if (r.count) p.ranges_.push_back(r);
+    }
+    return p;
+}
@@ -0,0 +1,40 @@
+#ifndef CACHE_ACCESS_PROFILE_H
+#define CACHE_ACCESS_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The blocks of a file read between an open and its close, as ranges of
+// consecutive blocks in the order they were first read (a Parquet reader,
+// say, takes the footer and then a few column chunks). Blocks read again
+// are not recorded twice, and past kMaxRanges ranges nothing more is, so
+// an encoded profile stays within 8 bytes a range.
+class AccessProfile {
+public:
+    static constexpr std::size_t kMaxRanges = 64;
+
+    struct Range {
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+    };
+
+    void record(std::size_t first_blk, std::size_t last_blk);
+
+    const std::vector<Range>& ranges() const { return ranges_; }
+    bool empty() const { return ranges_.empty(); }
+
+    // Little-endian (first, count) pairs. decode() keeps the well-formed
+    // ranges it finds, at most kMaxRanges.
+    std::string encode() const;
+    static AccessProfile decode(std::string_view blob);
+
+private:
+    bool covers(std::size_t blk) const;
+
+    std::vector<Range> ranges_;
+};
+
+#endif
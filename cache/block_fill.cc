@@ -0,0 +1,43 @@
+#include "block_fill.h"
+
+#include <cstring>
+
+void BlockFill::advance(std::size_t filled) {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        filled_ = filled;
+    }
+    cv_.notify_all();
+}
+
+void BlockFill::finish(ssize_t result) {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        result_ = result;
+        if (result > 0) filled_ = static_cast<std::size_t>(result);
+        done_ = true;
+    }
+    cv_.notify_all();
+}
+
+RamTier::Handle BlockFill::wait(std::size_t need) {
+    std::unique_lock<std::mutex> g(mu_);
+    cv_.wait(g, [&] { return done_ || filled_ >= need; });
+    if (taken_ || (done_ && result_ <= 0)) return nullptr;
+    auto h = std::make_shared<RamBlock>();
+    h->buf = BufferPool::instance().acquire(buf_.size());
+    std::memcpy(h->buf.data(), buf_.data(), filled_);
+    h->len = filled_;
+    return h;
+}
+
+bool BlockFill::failed() {
+    std::lock_guard<std::mutex> g(mu_);
+    return done_ && result_ <= 0;
+}
+
+BlockBuffer BlockFill::take() {
+    std::lock_guard<std::mutex> g(mu_);
+    taken_ = true;
+    return std::move(buf_);
+}
@@ -0,0 +1,47 @@
+#ifndef CACHE_BLOCK_FILL_H
+#define CACHE_BLOCK_FILL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <sys/types.h>
+
+#include "buffer_pool.h"
+#include "ram_tier.h"
+
+// A block being fetched, shared by the thread filling it and the readers
+// waiting on it. Bytes arrive in order, so a reader that needs only the
+// start of the block can go as soon as that much is in rather than wait for
+// the whole fetch.
+class BlockFill {
+public:
+    explicit BlockFill(BlockBuffer buf) : buf_(std::move(buf)) {}
+
+    // For the filling thread, which reports progress through advance().
+    char* data() { return buf_.data(); }
+    void  advance(std::size_t filled);
+    void  finish(ssize_t result);
+
+    // Waits until the first `need` bytes are in or the fetch has ended and
+    // returns a copy of what arrived. nullptr if the fetch failed or the
+    // buffer was already taken, in which case the block is in the RAM tier.
+    RamTier::Handle wait(std::size_t need);
+    bool failed();
+
+    // Hands the buffer over once the fetch has ended.
+    BlockBuffer take();
+
+    BlockFill(const BlockFill&) = delete;
+    BlockFill& operator=(const BlockFill&) = delete;
+
+private:
+    std::mutex              mu_;
+    std::condition_variable cv_;
+    BlockBuffer             buf_;
+    std::size_t             filled_ = 0;
+    ssize_t                 result_ = 0;
+    bool                    done_ = false;
+    bool                    taken_ = false;
+};
+
+#endif
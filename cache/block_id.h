@@ -0,0 +1,28 @@
+#ifndef CACHE_BLOCK_ID_H
+#define CACHE_BLOCK_ID_H
+
+#include <cstdint>
+
+// A cached block is addressed by (object id, block index) packed into 64
+// bits. Object ids are dense indexes into ObjectTable, so a key maps back to
+// its object in O(1) without holding a pointer.
+using ObjectId = std::uint32_t;
+using BlockKey = std::uint64_t;
+
+constexpr ObjectId      kInvalidObject   = UINT32_MAX;
+constexpr BlockKey      kInvalidBlockKey = UINT64_MAX;
+constexpr std::uint64_t kMaxKeyedBlock   = UINT32_MAX;
+
+inline BlockKey make_block_key(ObjectId obj, std::uint64_t blk) {
+    return (static_cast<BlockKey>(obj) << 32) | (blk & 0xFFFFFFFFULL);
+}
+
+inline ObjectId key_object(BlockKey key) {
+    return static_cast<ObjectId>(key >> 32);
+}
+
+inline std::uint64_t key_block(BlockKey key) {
+    return key & 0xFFFFFFFFULL;
+}
+
+#endif
@@ -1,90 +1,614 @@
 #include "block_store.h"
+#include "buffer_pool.h"
+#include "flat_hash_map.h"
 #include "fs_layout.h"
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 
+#include <algorithm>
+
+#include <cctype>
+#include <chrono>
 #include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 
 namespace fs = std::filesystem;
 using namespace fs_layout;
 
 
-BlockStore::BlockStore(const std::string& cache_root, std::size_t block_sz) : root_(cache_root), block_size_(block_sz) {}
+namespace {
 
-bool BlockStore::init() {
+constexpr unsigned     kMaxDeviceErrors = 3;
+constexpr std::int64_t kDeviceRetryMs   = 30000;
+constexpr std::int64_t kFreeCheckMs     = 1000;
+constexpr std::size_t  kMinFreeBytes    = 64ULL * 1024 * 1024;
+constexpr off_t        kMaxExtent       = 128LL * 1024 * 1024;   // ext4's largest extent
+constexpr long         kExtentSlack     = 8;
+constexpr std::size_t  kCopyChunk       = 4ULL * 1024 * 1024;
+
+std::int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The leading 16 hex digits of an object name.
+std::uint64_t name_key(std::string_view hash_hex) {
+    std::uint64_t k = 0;
+    for (std::size_t i = 0; i < hash_hex.size() && i < 16; ++i) {
+        unsigned c = static_cast<unsigned char>(hash_hex[i]);
+        k = k << 4 | ((c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10) & 0xF);
+    }
+    return k;
+}
+
+void account(std::atomic<std::size_t>& used, blkcnt_t before, blkcnt_t after) {
+    if (after > before) {
+        used += static_cast<std::size_t>(after - before) * 512;
+        return;
+    }
+    std::size_t freed = static_cast<std::size_t>(before - after) * 512;
+    std::size_t cur = used.load();
+    while (!used.compare_exchange_weak(cur, cur > freed ? cur - freed : 0)) {}
+}
+
+// Runs io(pos, buf_off, n) on each piece of [off, off + len) that stays
+// within one `unit`-aligned span. Stops at the first short piece; an error
+// is returned only if nothing was transferred before it.
+template <class Io>
+ssize_t split_io(off_t off, std::size_t len, std::size_t unit, Io io) {
+    std::size_t done = 0;
+    while (done < len) {
+        off_t       pos = off + static_cast<off_t>(done);
+        std::size_t n   = std::min<std::size_t>(len - done, unit - static_cast<std::size_t>(pos) % unit);
+        ssize_t     r   = io(pos, done, n);
+        if (r < 0) return done ? static_cast<ssize_t>(done) : r;
+        done += static_cast<std::size_t>(r);
+        if (static_cast<std::size_t>(r) < n) break;
+    }
+    return static_cast<ssize_t>(done);
+}
+
+struct Region {
+    off_t off;
+    off_t len;
+};
+
+// Written ranges of a file; preallocated but unwritten ranges count as holes.
+std::vector<Region> data_regions(int fd, off_t size) {
+    std::vector<Region> out;
+    off_t pos = 0;
+    while (pos < size) {
+        off_t d = ::lseek(fd, pos, SEEK_DATA);
+        if (d < 0) break;
+        off_t h = ::lseek(fd, d, SEEK_HOLE);
+        if (h < 0) h = size;
+        out.push_back(Region{d, h - d});
+        pos = h;
+    }
+    return out;
+}
+
+// Number of written extents backing a file; -1 if the filesystem cannot say.
+long written_extents(int fd) {
+    constexpr unsigned kBatch = 256;
+    std::vector<char> mem(sizeof(fiemap) + kBatch * sizeof(fiemap_extent));
+    auto* fm = reinterpret_cast<fiemap*>(mem.data());
+    long count = 0;
+    std::uint64_t start = 0;
+    for (;;) {
+        std::memset(mem.data(), 0, mem.size());
+        fm->fm_start        = start;
+        fm->fm_length       = FIEMAP_MAX_OFFSET - start;
+        fm->fm_extent_count = kBatch;
+        if (::ioctl(fd, FS_IOC_FIEMAP, fm) != 0) return -1;
+        if (fm->fm_mapped_extents == 0) return count;
+        for (unsigned i = 0; i < fm->fm_mapped_extents; ++i) {
+            const fiemap_extent& e = fm->fm_extents[i];
+            if (!(e.fe_flags & FIEMAP_EXTENT_UNWRITTEN)) ++count;
+            if (e.fe_flags & FIEMAP_EXTENT_LAST) return count;
+            start = e.fe_logical + e.fe_length;
+        }
+    }
+}
+
+// A contiguous region needs one extent per kMaxExtent; a file is worth
+// rewriting once it uses well over twice that.
+bool fragmented(int fd, const std::vector<Region>& regions) {
+    long want = 0;
+    for (const Region& r : regions) want += static_cast<long>((r.len + kMaxExtent - 1) / kMaxExtent);
+    long have = written_extents(fd);
+    return have > 2 * want + kExtentSlack;
+}
+
+// Copies the written regions of `src` into a fresh file, each preallocated
+// as one range first, keeping holes and the original size.
+bool copy_regions(int src, const std::string& tmp, const std::vector<Region>& regions, off_t size) {
+    int dst = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst < 0) return false;
+    BlockBuffer buf = BufferPool::instance().acquire(kCopyChunk);
+    bool ok = true;
+    for (const Region& r : regions) {
+        ::fallocate(dst, FALLOC_FL_KEEP_SIZE, r.off, r.len);
+        for (off_t pos = r.off; ok && pos < r.off + r.len;) {
+            std::size_t want = static_cast<std::size_t>(std::min<off_t>(kCopyChunk, r.off + r.len - pos));
+            ssize_t n = ::pread(src, buf.data(), want, pos);
+            ok = n > 0 && ::pwrite(dst, buf.data(), n, pos) == n;
+            pos += n;
+        }
+        if (!ok) break;
+    }
+    ok = ok && ::ftruncate(dst, size) == 0 && ::fdatasync(dst) == 0;
+    ::close(dst);
+    if (!ok) ::unlink(tmp.c_str());
+    return ok;
+}
+
+}
+
+BlockStore::BlockStore(const std::string& cache_root, std::size_t block_sz)
+: BlockStore(std::vector<StoreRoot>{StoreRoot{cache_root, 0}}, block_sz) {}
+
+BlockStore::BlockStore(std::vector<StoreRoot> roots, std::size_t block_sz) : block_size_(block_sz) {
+    for (auto& r : roots) {
+        auto d = std::make_unique<Device>();
+        d->root     = std::move(r.path);
+        d->capacity  = r.capacity;
+        d->part_size = r.part_size ? r.part_size : kDefaultPartSize;
+        devs_.push_back(std::move(d));
+    }
+}
+
+BlockStore::~BlockStore() {
+    {
+        std::lock_guard<std::mutex> g(defrag_mu_);
+        defrag_stop_ = true;
+    }
+    defrag_cv_.notify_all();
+    if (defragger_.joinable()) defragger_.join();
+}
+
+std::shared_mutex& BlockStore::lock_for(std::string_view hash_hex) {
+    return locks_[name_key(hash_hex) % kLockStripes];
+}
+
+static bool is_shard_name(const std::string& name) {
+    return name.size() == 2 && std::isxdigit(static_cast<unsigned char>(name[0])) &&
+           std::isxdigit(static_cast<unsigned char>(name[1]));
+}
+
+// Removes object files from the two-level shard tree. Only *.blk / *.dmap
+// files are touched because the cache root may also hold write-through data.
+static void purge_objects(const std::string& root) {
     std::error_code ec;
-    if (!fs::exists(root_)) {
-        if (!fs::create_directories(root_, ec)) {
-        std::cerr << "[block_store] failed to create cache root '" << root_ << "': " << ec.message() << '\n';
+    for (auto const& l1 : fs::directory_iterator(root, ec)) {
+        if (!l1.is_directory() || !is_shard_name(l1.path().filename().string())) continue;
+        for (auto const& l2 : fs::directory_iterator(l1.path(), ec)) {
+            if (!l2.is_directory() || !is_shard_name(l2.path().filename().string())) continue;
+            for (auto const& f : fs::directory_iterator(l2.path(), ec)) {
+                auto ext = f.path().extension();
+                if (ext == ".blk" || ext == ".dmap" || ext == ".defrag") fs::remove(f.path(), ec);
+            }
+            fs::remove(l2.path(), ec);
+        }
+        fs::remove(l1.path(), ec);
+    }
+}
+
+struct LayoutHeader {
+    unsigned    version   = 1;
+    std::size_t part_size = kDefaultPartSize;
+};
+
+static LayoutHeader read_layout(const std::string& root) {
+    LayoutHeader h;
+    std::ifstream in(layout_file(root));
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("version=", 0) == 0) h.version = static_cast<unsigned>(std::strtoul(line.c_str() + 8, nullptr, 10));
+        else if (line.rfind("part_size=", 0) == 0) h.part_size = std::strtoull(line.c_str() + 10, nullptr, 10);
+    }
+    return h;
+}
+
+static bool write_layout(const std::string& root, std::size_t part_size) {
+    std::string tmp = layout_file(root) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "version=" << kLayoutVersion << '\n' << "part_size=" << part_size << '\n';
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, layout_file(root), ec);
+    return !ec;
+}
+
+// `part_size` is the size for a new root on entry and the one the root
+// uses on return; an existing root keeps the size its objects were split by.
+static bool init_root(const std::string& root, std::size_t& part_size) {
+    std::error_code ec;
+    if (!fs::exists(root)) {
+        if (!fs::create_directories(root, ec)) {
+        std::cerr << "[block_store] failed to create cache root '" << root << "': " << ec.message() << '\n';
+        return false;
+        }
+    }
+
+    if (!valid_part_size(part_size)) {
+        std::cerr << "[block_store] invalid part size " << part_size << " for cache root '" << root << "'\n";
         return false;
+    }
+    LayoutHeader h = fs::exists(layout_file(root)) ? read_layout(root) : LayoutHeader{};
+    if (h.version == kLayoutVersion) {
+        if (!valid_part_size(h.part_size)) {
+            std::cerr << "[block_store] cache root '" << root << "' records invalid part size " << h.part_size << '\n';
+            return false;
         }
+        if (h.part_size != part_size)
+            std::cerr << "[block_store] cache root '" << root << "' keeps its part size of " << h.part_size << '\n';
+        part_size = h.part_size;
+        return true;
+    }
+    if (h.version > kLayoutVersion) {
+        std::cerr << "[block_store] cache root '" << root << "' uses layout v" << h.version
+                  << ", newer than supported v" << kLayoutVersion << '\n';
+        return false;
+    }
+    purge_objects(root);
+    if (!write_layout(root, part_size)) {
+        std::cerr << "[block_store] failed to write layout header in '" << root << "'\n";
+        return false;
     }
     return true;
 }
 
-static void ensure_shard_dirs(const std::string& root, const std::string& hash_hex) {
-    std::string lvl1 = root + "/" + hash_hex.substr(0, 2);
-    std::string lvl2 = lvl1 + "/" + hash_hex.substr(2, 2);
+// Bytes allocated to object part files under one root.
+static std::size_t scan_usage(const std::string& root) {
+    std::size_t bytes = 0;
+    std::error_code ec;
+    for (auto const& l1 : fs::directory_iterator(root, ec)) {
+        if (!l1.is_directory() || !is_shard_name(l1.path().filename().string())) continue;
+        for (auto const& l2 : fs::directory_iterator(l1.path(), ec)) {
+            if (!l2.is_directory() || !is_shard_name(l2.path().filename().string())) continue;
+            for (auto const& f : fs::directory_iterator(l2.path(), ec)) {
+                struct stat st;
+                if (f.path().extension() == ".blk" && ::stat(f.path().c_str(), &st) == 0)
+                    bytes += static_cast<std::size_t>(st.st_blocks) * 512;
+            }
+        }
+    }
+    return bytes;
+}
+
+// With several devices a root that cannot be set up is only taken out of
+// placement; the store fails if none is left.
+bool BlockStore::init() {
+    if (devs_.empty() || devs_.size() > kMaxDevices) {
+        std::cerr << "[block_store] need 1 to " << kMaxDevices << " cache roots, got " << devs_.size() << '\n';
+        return false;
+    }
+    if (devs_.size() == 1) return init_root(devs_[0]->root, devs_[0]->part_size);
 
-    ::mkdir(lvl1.c_str(), 0755);
-    ::mkdir(lvl2.c_str(), 0755);
+    bool any = false;
+    for (auto& d : devs_) {
+        if (init_root(d->root, d->part_size)) {
+            d->used = scan_usage(d->root);
+            any = true;
+        } else {
+            d->healthy  = false;
+            d->retry_at = now_ms() + kDeviceRetryMs;
+        }
+    }
+    return any;
 }
 
-static int open_file(const std::string& path, int flags, mode_t mode = 0644) {
-    int fd = ::open(path.c_str(), flags, mode);
+static int open_file(const char* path, int flags, mode_t mode = 0644) {
+    int fd = ::open(path, flags, mode);
     return (fd < 0) ? -errno : fd;
 }
 
+// The shard "xx/yy" of an object name, as an index into the bitset.
+static std::size_t shard_of(std::string_view hash_hex) {
+    return static_cast<std::size_t>(name_key(hash_hex) >> 48);
+}
+
+void BlockStore::ensure_shard_dirs(Device& d, std::string_view hash_hex) {
+    std::size_t   shard = shard_of(hash_hex);
+    std::uint64_t bit   = 1ULL << (shard % 64);
+    auto&         word  = d.shard_dirs[shard / 64];
+    if (word.load(std::memory_order_relaxed) & bit) return;
 
-ssize_t BlockStore::read(const std::string& hash_hex, char* buf, std::size_t len, off_t off) {
-    std::size_t part_idx = off / kMaxPartSize;
-    off_t part_off = off % kMaxPartSize;
+    char lvl[kPathMax];
+    std::snprintf(lvl, sizeof(lvl), "%s/%.2s", d.root.c_str(), hash_hex.data());
+    ::mkdir(lvl, 0755);
+    std::snprintf(lvl, sizeof(lvl), "%s/%.2s/%.2s", d.root.c_str(), hash_hex.data(), hash_hex.data() + 2);
+    if (::mkdir(lvl, 0755) == 0 || errno == EEXIST) word.fetch_or(bit, std::memory_order_relaxed);
+}
 
-    std::string path = data_part_path(root_, hash_hex, part_idx);
+void BlockStore::forget_shard_dirs(Device& d, std::string_view hash_hex) {
+    std::size_t shard = shard_of(hash_hex);
+    d.shard_dirs[shard / 64].fetch_and(~(1ULL << (shard % 64)), std::memory_order_relaxed);
+}
 
+// Opens a part file for writing, creating it and its shard directories as
+// needed. A directory removed since it was last seen (an emptied shard) is
+// recreated once.
+int BlockStore::open_part(Device& d, std::string_view hash_hex, std::size_t part_idx) {
+    char path[kPathMax];
+    if (!format_part_path(path, d.root, hash_hex, part_idx)) return -ENAMETOOLONG;
+    ensure_shard_dirs(d, hash_hex);
+    int fd = open_file(path, O_RDWR | O_CREAT, 0644);
+    if (fd != -ENOENT) return fd;
+    forget_shard_dirs(d, hash_hex);
+    ensure_shard_dirs(d, hash_hex);
+    return open_file(path, O_RDWR | O_CREAT, 0644);
+}
+
+static bool holds_on(const std::string& root, std::size_t part_size, std::string_view hash_hex, off_t off) {
+    char path[kPathMax];
+    if (!format_part_path(path, root, hash_hex, off / part_size)) return false;
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    off_t part_off = off % part_size;
+    bool ok = ::lseek(fd, part_off, SEEK_DATA) == part_off;
+    ::close(fd);
+    return ok;
+}
+
+static bool punch_on(const std::string& root, std::size_t part_size, std::string_view hash_hex, off_t off,
+                     std::size_t len, std::atomic<std::size_t>* used) {
+    ssize_t n = split_io(off, len, part_size, [&](off_t pos, std::size_t, std::size_t plen) -> ssize_t {
+        char path[kPathMax];
+        if (!format_part_path(path, root, hash_hex, pos / part_size)) return -ENAMETOOLONG;
+        int fd = ::open(path, O_WRONLY);
+        if (fd < 0) return -errno;
+        struct stat before, after;
+        bool sized = used && ::fstat(fd, &before) == 0;
+        int rc = ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pos % part_size, plen);
+        if (sized && ::fstat(fd, &after) == 0) account(*used, before.st_blocks, after.st_blocks);
+        ::close(fd);
+        return rc == 0 ? static_cast<ssize_t>(plen) : -errno;
+    });
+    return n == static_cast<ssize_t>(len);
+}
+
+static ssize_t read_part(const std::string& root, std::size_t part_size, std::string_view hash_hex,
+                         char* buf, std::size_t len, off_t off) {
+    char path[kPathMax];
+    if (!format_part_path(path, root, hash_hex, off / part_size)) return -ENAMETOOLONG;
     int fd = open_file(path, O_RDONLY);
     if (fd < 0) return fd;
-
+    // A hole below a block written later is not data.
+    off_t part_off = off % part_size;
+    if (::lseek(fd, part_off, SEEK_DATA) != part_off) {
+        ::close(fd);
+        return -ENOENT;
+    }
     ssize_t n = ::pread(fd, buf, len, part_off);
     if (n < 0) n = -errno;
     ::close(fd);
     return n;
 }
 
-ssize_t BlockStore::write(const std::string& hash_hex, const char* buf, std::size_t len, off_t off, bool) {
-    ensure_shard_dirs(root_, hash_hex);
+// Rendezvous hashing: devices sorted by a per-(stripe, device) score, so
+// adding or losing a device only moves the stripes that scored it highest.
+void BlockStore::place(std::string_view hash_hex, off_t off, Order order) const {
+    FlatHash<std::uint64_t> mix;
+    std::uint64_t stripe = name_key(hash_hex) ^ mix(static_cast<std::uint64_t>(off) / kStripeSize);
+    std::size_t score[kMaxDevices];
+    for (std::size_t i = 0; i < devs_.size(); ++i) {
+        std::size_t s = mix(stripe ^ (0x9E3779B97F4A7C15ULL * (i + 1)));
+        std::size_t j = i;
+        for (; j > 0 && score[j - 1] < s; --j) {
+            score[j] = score[j - 1];
+            order[j] = order[j - 1];
+        }
+        score[j] = s;
+        order[j] = static_cast<std::uint8_t>(i);
+    }
+}
 
-    std::size_t part_idx = off / kMaxPartSize;
-    off_t       part_off = off % kMaxPartSize;
+// A device taken out after errors is retried after a cool-down. Blocks were
+// written elsewhere in the meantime, so whatever it still holds is dropped.
+bool BlockStore::usable(Device& d) {
+    if (d.healthy.load(std::memory_order_relaxed)) return true;
+    if (now_ms() < d.retry_at.load()) return false;
+    std::unique_lock<std::mutex> lk(d.recover_mu, std::try_to_lock);
+    if (!lk.owns_lock() || d.healthy) return d.healthy;
+    std::size_t part_size = d.part_size;
+    if (!init_root(d.root, part_size) || part_size != d.part_size || ::access(d.root.c_str(), W_OK) != 0) {
+        d.retry_at = now_ms() + kDeviceRetryMs;
+        return false;
+    }
+    purge_objects(d.root);
+    for (auto& w : d.shard_dirs) w.store(0, std::memory_order_relaxed);
+    d.used         = 0;
+    d.errors       = 0;
+    d.free_checked = 0;
+    d.healthy      = true;
+    std::cerr << "[block_store] cache root '" << d.root << "' is back in use\n";
+    return true;
+}
 
-    std::string path = data_part_path(root_, hash_hex, part_idx);
+bool BlockStore::full(Device& d) {
+    if (d.capacity && d.used.load(std::memory_order_relaxed) >= d.capacity) return true;
+    std::int64_t now = now_ms();
+    if (now - d.free_checked.load(std::memory_order_relaxed) >= kFreeCheckMs) {
+        d.free_checked = now;
+        struct statvfs sv;
+        if (::statvfs(d.root.c_str(), &sv) == 0) d.free = static_cast<std::size_t>(sv.f_bavail) * sv.f_frsize;
+    }
+    return d.free.load(std::memory_order_relaxed) < kMinFreeBytes;
+}
 
-    int fd = open_file(path, O_RDWR | O_CREAT, 0644);
-    if (fd < 0) return fd;
+void BlockStore::note_error(Device& d, int err) {
+    if (err == ENOSPC) {
+        d.free         = 0;
+        d.free_checked = now_ms();
+        return;
+    }
+    if (++d.errors >= kMaxDeviceErrors && d.healthy.exchange(false)) {
+        d.retry_at = now_ms() + kDeviceRetryMs;
+        std::cerr << "[block_store] taking cache root '" << d.root << "' out of use: " << std::strerror(err) << '\n';
+    }
+}
 
-    ssize_t n = ::pwrite(fd, buf, len, part_off);
-    if (n < 0) n = -errno;
+ssize_t BlockStore::write_to(Device& d, std::string_view hash_hex, const char* buf, std::size_t len, off_t off) {
+    int fd = open_part(d, hash_hex, off / d.part_size);
+    if (fd < 0) {
+        note_error(d, -fd);
+        return fd;
+    }
+    struct stat before, after;
+    bool sized = ::fstat(fd, &before) == 0;
+    ssize_t n = ::pwrite(fd, buf, len, off % d.part_size);
+    if (n < 0) {
+        n = -errno;
+        note_error(d, -n);
+    } else {
+        if (d.errors.load(std::memory_order_relaxed)) d.errors = 0;
+        if (sized && ::fstat(fd, &after) == 0) account(d.used, before.st_blocks, after.st_blocks);
+    }
     ::close(fd);
     return n;
 }
 
-bool BlockStore::delete_object(const std::string& hash_hex) {
+// Within one stripe: the devices are probed in placement order.
+ssize_t BlockStore::read_stripe(std::string_view hash_hex, char* buf, std::size_t len, off_t off) {
+    Order order;
+    place(hash_hex, off, order);
+    ssize_t rc = -ENOENT;
+    char path[kPathMax];
+    for (std::size_t i = 0; i < devs_.size(); ++i) {
+        Device& d = *devs_[order[i]];
+        if (!usable(d)) continue;
+        if (!format_part_path(path, d.root, hash_hex, off / d.part_size)) return -ENAMETOOLONG;
+        int fd = open_file(path, O_RDONLY);
+        if (fd < 0) {
+            if (fd != -ENOENT) {
+                note_error(d, -fd);
+                rc = fd;
+            }
+            continue;
+        }
+        // A hole means the block lives on another device, or nowhere.
+        off_t part_off = off % d.part_size;
+        if (::lseek(fd, part_off, SEEK_DATA) != part_off) {
+            ::close(fd);
+            continue;
+        }
+        ssize_t n = ::pread(fd, buf, len, part_off);
+        if (n < 0) n = -errno;
+        ::close(fd);
+        if (n >= 0) return n;
+        note_error(d, -n);
+        rc = n;
+    }
+    return rc;
+}
+
+// Part sizes are multiples of the stripe size, so a stripe never spans two
+// part files.
+ssize_t BlockStore::read(std::string_view hash_hex, char* buf, std::size_t len, off_t off) {
+    std::shared_lock<std::shared_mutex> lk(lock_for(hash_hex));
+    if (devs_.size() == 1) {
+        const Device& d = *devs_[0];
+        return split_io(off, len, d.part_size, [&](off_t pos, std::size_t at, std::size_t n) {
+            return read_part(d.root, d.part_size, hash_hex, buf + at, n, pos);
+        });
+    }
+    return split_io(off, len, kStripeSize, [&](off_t pos, std::size_t at, std::size_t n) {
+        return read_stripe(hash_hex, buf + at, n, pos);
+    });
+}
+
+// The block goes to the first usable device in its order that has room or
+// already holds it; copies further down the order are stale from then on
+// and punched out.
+ssize_t BlockStore::write_stripe(std::string_view hash_hex, const char* buf, std::size_t len, off_t off) {
+    Order order;
+    place(hash_hex, off, order);
+    ssize_t rc = -ENOSPC;
+    for (std::size_t i = 0; i < devs_.size(); ++i) {
+        Device& d = *devs_[order[i]];
+        if (!usable(d)) continue;
+        if (full(d) && !holds_on(d.root, d.part_size, hash_hex, off)) continue;
+        ssize_t n = write_to(d, hash_hex, buf, len, off);
+        if (n < 0) {
+            rc = n;
+            continue;
+        }
+        for (std::size_t j = i + 1; j < devs_.size(); ++j) {
+            Device& o = *devs_[order[j]];
+            if (o.healthy.load(std::memory_order_relaxed)) punch_on(o.root, o.part_size, hash_hex, off, len, &o.used);
+        }
+        return n;
+    }
+    return rc;
+}
+
+ssize_t BlockStore::write(std::string_view hash_hex, const char* buf, std::size_t len, off_t off, bool) {
+    std::shared_lock<std::shared_mutex> lk(lock_for(hash_hex));
+    if (devs_.size() == 1) {
+        Device& d = *devs_[0];
+        return split_io(off, len, d.part_size, [&](off_t pos, std::size_t at, std::size_t n) -> ssize_t {
+            int fd = open_part(d, hash_hex, pos / d.part_size);
+            if (fd < 0) return fd;
+
+            ssize_t w = ::pwrite(fd, buf + at, n, pos % d.part_size);
+            if (w < 0) w = -errno;
+            ::close(fd);
+            return w;
+        });
+    }
+    return split_io(off, len, kStripeSize, [&](off_t pos, std::size_t at, std::size_t n) {
+        return write_stripe(hash_hex, buf + at, n, pos);
+    });
+}
+
+bool BlockStore::punch(std::string_view hash_hex, off_t off, std::size_t len) {
+    std::shared_lock<std::shared_mutex> lk(lock_for(hash_hex));
+    if (devs_.size() == 1) return punch_on(devs_[0]->root, devs_[0]->part_size, hash_hex, off, len, nullptr);
+    bool ok = false;
+    for (auto& d : devs_)
+        if (usable(*d)) ok |= punch_on(d->root, d->part_size, hash_hex, off, len, &d->used);
+    return ok;
+}
+
+bool BlockStore::holds(std::string_view hash_hex, off_t off) {
+    std::shared_lock<std::shared_mutex> lk(lock_for(hash_hex));
+    if (devs_.size() == 1) return holds_on(devs_[0]->root, devs_[0]->part_size, hash_hex, off);
+    for (auto& d : devs_)
+        if (usable(*d) && holds_on(d->root, d->part_size, hash_hex, off)) return true;
+    return false;
+}
+
+static bool delete_files(const std::string& root, std::string_view hash_hex, std::atomic<std::size_t>* used) {
     bool ok = true;
-    std::string dir = root_ + "/" + shard_dir(hash_hex);
+    std::string dir = root + "/" + shard_dir(hash_hex);
 
     if (!fs::exists(dir)) return true;
     for (auto const& entry : fs::directory_iterator(dir)) {
-        if (entry.path().filename().string().rfind(hash_hex, 0) == 0) {
+        if (std::string_view(entry.path().filename().native()).substr(0, hash_hex.size()) == hash_hex) {
+            struct stat st;
+            bool sized = used && ::stat(entry.path().c_str(), &st) == 0;
             std::error_code ec;
             fs::remove(entry, ec);
             if (ec) {
                 std::cerr << "[block_store] failed to remove " << entry.path() << ": " << ec.message() << '\n';
                 ok = false;
+            } else if (sized) {
+                account(*used, st.st_blocks, 0);
             }
         }
     }
@@ -94,3 +618,132 @@ bool BlockStore::delete_object(const std::string& hash_hex) {
     return ok;
 }
 
+// Devices out of use are skipped; they are purged when they come back.
+bool BlockStore::delete_object(std::string_view hash_hex) {
+    std::unique_lock<std::shared_mutex> lk(lock_for(hash_hex));
+    if (devs_.size() == 1) {
+        forget_shard_dirs(*devs_[0], hash_hex);
+        return delete_files(devs_[0]->root, hash_hex, nullptr);
+    }
+    bool ok = true;
+    for (auto& d : devs_) {
+        if (!d->healthy.load(std::memory_order_relaxed)) continue;
+        forget_shard_dirs(*d, hash_hex);
+        ok &= delete_files(d->root, hash_hex, &d->used);
+    }
+    return ok;
+}
+
+// The device a stripe would be written to now.
+BlockStore::Device* BlockStore::reserve_device(std::string_view hash_hex, off_t off) {
+    if (devs_.size() == 1) return devs_[0].get();
+    Order order;
+    place(hash_hex, off, order);
+    for (std::size_t i = 0; i < devs_.size(); ++i) {
+        Device& d = *devs_[order[i]];
+        if (usable(d) && !full(d)) return &d;
+    }
+    return nullptr;
+}
+
+// Stops at the first chunk that cannot be reserved; blocks past it are
+// still written, just without preallocated extents. The object's lock is
+// taken per chunk, so a delete waits for one fallocate at most.
+bool BlockStore::reserve(std::string_view hash_hex, std::size_t size) {
+    for (std::size_t off = 0; off < size; off += kReserveChunk) {
+        std::shared_lock<std::shared_mutex> lk(lock_for(hash_hex));
+        Device* d = reserve_device(hash_hex, off);
+        if (!d) return false;
+        int fd = open_part(*d, hash_hex, off / d->part_size);
+        if (fd < 0) return false;
+        struct stat before, after;
+        bool sized = devs_.size() > 1 && ::fstat(fd, &before) == 0;
+        int rc = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, off % d->part_size, std::min(kReserveChunk, size - off));
+        int err = errno;
+        if (sized && ::fstat(fd, &after) == 0) account(d->used, before.st_blocks, after.st_blocks);
+        ::close(fd);
+        if (rc != 0) {
+            if (err == ENOSPC) note_error(*d, err);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checked under the shared lock, rewritten under the exclusive one; the
+// copy replaces the part file by rename so a crash leaves one or the other.
+bool BlockStore::defragment_file(Device& d, const std::string& path) {
+    std::string name = fs::path(path).filename().string();
+    {
+        std::shared_lock<std::shared_mutex> lk(lock_for(name));
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        bool frag = ::fstat(fd, &st) == 0 && fragmented(fd, data_regions(fd, st.st_size));
+        ::close(fd);
+        if (!frag) return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lk(lock_for(name));
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat before, after;
+    if (::fstat(fd, &before) != 0) {
+        ::close(fd);
+        return false;
+    }
+    std::string tmp = path + ".defrag";
+    bool ok = copy_regions(fd, tmp, data_regions(fd, before.st_size), before.st_size);
+    ::close(fd);
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        std::cerr << "[block_store] failed to defragment " << path << '\n';
+        return false;
+    }
+    if (devs_.size() > 1 && ::stat(path.c_str(), &after) == 0) account(d.used, before.st_blocks, after.st_blocks);
+    return true;
+}
+
+std::size_t BlockStore::defragment() {
+    std::size_t rewritten = 0;
+    for (auto& d : devs_) {
+        if (!d->healthy.load(std::memory_order_relaxed)) continue;
+        std::error_code ec;
+        for (auto const& l1 : fs::directory_iterator(d->root, ec)) {
+            if (!l1.is_directory() || !is_shard_name(l1.path().filename().string())) continue;
+            for (auto const& l2 : fs::directory_iterator(l1.path(), ec)) {
+                if (!l2.is_directory() || !is_shard_name(l2.path().filename().string())) continue;
+                std::vector<std::string> parts;
+                for (auto const& f : fs::directory_iterator(l2.path(), ec))
+                    if (f.path().extension() == ".blk") parts.push_back(f.path().string());
+                for (auto& p : parts) {
+                    {
+                        std::lock_guard<std::mutex> g(defrag_mu_);
+                        if (defrag_stop_) return rewritten;
+                    }
+                    if (defragment_file(*d, p)) ++rewritten;
+                }
+            }
+        }
+    }
+    return rewritten;
+}
+
+void BlockStore::start_defragmenter(std::chrono::seconds interval) {
+    if (defragger_.joinable() || interval.count() <= 0) return;
+    defragger_ = std::thread([this, interval] {
+        std::unique_lock<std::mutex> lk(defrag_mu_);
+        while (!defrag_cv_.wait_for(lk, interval, [&] { return defrag_stop_; })) {
+            lk.unlock();
+            std::size_t n = defragment();
+            if (n) std::cerr << "[block_store] defragmented " << n << " part files\n";
+            lk.lock();
+        }
+    });
+}
+
+std::vector<BlockStore::DeviceInfo> BlockStore::devices() const {
+    std::vector<DeviceInfo> out;
+    for (auto& d : devs_) out.push_back(DeviceInfo{d->root, d->capacity, d->used.load(), d->part_size, d->healthy.load()});
+    return out;
+}
@@ -1,29 +1,131 @@
 #ifndef CACHE_BLOCK_STORE_H
 #define CACHE_BLOCK_STORE_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include <sys/types.h>
 
+struct StoreRoot {
+    std::string path;
+    std::size_t capacity = 0;   // bytes; 0 = bounded only by free space
+    std::size_t part_size = 0;  // for a new root; 0 = fs_layout::kDefaultPartSize
+};
+
+// Object part files under one or more cache roots. With several roots
+// (typically one per local SSD) every 64 MiB stripe of an object is placed
+// by rendezvous hashing, so a large object spreads over all devices and the
+// same stripe always maps to the same device. A full or failing device is
+// skipped and the stripe falls back to the next device in its order; reads
+// probe devices in that same order.
+//
+// Each root records its part file size in its layout header, and I/O that
+// spans several part files (or stripes) is split transparently.
+//
+// Shard directories seen to exist are remembered in a per-root bitset, so
+// writes make no mkdir calls once a directory is known.
+//
+// Objects whose size is known can have their extents reserved up front, and
+// an optional background pass rewrites part files whose data ended up in
+// many more extents than it has contiguous regions. Block I/O on an object
+// shares a striped lock that the rewrite takes exclusively.
 class BlockStore {
 public:
 
+static constexpr std::size_t kMaxDevices = 16;
+static constexpr std::size_t kStripeSize = 64ULL * 1024 * 1024;
+static constexpr std::size_t kReserveChunk = kStripeSize;
+
+struct DeviceInfo {
+    std::string root;
+    std::size_t capacity;
+    std::size_t used;
+    std::size_t part_size;
+    bool        healthy;
+};
+
 BlockStore(const std::string& cache_root, std::size_t block_size);
+BlockStore(std::vector<StoreRoot> roots, std::size_t block_size);
+~BlockStore();
 
 bool init();
 
-ssize_t read(const std::string& hash_hex, char* buf, std::size_t len,  off_t off);
+ssize_t read(std::string_view hash_hex, char* buf, std::size_t len,  off_t off);
+
+ssize_t write(std::string_view hash_hex, const char* buf, std::size_t len, off_t off, bool mark_dirty);
+
+bool delete_object(std::string_view hash_hex);
+
+// Releases the storage behind one block, leaving a hole in its part file.
+bool punch(std::string_view hash_hex, off_t off, std::size_t len);
 
-ssize_t write(const std::string& hash_hex, const char* buf, std::size_t len, off_t off, bool mark_dirty);
+// False if the block at `off` is missing or was punched out.
+bool holds(std::string_view hash_hex, off_t off);
 
-bool delete_object(const std::string& hash_hex);
+// Preallocates the first `size` bytes of an object in kReserveChunk steps
+// without changing file sizes, so unwritten ranges still read as holes.
+bool reserve(std::string_view hash_hex, std::size_t size);
+
+// Rewrites fragmented part files in place; returns how many were rewritten.
+std::size_t defragment();
+
+// Runs defragment() every `interval` until the store is destroyed.
+void start_defragmenter(std::chrono::seconds interval);
+
+std::vector<DeviceInfo> devices() const;
 
 void cleanup();
 
 private:
-std::string root_; 
+static constexpr std::size_t kShardDirs = 256 * 256;
+
+struct Device {
+    std::string               root;
+    std::size_t               capacity = 0;
+    std::size_t               part_size = 0;
+    std::atomic<std::size_t>  used{0};
+    std::atomic<std::size_t>  free{SIZE_MAX};
+    std::atomic<std::int64_t> free_checked{0};
+    std::atomic<unsigned>     errors{0};
+    std::atomic<bool>         healthy{true};
+    std::atomic<std::int64_t> retry_at{0};
+    std::mutex                recover_mu;
+    std::atomic<std::uint64_t> shard_dirs[kShardDirs / 64]{};
+};
+using Order = std::uint8_t[kMaxDevices];
+static constexpr std::size_t kLockStripes = 64;
+
+void    place(std::string_view hash_hex, off_t off, Order order) const;
+bool    usable(Device& d);
+bool    full(Device& d);
+void    note_error(Device& d, int err);
+int     open_part(Device& d, std::string_view hash_hex, std::size_t part_idx);
+void    ensure_shard_dirs(Device& d, std::string_view hash_hex);
+void    forget_shard_dirs(Device& d, std::string_view hash_hex);
+ssize_t write_to(Device& d, std::string_view hash_hex, const char* buf, std::size_t len, off_t off);
+ssize_t read_stripe(std::string_view hash_hex, char* buf, std::size_t len, off_t off);
+ssize_t write_stripe(std::string_view hash_hex, const char* buf, std::size_t len, off_t off);
+Device* reserve_device(std::string_view hash_hex, off_t off);
+bool    defragment_file(Device& d, const std::string& path);
+std::shared_mutex& lock_for(std::string_view hash_hex);
+
+std::vector<std::unique_ptr<Device>> devs_;
 std::size_t block_size_;
+std::shared_mutex locks_[kLockStripes];
+
+std::mutex              defrag_mu_;
+std::condition_variable defrag_cv_;
+bool                    defrag_stop_ = false;
+std::thread             defragger_;
 
 BlockStore(const BlockStore&)            = delete;
 BlockStore& operator=(const BlockStore&) = delete;
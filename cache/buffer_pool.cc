@@ -0,0 +1,125 @@
+#include "buffer_pool.h"
+
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <new>
+
+static constexpr std::size_t kHugePage     = 2 * 1024 * 1024;
+static constexpr std::size_t kLocalPerClass = 4;
+
+struct BufferPool::ThreadCache {
+    std::array<std::vector<char*>, kClasses> free;
+
+    ~ThreadCache() {
+        for (unsigned c = 0; c < kClasses; ++c) {
+            for (char* p : free[c]) BufferPool::instance().give_back(p, c);
+        }
+    }
+};
+
+BlockBuffer::BlockBuffer(BlockBuffer&& o) noexcept : p_(o.p_), size_(o.size_), cls_(o.cls_) {
+    o.p_ = nullptr;
+}
+
+BlockBuffer& BlockBuffer::operator=(BlockBuffer&& o) noexcept {
+    if (this != &o) {
+        if (p_) BufferPool::instance().release(p_, cls_);
+        p_ = o.p_; size_ = o.size_; cls_ = o.cls_;
+        o.p_ = nullptr;
+    }
+    return *this;
+}
+
+BlockBuffer::~BlockBuffer() {
+    if (p_) BufferPool::instance().release(p_, cls_);
+}
+
+BufferPool& BufferPool::instance() {
+    // Leaked on purpose: thread caches may return buffers during exit.
+    static BufferPool* pool = new BufferPool;
+    return *pool;
+}
+
+unsigned BufferPool::size_class(std::size_t size) {
+    unsigned cls = 0;
+    while (cls + 1 < kClasses && class_size(cls) < size) ++cls;
+    return cls;
+}
+
+BufferPool::ThreadCache& BufferPool::thread_cache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+BlockBuffer BufferPool::acquire(std::size_t size) {
+    if (size > kMaxSize) throw std::bad_alloc();
+    unsigned cls = size_class(size);
+
+    auto& local = thread_cache().free[cls];
+    if (!local.empty()) {
+        char* p = local.back();
+        local.pop_back();
+        return BlockBuffer(p, class_size(cls), cls);
+    }
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        auto& shared = shared_[cls];
+        if (!shared.empty()) {
+            char* p = shared.back();
+            shared.pop_back();
+            shared_bytes_ -= class_size(cls);
+            return BlockBuffer(p, class_size(cls), cls);
+        }
+    }
+    return BlockBuffer(allocate(cls), class_size(cls), cls);
+}
+
+void BufferPool::release(char* p, unsigned cls) {
+    auto& local = thread_cache().free[cls];
+    if (local.size() < kLocalPerClass) {
+        local.push_back(p);
+        return;
+    }
+    give_back(p, cls);
+}
+
+void BufferPool::give_back(char* p, unsigned cls) {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        if (shared_bytes_ + class_size(cls) <= kSharedBytes) {
+            shared_[cls].push_back(p);
+            shared_bytes_ += class_size(cls);
+            return;
+        }
+    }
+    deallocate(p, cls);
+}
+
+char* BufferPool::allocate(unsigned cls) {
+    std::size_t n = class_size(cls);
+    if (n >= kHugePage) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (hugepages_) p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+#endif
+        if (p == MAP_FAILED) {
+            p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+            if (hugepages_) ::madvise(p, n, MADV_HUGEPAGE);
+#endif
+        }
+        return static_cast<char*>(p);
+    }
+    void* p = nullptr;
+    if (::posix_memalign(&p, kAlign, n) != 0) throw std::bad_alloc();
+    return static_cast<char*>(p);
+}
+
+void BufferPool::deallocate(char* p, unsigned cls) {
+    std::size_t n = class_size(cls);
+    if (n >= kHugePage) ::munmap(p, n);
+    else std::free(p);
+}
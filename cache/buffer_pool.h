@@ -0,0 +1,82 @@
+#ifndef CACHE_BUFFER_POOL_H
+#define CACHE_BUFFER_POOL_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+// Page-aligned I/O buffer on loan from BufferPool; returned on destruction.
+class BlockBuffer {
+public:
+    BlockBuffer() = default;
+    BlockBuffer(BlockBuffer&& o) noexcept;
+    BlockBuffer& operator=(BlockBuffer&& o) noexcept;
+    ~BlockBuffer();
+
+    char*       data()       { return p_; }
+    const char* data() const { return p_; }
+    std::size_t size() const { return size_; }
+    explicit operator bool() const { return p_ != nullptr; }
+
+private:
+    friend class BufferPool;
+    BlockBuffer(char* p, std::size_t size, unsigned cls) : p_(p), size_(size), cls_(cls) {}
+
+    char*       p_    = nullptr;
+    std::size_t size_ = 0;
+    unsigned    cls_  = 0;
+
+    BlockBuffer(const BlockBuffer&)            = delete;
+    BlockBuffer& operator=(const BlockBuffer&) = delete;
+};
+
+// Process-wide pool of page-aligned block buffers in power-of-two size
+// classes (4 KiB .. 64 MiB). Each thread keeps a few buffers per class
+// locally, so steady-state acquire/release takes no lock and no syscall.
+// Buffers of 2 MiB and up can be backed by huge pages.
+class BufferPool {
+public:
+    static constexpr std::size_t kAlign    = 4096;
+    static constexpr std::size_t kMinShift = 12;
+    static constexpr std::size_t kClasses  = 15;
+    static constexpr std::size_t kMaxSize  = std::size_t(1) << (kMinShift + kClasses - 1);
+
+    static BufferPool& instance();
+
+    // Returns a buffer of at least `size` bytes; contents are unspecified.
+    BlockBuffer acquire(std::size_t size);
+
+    void set_hugepages(bool on) { hugepages_ = on; }
+
+private:
+    friend class BlockBuffer;
+    struct ThreadCache;
+
+    BufferPool() = default;
+
+    static ThreadCache& thread_cache();
+
+    static unsigned    size_class(std::size_t size);
+    static std::size_t class_size(unsigned cls) { return std::size_t(1) << (kMinShift + cls); }
+
+    char* allocate(unsigned cls);
+    void  deallocate(char* p, unsigned cls);
+    void  release(char* p, unsigned cls);
+    void  give_back(char* p, unsigned cls);
+
+    static constexpr std::size_t kSharedBytes = 256ULL * 1024 * 1024;
+
+    std::atomic<bool>                          hugepages_{false};
+    std::mutex                                 mu_;
+    std::array<std::vector<char*>, kClasses>   shared_;
+    std::size_t                                shared_bytes_ = 0;
+
+    BufferPool(const BufferPool&)            = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+};
+
+#endif
@@ -1,20 +1,35 @@
-#include "block_store.h"
+#include "access_profile.h"
+#include "block_fill.h"
+#include "buffer_pool.h"
+#include "cache_options.h"
+#include "cache_stats.h"
+#include "directory_scan.h"
 #include "metadata_store.h"
 #include "lru_policy.h"
 #include "thread_pool.h"
 #include "backend/backend.h"
 #include "fs_layout.h"
+#include "object_table.h"
+#include "pack_store.h"
+#include "ram_tier.h"
+#include "readahead.h"
+#include "storage_tiers.h"
 
 #include <algorithm>
 #include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <cstring>
 #include <filesystem>
-#include <iomanip>
+#include <limits>
 #include <mutex>
-#include <sstream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -25,104 +40,313 @@ namespace fs = std::filesystem;
 #ifndef PREFETCH_WINDOW
 #define PREFETCH_WINDOW 4
 #endif
-static constexpr std::size_t kBlockSize = 64 * 1024;
+static constexpr std::size_t kDefaultBlockSize = 64 * 1024;
+static constexpr std::size_t kMinBlockSize = 4 * 1024;
 static constexpr std::size_t kCacheBlocksCapacity = 200'000;
+static constexpr std::size_t kDefaultRamBytes = 256 * 1024 * 1024;
+static constexpr std::size_t kDefaultMigrateRate = 64 * 1024 * 1024;
+static constexpr std::size_t kDefaultPackMaxSize = 256 * 1024;
+static constexpr std::size_t kDefaultInlineMaxSize = 4 * 1024;
+static constexpr std::size_t kDefaultPreallocMaxSize = 1024ULL * 1024 * 1024;
+static constexpr unsigned kDefaultDefragInterval = 600;
+// Smaller files gain little from contiguous extents.
+static constexpr std::size_t kMinPreallocSize = 4 * 1024 * 1024;
+// Readahead never runs further ahead of a reader than this, or than twice
+// the bandwidth-delay product of a link fast enough to need more, up to
+// kMaxBdpReadaheadBytes.
+static constexpr std::size_t kMaxReadaheadBytes = 16 * 1024 * 1024;
+static constexpr std::size_t kMaxBdpReadaheadBytes = 256 * 1024 * 1024;
+// Prefetch batches (and tasks of each other background class) allowed to
+// wait for a worker; past this, readahead holds its plan back and asks
+// again on the reader's next access. Demand tasks are not bounded.
+static constexpr std::size_t kMaxPrefetchQueue = 64;
+// Blocks a prefetch task loads before requeueing the rest behind other work.
+static constexpr std::size_t kPrefetchChunk = 16;
+// Workers of the I/O pool: enough to use every request the backend lets
+// run at once.
+static constexpr std::size_t kIoThreads = 16;
+// Threads finishing block fetches whose first bytes were already returned;
+// kept apart from the prefetch pool so a reader never waits behind readahead.
+static constexpr std::size_t kFillThreads = 4;
+// Files up to this size are always worth fetching whole on open, however
+// slow the link; past it the limit follows the bandwidth-delay product.
+static constexpr std::size_t kMinEagerBytes = 64 * 1024;
+static constexpr double kEagerBdps = 4.0;
+static constexpr std::size_t kDefaultEagerMax = 1024 * 1024;
+// Directories whose listings are kept for spotting scans; past this the
+// oldest is forgotten.
+static constexpr std::size_t kMaxScannedDirs = 1024;
+static constexpr std::size_t kDefaultSiblingDepth = 4;
+static constexpr std::size_t kDefaultSiblingLead = 1024 * 1024;
+// Most a learned access profile prefetches on open.
+static constexpr std::size_t kMaxReplayBytes = 64 * 1024 * 1024;
+// Access history needed before it outweighs the file size in picking a block size.
+static constexpr std::uint32_t kMinProfileReads = 16;
+static constexpr std::uint32_t kMaxProfileReads = 1u << 20;
 
-static std::string hash_hex(const std::string& s) {
-    std::size_t h = std::hash<std::string>{}(s);
-    std::ostringstream oss;
-    oss << std::hex << std::setw(16) << std::setfill('0') << h;
-    return oss.str();
+// Concurrent range requests the misses of one read are split into: as many
+// as the backend currently lets run at once.
+static std::size_t read_fan_out() {
+    return std::clamp<std::size_t>(cache_fs::backend_inflight_stats().limit, 1, kIoThreads);
 }
 
-struct CacheEntry {
-    std::string path;
-    std::string hash_hex;
-    std::size_t last_block = std::numeric_limits<std::size_t>::max();
-    bool evicted    = false;
+// Readahead starts about one bandwidth-delay product ahead of a reader and
+// may grow to twice that. Until the link is measured it starts at
+// PREFETCH_WINDOW blocks.
+static void readahead_bounds(unsigned block_shift, std::size_t& min_window, std::size_t& max_window) {
+    const cache_fs::LinkEstimate link = cache_fs::backend_link_estimate();
+    const double bdp = link.rtt_sec * link.bytes_per_sec;
+    const auto max_bytes = static_cast<std::size_t>(
+        std::clamp(2 * bdp, double(kMaxReadaheadBytes), double(kMaxBdpReadaheadBytes)));
+    max_window = std::max<std::size_t>(PREFETCH_WINDOW, max_bytes >> block_shift);
+    if (!link.bytes_per_sec) {
+        min_window = PREFETCH_WINDOW;
+        return;
+    }
+    const std::size_t bdp_blocks = (static_cast<std::size_t>(bdp) + (std::size_t(1) << block_shift) - 1) >> block_shift;
+    min_window = std::clamp<std::size_t>(bdp_blocks, 1, max_window);
+}
+
+static bool valid_block_size(std::size_t bs) {
+    return bs >= kMinBlockSize && bs <= BufferPool::kMaxSize && (bs & (bs - 1)) == 0;
+}
+
+// One unbounded tier at the cache root unless tiers are configured.
+static std::vector<TierConfig> tier_configs(const std::string& root, const cache_options& opts) {
+    std::vector<TierConfig> tiers;
+    for (int i = 0; i < opts.ntiers; ++i) {
+        const cache_tier& t = opts.tiers[i];
+        std::vector<StoreRoot> roots;
+        for (int d = 0; d < t.nroots; ++d) roots.push_back(StoreRoot{t.roots[d], t.device_capacity, opts.part_size});
+        tiers.push_back(TierConfig{std::move(roots), t.capacity});
+    }
+    if (tiers.empty()) tiers.push_back(TierConfig{std::vector<StoreRoot>{StoreRoot{root, 0, opts.part_size}}, 0});
+    return tiers;
+}
+
+// Layout of an entry captured under the manager lock, so block I/O can run
+// without it. The path view points into the object table and stays valid.
+struct ObjectRef {
+    ObjectId         id;
+    std::size_t      block_size;
+    unsigned         block_shift;
+    bool             packed;
+    bool             inlined;
+    PathHash         hash;
+    std::string_view path;
+    char             name_buf[kObjectNameMax];
+    std::uint8_t     name_len;
+
+    explicit ObjectRef(const CacheEntry& ce)
+    : id(ce.id), block_size(ce.block_size), block_shift(ce.block_shift), packed(ce.packed), inlined(ce.inlined),
+      hash(ce.hash),
+      path(ce.path), name_len(ce.name_len) {
+        std::memcpy(name_buf, ce.name_buf, ce.name_len);
+    }
+    std::string_view name() const { return {name_buf, name_len}; }
+    std::string_view hash_hex() const { return {name_buf, kPathHashHexLen}; }
+    PackKey pack_key(std::size_t blk) const {
+        return PackKey{hash.hi, hash.lo, static_cast<std::uint32_t>(blk), block_shift};
+    }
+};
+
+// Blocks first .. first + count - 1 of an object loaded together: claimed
+// by claim_run, then fetched and published by finish_run.
+struct RunLoad {
+    enum Kind : std::uint8_t { kCached, kProbe, kFetch, kDisk, kOther };
+    std::size_t              first = 0;
+    std::size_t              count = 0;
+    std::uint32_t            gen = 0;
+    std::vector<Kind>        kind;
+    std::vector<BlockBuffer> bufs;
+    std::vector<ssize_t>     got;
 };
 
 class CacheManager {
 public:
-    explicit CacheManager(const std::string& root) : store_(root, kBlockSize), meta_("cache_meta.db", root), lru_(kCacheBlocksCapacity), prefetch_pool_(4), root_(root) {
-        store_.init();
+    CacheManager(const std::string& root, const cache_options& opts) : opts_(opts), meta_("cache_meta.db", root), lru_(kCacheBlocksCapacity), ram_(opts.ram_bytes), root_(root),
+        tiers_(tier_configs(root, opts), opts.block_size, opts.migrate_bytes_per_sec, opts.promote_hits),
+        pack_(fs_layout::pack_dir(root)), fill_pool_(kFillThreads), io_pool_(kIoThreads, kMaxPrefetchQueue) {
+        tiers_.init([this](ObjectId id, char* name, std::size_t& name_len, std::size_t& bs) {
+            return resolve_object(id, name, name_len, bs);
+        });
         meta_.init();
+        pack_.init();
+        tiers_.start_defragmenter(std::chrono::seconds(opts.defrag_interval_sec));
     }
 
-    ssize_t read(const std::string& path, char* buf, std::size_t len, off_t off);
+    ssize_t read(std::string_view path, char* buf, std::size_t len, off_t off);
 
-    ssize_t write(const std::string& path, const char* buf, std::size_t len, off_t off);
+    ssize_t write(std::string_view path, const char* buf, std::size_t len, off_t off);
     void   flush_all();
     void   evict_until_gb(double free_gb);
-    bool has_valid_entry(const std::string& path) {
+    void   hint_size(std::string_view path, std::size_t size);
+    void   get_stats(cache_stats& out);
+    bool   get_file_stats(std::string_view path, cache_file_stats& out);
+    void   note_directory(std::string_view dir, std::vector<std::string> names);
+    void   open_file(std::string_view path);
+    void   close_file(std::string_view path);
+    bool has_valid_entry(std::string_view path) {
         std::lock_guard<std::mutex> g(mu_);
-        auto it = entries_.find(path);
-        return it != entries_.end() && !it->second.evicted;
+        CacheEntry* ce = entries_.find(path);
+        return ce && !ce->evicted;
     }
-    CacheEntry* get_entry(const std::string& path) {
+    CacheEntry* get_entry(std::string_view path) {
         std::lock_guard<std::mutex> g(mu_);
-        auto it = entries_.find(path);
-        return (it != entries_.end() && !it->second.evicted) ? &it->second : nullptr;
+        CacheEntry* ce = entries_.find(path);
+        return (ce && !ce->evicted) ? ce : nullptr;
     }
 
 private:
-    CacheEntry& entry(const std::string& path);
-    void schedule_prefetch(CacheEntry ce, std::size_t first_blk);
+    CacheEntry& entry(std::string_view path);
+    std::size_t pick_block_size(const CacheEntry& ce) const;
+    void pick_store(CacheEntry& ce) const;
+    void uninline(CacheEntry& ce);
+    void unpack(CacheEntry& ce);
+    void repick_block_size(CacheEntry& ce);
+    void note_access(CacheEntry& ce, std::size_t blk);
+    void note_stored(CacheEntry& ce);
+    void preallocate(const CacheEntry& ce);
+    void save_object(const CacheEntry& ce);
+    void touch_block(const CacheEntry& ce, std::size_t blk, double hotness);
+    CacheEntry* live_entry(const ObjectRef& ref);
+    ssize_t read_stored(const ObjectRef& ref, BlockKey key, std::size_t blk, char* buf);
+    ssize_t read_inline(const ObjectRef& ref, std::size_t blk, char* buf);
+    ssize_t write_stored(const ObjectRef& ref, BlockKey key, std::size_t blk, const char* buf, std::size_t len);
+    void erase_packed(const CacheEntry& ce);
+    std::uintmax_t disk_bytes() const;
+    void drop_data(CacheEntry& ce);
+    std::size_t evict_entry(CacheEntry& ce);
+    RamTier::Handle load_block(const ObjectRef& ref, std::size_t blk, IoPriority prio = IoPriority::kDemand,
+                               std::size_t need = SIZE_MAX);
+    RamTier::Handle run_fill(const ObjectRef& ref, std::size_t blk, BlockFill& fill, std::uint32_t gen,
+                             IoPriority prio, bool* stale = nullptr);
+    ssize_t fetch_range(const ObjectRef& ref, char* buf, std::size_t len, off_t off, IoPriority prio,
+                        const cache_fs::Progress& progress = nullptr);
+    ssize_t fetch_range(const ObjectRef& ref, const iovec* iov, int iovcnt, off_t off, IoPriority prio,
+                        const cache_fs::Progress& progress = nullptr);
+    void load_run(const ObjectRef& ref, std::size_t first, std::size_t count, IoPriority prio);
+    bool claim_run(const ObjectRef& ref, std::size_t first, std::size_t count, RunLoad& run);
+    void finish_run(const ObjectRef& ref, RunLoad& run, IoPriority prio);
+    std::size_t eager_limit() const;
+    void replay_profile(const ObjectRef& ref, const AccessProfile& profile, std::size_t size);
+    void save_profile(const CacheEntry& ce);
+    void prefetch_siblings(std::string_view path);
+    void fetch_misses(const ObjectRef& ref, std::size_t first_blk, std::size_t last_blk);
+    void note_read(const ObjectRef& ref, std::size_t first_blk, std::size_t last_blk);
+    bool resolve_object(ObjectId id, char* name, std::size_t& name_len, std::size_t& bs);
+    bool schedule_prefetch(const ObjectRef& ref, const Readahead::Plan& plan, std::uint32_t gen);
 
+    cache_options opts_;
     std::mutex mu_;
-    BlockStore store_;
     MetadataStore meta_;
     LruPolicy lru_;
-    ThreadPool prefetch_pool_;
-    std::unordered_map<std::string, CacheEntry> entries_;
+    RamTier ram_;
+    ObjectTable entries_;
     std::string root_;
+    std::uint64_t disk_hits_ = 0;
+    std::uint64_t inline_hits_ = 0;
+    std::uint64_t backend_reads_ = 0;
+    std::uint64_t backend_fetches_ = 0;
+    std::uint64_t eager_fetches_ = 0;
+    std::uint64_t profile_replays_ = 0;
+    std::uint64_t profile_blocks_ = 0;
+    std::uint64_t sibling_issued_ = 0;
+    std::uint64_t sibling_hits_ = 0;
+    std::uint64_t sibling_wasted_ = 0;
+    std::uint64_t prefetch_issued_ = 0;
+    std::uint64_t prefetch_hits_ = 0;
+    std::uint64_t prefetch_wasted_bytes_ = 0;
+    FlatHashMap<ObjectId, Readahead> readahead_;
+    // Accesses since open of the files open now, saved on close.
+    FlatHashMap<ObjectId, AccessProfile> profiles_;
+    // Listed directories by path, for spotting scans across their files.
+    std::unordered_map<std::string, DirectoryScan> dirs_;
+    // Blocks being loaded; other loads of them wait on inflight_cv_, or on
+    // the fill if the block is coming from the backend.
+    FlatHashMap<BlockKey, std::shared_ptr<BlockFill>> inflight_;
+    std::condition_variable inflight_cv_;
+    std::size_t background_fills_ = 0;
+    StorageTiers tiers_;
+    PackStore pack_;
+    // Declared last so they are destroyed first: queued work still uses the
+    // members above, and io_pool_ tasks hand fills to fill_pool_.
+    ThreadPool fill_pool_;
+    ThreadPool io_pool_;
 };
 
-ssize_t CacheManager::read(const std::string& path, char* buf, std::size_t len, off_t off) {
-    std::lock_guard<std::mutex> g(mu_);
-    CacheEntry& ce = entry(path);
-    if (ce.evicted) return -ENOENT;
+// RAM-tier hits take the manager lock only to resolve the path and, once
+// per call, to record the access; misses drop it around disk and backend I/O.
+// A read spanning several blocks fetches its misses in parallel first.
+ssize_t CacheManager::read(std::string_view path, char* buf, std::size_t len, off_t off) {
+    std::optional<ObjectRef> ref;
+    std::size_t size;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        CacheEntry& ce = entry(path);
+        if (ce.evicted) return -ENOENT;
+        ref.emplace(ce);
+        size = ce.size_hint;
+    }
+    const std::size_t bs = ref->block_size;
+    const std::size_t first_blk = off >> ref->block_shift;
+    std::size_t last_blk = first_blk;
+    if (len) {
+        std::size_t end = off + len;
+        if (size) end = std::min<std::size_t>(end, size);
+        if (end > static_cast<std::size_t>(off)) fetch_misses(*ref, first_blk, (end - 1) >> ref->block_shift);
+    }
 
-    ssize_t done = 0;
-    while (done < static_cast<ssize_t>(len)) {
-        std::size_t blk = (off + done) / kBlockSize;
-        off_t blk_off   = blk * kBlockSize;
+    std::size_t done = 0;
+    while (done < len) {
+        std::size_t blk = (off + done) >> ref->block_shift;
+        off_t blk_off   = blk * bs;
         std::size_t in  = (off + done) - blk_off;
-        std::size_t want= std::min<std::size_t>(kBlockSize - in, len - done);
-
-        char block[kBlockSize];
-        bool cached = store_.read(ce.hash_hex, block,kBlockSize, blk_off) == static_cast<ssize_t>(kBlockSize);
-        if (!cached) {
-            ssize_t got = cache_fs::backend_read_range(path, block, kBlockSize, blk_off);
-            if (got <= 0) {
-                fs::path src = fs::path(root_) /
-                            fs::path(path[0] == '/' ? path.substr(1) : path);
-                int fd = ::open(src.c_str(), O_RDONLY);
-                if (fd >= 0) {
-                    got = ::pread(fd, block, kBlockSize, blk_off);
-                    ::close(fd);
-                }
-            }
-            if (got <= 0) return (done ? done : -1);
-            store_.write(ce.hash_hex, block, got, blk_off, false);
-        }
-        std::memcpy(buf + done, block + in, want);
-        done += want;
-
-        lru_.touch(reinterpret_cast<std::uintptr_t>(&ce)<<32 | blk, kBlockSize, 1.0);
+        std::size_t want= std::min<std::size_t>(bs - in, len - done);
 
-        bool seq = (ce.last_block != std::numeric_limits<std::size_t>::max()) && (blk == ce.last_block + 1);
-        ce.last_block = blk;
-        if (seq) schedule_prefetch(ce, blk + 1);
+        RamTier::Handle h;
+        if (blk <= kMaxKeyedBlock) h = ram_.get(make_block_key(ref->id, blk));
+        if (!h) h = load_block(*ref, blk, IoPriority::kDemand, in + want);
+        if (!h) {
+            if (!done) return -1;
+            break;
+        }
+        if (h->len <= in) break;
+        std::size_t n = std::min(want, h->len - in);
+        std::memcpy(buf + done, h->data() + in, n);
+        done += n;
+        last_blk = blk;
+        if (n < want) break;
     }
+    if (done) note_read(*ref, first_blk, last_blk);
     return done;
 }
 
-ssize_t CacheManager::write(const std::string& path, const char* buf, std::size_t len, off_t off)
+ssize_t CacheManager::write(std::string_view path, const char* buf, std::size_t len, off_t off)
 {
-    std::lock_guard<std::mutex> g(mu_);
+    std::unique_lock<std::mutex> g(mu_);
     CacheEntry& ce = entry(path);
+    // A load of a block the write only partly covers would be dropped as
+    // stale, and the write would pad the block with zeros where the loaded
+    // bytes belong; let it land first.
+    auto loading = [&](std::size_t at) {
+        const std::size_t blk = at >> ce.block_shift;
+        return blk <= kMaxKeyedBlock && inflight_.contains(make_block_key(ce.id, blk));
+    };
+    if (len) inflight_cv_.wait(g, [&] { return !loading(off) && !loading(off + len - 1); });
     if (ce.evicted) return -ENOENT;
+    ++ce.write_gen;
+    if (ce.inlined && off + len > ce.block_size) {
+        ce.size_hint = std::max<std::size_t>(ce.size_hint, off + len);
+        uninline(ce);
+    }
+    // Recording the new size keeps the origin's report of it from reading
+    // as a change made elsewhere.
+    if (off + len > ce.size_hint) {
+        ce.size_hint = off + len;
+        if (ce.packed && ce.size_hint > opts_.pack_max_size) unpack(ce);
+    }
+    const ObjectRef ref(ce);
 
     int dst_fd = -1;
     auto ensure_dst = [&] {
@@ -133,21 +357,44 @@ ssize_t CacheManager::write(const std::string& path, const char* buf, std::size_
     dst_fd = ::open(dst.c_str(), O_RDWR | O_CREAT, 0644);
 };
 
+const std::size_t bs = ce.block_size;
+BlockBuffer buffer = BufferPool::instance().acquire(bs);
+char* block = buffer.data();
+
 std::size_t done = 0;
 while (done < len) {
-std::size_t blk  = (off + done) / kBlockSize;
-off_t       boff = blk * kBlockSize;
+std::size_t blk  = (off + done) >> ce.block_shift;
+off_t       boff = blk * bs;
 std::size_t in   = (off + done) - boff;
-std::size_t chunk= std::min<std::size_t>(kBlockSize - in, len - done);
+std::size_t chunk= std::min<std::size_t>(bs - in, len - done);
 
-char block[kBlockSize]{};
-store_.read(ce.hash_hex, block, kBlockSize, boff);
+// Only the bytes not covered by the old block or the new data need zeroing.
+BlockKey key = blk <= kMaxKeyedBlock ? make_block_key(ce.id, blk) : kInvalidBlockKey;
+RamTier::Handle old = key != kInvalidBlockKey ? ram_.find(key) : nullptr;
+ssize_t have;
+if (old) {
+    have = static_cast<ssize_t>(std::min(old->len, bs));
+    std::memcpy(block, old->data(), have);
+} else {
+    have = std::max<ssize_t>(ref.inlined ? read_inline(ref, blk, block) : read_stored(ref, key, blk, block), 0);
+}
+if (static_cast<std::size_t>(have) < in) std::memset(block + have, 0, in - have);
 std::memcpy(block + in, buf + done, chunk);
-store_.write(ce.hash_hex, block, kBlockSize, boff, true);
+std::size_t filled = std::max<std::size_t>(have, in + chunk);
+if (filled < bs) std::memset(block + filled, 0, bs - filled);
+// Packed and inline copies keep only the bytes written, not the zero padding.
+std::size_t stored = ce.packed || ce.inlined ? filled : bs;
+if (write_stored(ref, key, blk, block, stored) > 0) note_stored(ce);
 
-meta_.markDirtyBlock(ce.hash_hex, boff / fs_layout::kMaxPartSize, blk);
-lru_.touch(reinterpret_cast<std::uintptr_t>(&ce)<<32 | blk,
-kBlockSize, 1.0);
+if (!ce.packed && !ce.inlined) meta_.markDirtyBlock(ce.name(), boff / opts_.part_size, blk);
+ce.present.set(blk, BlockPresence::kPresent);
+touch_block(ce, blk, 1.0);
+// Blocks already in RAM are replaced; others are not pulled in by writes.
+if (old) {
+    ram_.put(key, std::move(buffer), stored);
+    buffer = BufferPool::instance().acquire(bs);
+    block = buffer.data();
+}
 
 ensure_dst();
 ::pwrite(dst_fd, buf + done, chunk, off + done);
@@ -158,63 +405,972 @@ if (dst_fd != -1) ::close(dst_fd);
 return done;
 }
 
+// Fills finishing in the background are waited for, so their blocks are
+// stored before the bitmaps are.
 void CacheManager::flush_all() {
-    std::lock_guard<std::mutex> g(mu_);
-    for (auto& [_, ce] : entries_) meta_.flushBitmaps(ce.hash_hex);
+    std::unique_lock<std::mutex> g(mu_);
+    inflight_cv_.wait(g, [&] { return background_fills_ == 0; });
+    entries_.for_each([&](CacheEntry& ce) {
+        if (!ce.block_size) return;
+        meta_.flushBitmaps(ce.name());
+        if (ce.has_data) save_object(ce);
+        save_profile(ce);
+    });
+}
+
+// Counts allocated rather than logical bytes, so preallocated extents past
+// the end of a part file count against the budget.
+std::uintmax_t CacheManager::disk_bytes() const {
+    std::uintmax_t bytes = 0;
+    std::error_code ec;
+    struct stat st;
+    for (auto it = fs::recursive_directory_iterator(root_, ec); !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec))
+        if (it->is_regular_file(ec) && ::stat(it->path().c_str(), &st) == 0) bytes += std::uintmax_t(st.st_blocks) * 512;
+    return bytes;
+}
+
+// Drops everything stored for the entry. Caller holds mu_.
+void CacheManager::drop_data(CacheEntry& ce) {
+    if (ce.inlined) meta_.eraseInline(ce.hash_hex());
+    else if (ce.packed) erase_packed(ce);
+    else tiers_.delete_object(ce.id, ce.hash_hex());
+    ram_.erase_object(ce.id);
+    meta_.flushBitmaps(ce.name());
+    ce.present.clear();
+    readahead_.erase(ce.id);
+    ce.has_data = false;
 }
 
+// Returns roughly how many bytes evicting the entry freed.
+std::size_t CacheManager::evict_entry(CacheEntry& ce) {
+    std::size_t freed = ce.present.count(BlockPresence::kPresent) * ce.block_size;
+    if (!freed) freed = std::max(ce.size_hint, ce.block_size);
+    drop_data(ce);
+    ce.evicted = true;
+    save_object(ce);
+    return freed;
+}
+
+// Walking the store is slow, so it runs without mu_ and the lock is taken
+// once per evicted entry. Between walks the excess is counted down by each
+// entry's estimated size.
 void CacheManager::evict_until_gb(double free_gb) {
-    auto used_gb = [&] {
-        std::uintmax_t bytes = 0;
-        for (auto& f : fs::recursive_directory_iterator(root_))
-            if (f.is_regular_file()) bytes += f.file_size();
-        return double(bytes)/(1024.0*1024.0*1024.0);
-    };
-    while (used_gb() > free_gb) {
-        std::uintptr_t key = lru_.evict();
-        if (key == std::numeric_limits<std::uintptr_t>::max()) break;
-        auto* ce = reinterpret_cast<CacheEntry*>(key >> 32);
-        if (!ce || ce->evicted) continue;
-        store_.delete_object(ce->hash_hex);
-        meta_.flushBitmaps(ce->hash_hex);
-        ce->evicted = true;
-    }
-}
-
-CacheEntry& CacheManager::entry(const std::string& path) {
-    auto it = entries_.find(path);
-    if (it != entries_.end()) return it->second;
-    CacheEntry ce{path, hash_hex(path)};
-    return entries_.emplace(path, std::move(ce)).first->second;
-}
-
-void CacheManager::schedule_prefetch(CacheEntry ce, std::size_t first_blk) {
-    prefetch_pool_.enqueue([this, ce, first_blk]() {
-        for (std::size_t i = 0; i < PREFETCH_WINDOW; ++i) {
-            std::size_t blk = first_blk + i;
-            off_t off       = blk * kBlockSize;
-            char  buf[kBlockSize];
-            if (store_.read(ce.hash_hex, buf, kBlockSize, off) ==
-                static_cast<ssize_t>(kBlockSize))
+    const auto budget = static_cast<std::uintmax_t>(free_gb * 1024.0 * 1024.0 * 1024.0);
+    for (std::uintmax_t used = disk_bytes(); used > budget; used = disk_bytes()) {
+        std::uintmax_t excess = used - budget;
+        while (excess) {
+            std::lock_guard<std::mutex> g(mu_);
+            BlockKey key = lru_.evict();
+            if (key == kInvalidBlockKey) return;
+            CacheEntry* ce = entries_.get(key_object(key));
+            if (!ce || ce->evicted) continue;
+            excess -= std::min<std::uintmax_t>(excess, evict_entry(*ce));
+        }
+    }
+}
+
+void CacheManager::hint_size(std::string_view path, std::size_t size) {
+    std::lock_guard<std::mutex> g(mu_);
+    CacheEntry& ce = entry(path);
+    if (ce.size_hint == size) return;
+    // A recorded size that no longer matches means the origin's copy changed
+    // since it was cached, so nothing cached of it can be trusted.
+    // Inline and packed objects always have one, so this also moves them
+    // out when they outgrow their store.
+    const bool stale = ce.has_data && ce.size_hint;
+    if (stale) {
+        ++ce.write_gen;
+        drop_data(ce);
+    }
+    ce.size_hint = size;
+    repick_block_size(ce);
+    if (stale) save_object(ce);
+}
+
+// New entries restore their block size and access history from the objects
+// table; an entry whose objects were evicted keeps only the history.
+CacheEntry& CacheManager::entry(std::string_view path) {
+    CacheEntry& ce = entries_.intern(path);
+    if (ce.block_size) return ce;
+
+    if (auto rec = meta_.getObject(ce.hash_hex())) {
+        ce.size_hint  = rec->size;
+        ce.seq_reads  = rec->seq_reads;
+        ce.rand_reads = rec->rand_reads;
+        if (valid_block_size(rec->block_size)) {
+            ce.set_block_shift(__builtin_ctzll(rec->block_size));
+            ce.packed   = rec->packed;
+            ce.inlined  = rec->inlined;
+            ce.has_data = true;
+            return ce;
+        }
+    }
+    ce.set_block_shift(__builtin_ctzll(pick_block_size(ce)));
+    pick_store(ce);
+    return ce;
+}
+
+// Small files and random access get small blocks to cut read amplification;
+// large files and sequential streams get large blocks to cut per-block cost.
+std::size_t CacheManager::pick_block_size(const CacheEntry& ce) const {
+    if (!opts_.adaptive_blocks) return opts_.block_size;
+    if (ce.size_hint && ce.size_hint <= opts_.small_file_max) return opts_.small_block_size;
+
+    std::uint32_t reads = ce.seq_reads + ce.rand_reads;
+    if (reads >= kMinProfileReads) {
+        if (ce.seq_reads * 4 < reads) return opts_.small_block_size;
+        if (ce.seq_reads * 4 >= reads * 3) return opts_.large_block_size;
+    }
+    if (ce.size_hint >= opts_.large_file_min) return opts_.large_block_size;
+    return opts_.block_size;
+}
+
+// Tiny files that fit one block live in the metadata store and small ones
+// share segment files; the rest get part files of their own.
+void CacheManager::pick_store(CacheEntry& ce) const {
+    bool known = ce.size_hint != 0;
+    ce.inlined = known && ce.size_hint <= std::min(opts_.inline_max_size, ce.block_size);
+    ce.packed  = !ce.inlined && known && ce.size_hint <= opts_.pack_max_size;
+}
+
+// The block size and store are fixed once the object holds data.
+void CacheManager::repick_block_size(CacheEntry& ce) {
+    if (ce.has_data) return;
+    std::size_t bs = pick_block_size(ce);
+    if (bs != ce.block_size) {
+        ce.set_block_shift(__builtin_ctzll(bs));
+        ram_.erase_object(ce.id);
+        ce.present.clear();
+        ce.last_block = std::numeric_limits<std::size_t>::max();
+    }
+    pick_store(ce);
+}
+
+// A file that outgrew its inline copy goes back to block storage, with the
+// copy carried over as its first block.
+void CacheManager::uninline(CacheEntry& ce) {
+    BlockBuffer buffer = BufferPool::instance().acquire(ce.block_size);
+    ssize_t have = ce.has_data ? read_inline(ObjectRef(ce), 0, buffer.data()) : -ENOENT;
+    meta_.eraseInline(ce.hash_hex());
+    ram_.erase_object(ce.id);
+    ce.present.clear();
+    ce.has_data = false;
+    repick_block_size(ce);
+    if (have > 0 && static_cast<std::size_t>(have) <= ce.block_size &&
+        write_stored(ObjectRef(ce), make_block_key(ce.id, 0), 0, buffer.data(), have) > 0) {
+        ce.has_data = true;
+        ce.present.set(0, BlockPresence::kPresent);
+    }
+    save_object(ce);
+}
+// An object that grew past pack_max_size moves to the tier store. Its blocks
+// carry over if its block size stays; otherwise they are fetched again.
+void CacheManager::unpack(CacheEntry& ce) {
+    const ObjectRef from(ce);
+    const bool keep = ce.has_data && pick_block_size(ce) == ce.block_size;
+    ce.packed = false;
+    const ObjectRef to(ce);
+    bool kept = false;
+    if (keep) {
+        BlockBuffer buffer = BufferPool::instance().acquire(ce.block_size);
+        const auto bs = static_cast<ssize_t>(ce.block_size);
+        for (std::size_t blk = 0; blk < ce.present.size(); ++blk) {
+            if (ce.present.get(blk) != BlockPresence::kPresent) continue;
+            // Packed copies drop the zero padding that tier blocks keep.
+            ssize_t n = pack_.read(from.pack_key(blk), buffer.data(), ce.block_size);
+            if (n > 0 && n < bs) std::memset(buffer.data() + n, 0, bs - n);
+            bool moved = n > 0 && write_stored(to, make_block_key(ce.id, blk), blk, buffer.data(), ce.block_size) == bs;
+            ce.present.set(blk, moved ? BlockPresence::kPresent : BlockPresence::kAbsent);
+            kept |= moved;
+        }
+    }
+    erase_packed(ce);
+    if (!kept) {
+        ram_.erase_object(ce.id);
+        ce.present.clear();
+        ce.has_data = false;
+        repick_block_size(ce);
+    }
+    save_object(ce);
+}
+
+void CacheManager::note_access(CacheEntry& ce, std::size_t blk) {
+    if (blk == ce.last_block) return;
+    if (ce.last_block != std::numeric_limits<std::size_t>::max() && blk == ce.last_block + 1) ++ce.seq_reads;
+    else ++ce.rand_reads;
+    if (ce.seq_reads + ce.rand_reads >= kMaxProfileReads) {
+        ce.seq_reads /= 2;
+        ce.rand_reads /= 2;
+    }
+}
+
+void CacheManager::note_stored(CacheEntry& ce) {
+    if (ce.has_data) return;
+    ce.has_data = true;
+    save_object(ce);
+    preallocate(ce);
+}
+
+// Runs off the calling thread and outside the manager lock. An eviction
+// that deletes the object meanwhile can have part of the reserve recreated
+// behind it, so an object found evicted afterwards is deleted again; an
+// evicted entry never gets data back. Skipped when the pool's queue is
+// full, since the caller holds the lock.
+void CacheManager::preallocate(const CacheEntry& ce) {
+    if (ce.packed || ce.inlined || ce.size_hint < kMinPreallocSize || ce.size_hint > opts_.preallocate_max_size)
+        return;
+    io_pool_.try_post([this, ref = ObjectRef(ce), size = ce.size_hint]() {
+        {
+            std::lock_guard<std::mutex> g(mu_);
+            if (!live_entry(ref)) return;
+        }
+        tiers_.reserve(ref.name(), size);
+        std::lock_guard<std::mutex> g(mu_);
+        CacheEntry* ce = entries_.get(ref.id);
+        if (ce && ce->evicted) tiers_.delete_object(ref.id, ref.hash_hex());
+    }, IoPriority::kBackground);
+}
+
+void CacheManager::save_object(const CacheEntry& ce) {
+    ObjectRecord rec;
+    rec.hash       = std::string(ce.hash_hex());
+    rec.path       = std::string(ce.path);
+    rec.block_size = ce.has_data ? ce.block_size : 0;
+    rec.size       = ce.size_hint;
+    rec.seq_reads  = ce.seq_reads;
+    rec.rand_reads = ce.rand_reads;
+    rec.packed     = ce.has_data && ce.packed;
+    rec.inlined    = ce.has_data && ce.inlined;
+    meta_.putObject(rec);
+}
+
+// Blocks past kMaxKeyedBlock cannot be keyed and are served untracked.
+void CacheManager::touch_block(const CacheEntry& ce, std::size_t blk, double hotness) {
+    if (blk > kMaxKeyedBlock) return;
+    lru_.touch(make_block_key(ce.id, blk), static_cast<std::uint32_t>(ce.block_size), hotness);
+}
+
+CacheEntry* CacheManager::live_entry(const ObjectRef& ref) {
+    CacheEntry* ce = entries_.get(ref.id);
+    return (ce && !ce->evicted && ce->block_size == ref.block_size && ce->packed == ref.packed &&
+            ce->inlined == ref.inlined) ? ce : nullptr;
+}
+
+// Called without mu_ held; write_stored and read_inline expect it held.
+ssize_t CacheManager::read_stored(const ObjectRef& ref, BlockKey key, std::size_t blk, char* buf) {
+    if (ref.inlined) {
+        std::lock_guard<std::mutex> g(mu_);
+        return read_inline(ref, blk, buf);
+    }
+    if (ref.packed) return pack_.read(ref.pack_key(blk), buf, ref.block_size);
+    return tiers_.read(key, ref.name(), buf, ref.block_size, blk * ref.block_size);
+}
+
+ssize_t CacheManager::read_inline(const ObjectRef& ref, std::size_t blk, char* buf) {
+    if (blk) return -ENOENT;
+    return meta_.getInline(ref.hash_hex(), buf, ref.block_size);
+}
+
+// Inline objects hold a single block; the tail of a file that turns out
+// larger is not stored.
+ssize_t CacheManager::write_stored(const ObjectRef& ref, BlockKey key, std::size_t blk, const char* buf, std::size_t len) {
+    if (ref.inlined) return blk ? -EFBIG : meta_.putInline(ref.hash_hex(), buf, len) ? static_cast<ssize_t>(len) : -EIO;
+    if (ref.packed) return pack_.write(ref.pack_key(blk), buf, len);
+    return tiers_.write(key, ref.name(), buf, len, blk * ref.block_size);
+}
+
+// A packed object never grew past the larger of its size and the packing
+// limit while it held data, which bounds the blocks to drop.
+void CacheManager::erase_packed(const CacheEntry& ce) {
+    pack_.erase_object(ce.hash.hi, ce.hash.lo);
+}
+
+// Reads a block from disk, or from the backend if the disk copy is missing
+// or short, and publishes it to the RAM tier. The result is dropped and the
+// load retried if a write to the object lands while the lock is released.
+// Concurrent loads of one block wait for the first rather than fetch it again.
+// A backend fetch fills the block progressively: a caller that needs only its
+// first `need` bytes gets a copy of them as soon as they arrive, while the
+// rest of the block and the disk write finish on fill_pool_.
+RamTier::Handle CacheManager::load_block(const ObjectRef& ref, std::size_t blk, IoPriority prio, std::size_t need) {
+    const std::size_t bs = ref.block_size;
+    const off_t blk_off  = blk * bs;
+    const BlockKey key   = blk <= kMaxKeyedBlock ? make_block_key(ref.id, blk) : kInvalidBlockKey;
+    for (;;) {
+        BlockPresence::State state;
+        std::uint32_t gen;
+        std::shared_ptr<BlockFill> fill;
+        {
+            std::unique_lock<std::mutex> g(mu_);
+            if (key != kInvalidBlockKey) {
+                inflight_cv_.wait(g, [&] {
+                    auto it = inflight_.find(key);
+                    if (it == inflight_.end()) return true;
+                    if (it->second && need < bs) fill = it->second;
+                    return fill != nullptr;
+                });
+                if (!fill) {
+                    if (RamTier::Handle h = ram_.find(key)) return h;
+                }
+            }
+            if (!fill) {
+                CacheEntry* ce = live_entry(ref);
+                if (!ce) return nullptr;
+                state = ce->present.get(blk);
+                gen   = ce->write_gen;
+                if (key != kInvalidBlockKey) inflight_[key] = nullptr;
+            }
+        }
+        if (fill) {
+            if (RamTier::Handle h = fill->wait(need)) return h;
+            if (fill->failed()) return nullptr;
+            continue;   // already handed to the RAM tier
+        }
+
+        BlockBuffer buffer = BufferPool::instance().acquire(bs);
+        char* block = buffer.data();
+        ssize_t got = state != BlockPresence::kAbsent ? read_stored(ref, key, blk, block) : 0;
+        // Packed and inline copies hold exactly the bytes fetched; tier blocks must be whole.
+        bool from_disk = ref.packed || ref.inlined ? got > 0 : got == static_cast<ssize_t>(bs);
+        if (!from_disk && key != kInvalidBlockKey) {
+            fill = std::make_shared<BlockFill>(std::move(buffer));
+            {
+                std::lock_guard<std::mutex> g(mu_);
+                inflight_[key] = fill;
+                if (need < bs) ++background_fills_;
+            }
+            inflight_cv_.notify_all();
+            if (need < bs) {
+                fill_pool_.post([this, ref, blk, fill, gen, prio] {
+                    run_fill(ref, blk, *fill, gen, prio);
+                    std::lock_guard<std::mutex> g(mu_);
+                    --background_fills_;
+                    inflight_cv_.notify_all();
+                });
+                if (RamTier::Handle h = fill->wait(need)) return h;
+                if (fill->failed()) return nullptr;
                 continue;
-            ssize_t got = cache_fs::backend_read_range(
-                            ce.path, buf, kBlockSize, off);
-            if (got > 0) {
-                store_.write(ce.hash_hex, buf, got, off, false);
-                lru_.touch(reinterpret_cast<std::uintptr_t>(
-                            const_cast<CacheEntry*>(&ce))<<32 | blk,
-                        kBlockSize, 0.25);
             }
+            bool stale = false;
+            if (RamTier::Handle h = run_fill(ref, blk, *fill, gen, prio, &stale)) return h;
+            if (!stale) return nullptr;
+            continue;
         }
-    });
+        if (!from_disk) got = fetch_range(ref, block, bs, blk_off, prio);
+
+        std::lock_guard<std::mutex> g(mu_);
+        if (key != kInvalidBlockKey) {
+            inflight_.erase(key);
+            inflight_cv_.notify_all();
+        }
+        CacheEntry* ce = live_entry(ref);
+        if (!ce) return nullptr;
+        if (ce->write_gen != gen) continue;
+        if (got <= 0) {
+            ce->present.set(blk, BlockPresence::kAbsent);
+            return nullptr;
+        }
+        if (from_disk) {
+            ++(ref.inlined ? inline_hits_ : disk_hits_);
+        } else {
+            ++backend_reads_;
+            ++backend_fetches_;
+            if (write_stored(ref, key, blk, block, got) > 0) note_stored(*ce);
+        }
+        ce->present.set(blk, BlockPresence::kPresent);
+        if (key == kInvalidBlockKey) {
+            auto h = std::make_shared<RamBlock>();
+            h->buf = std::move(buffer);
+            h->len = got;
+            return h;
+        }
+        return ram_.put(key, std::move(buffer), got);
+    }
+}
+
+// Fetches a keyed block into `fill` from the backend, then stores it and
+// hands the buffer to the RAM tier. Sets *stale instead if a write to the
+// object landed during the fetch.
+RamTier::Handle CacheManager::run_fill(const ObjectRef& ref, std::size_t blk, BlockFill& fill, std::uint32_t gen,
+                                       IoPriority prio, bool* stale) {
+    const std::size_t bs = ref.block_size;
+    const BlockKey key   = make_block_key(ref.id, blk);
+    ssize_t got = fetch_range(ref, fill.data(), bs, blk * bs, prio, [&fill](std::size_t n) { fill.advance(n); });
+    fill.finish(got);
+
+    std::lock_guard<std::mutex> g(mu_);
+    inflight_.erase(key);
+    inflight_cv_.notify_all();
+    CacheEntry* ce = live_entry(ref);
+    if (!ce) return nullptr;
+    if (ce->write_gen != gen) {
+        if (stale) *stale = true;
+        return nullptr;
+    }
+    if (got <= 0) {
+        ce->present.set(blk, BlockPresence::kAbsent);
+        return nullptr;
+    }
+    ++backend_reads_;
+    ++backend_fetches_;
+    BlockBuffer buffer = fill.take();
+    if (write_stored(ref, key, blk, buffer.data(), got) > 0) note_stored(*ce);
+    ce->present.set(blk, BlockPresence::kPresent);
+    return ram_.put(key, std::move(buffer), got);
+}
+
+// From the backend, or from the file under the cache root if there is none.
+ssize_t CacheManager::fetch_range(const ObjectRef& ref, char* buf, std::size_t len, off_t off, IoPriority prio,
+                                  const cache_fs::Progress& progress) {
+    iovec iov{buf, len};
+    return fetch_range(ref, &iov, 1, off, prio, progress);
+}
+
+ssize_t CacheManager::fetch_range(const ObjectRef& ref, const iovec* iov, int iovcnt, off_t off, IoPriority prio,
+                                  const cache_fs::Progress& progress) {
+    ssize_t got = cache_fs::backend_read_range(std::string(ref.path), iov, iovcnt, off, prio, progress);
+    if (got <= 0) {
+        fs::path src = fs::path(root_) /
+                    fs::path(ref.path[0] == '/' ? ref.path.substr(1) : ref.path);
+        int fd = ::open(src.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            got = ::preadv(fd, iov, iovcnt, off);
+            ::close(fd);
+            if (got > 0 && progress) progress(got);
+        }
+    }
+    return got;
+}
+
+// Loads blocks first .. first + count - 1. Those found on disk are read
+// from there; the rest that nobody else is loading are fetched with one
+// range request per stretch of consecutive blocks. Blocks another load has
+// in flight go through load_block, which waits for it. As in load_block,
+// the data is dropped if a write lands in between.
+void CacheManager::load_run(const ObjectRef& ref, std::size_t first, std::size_t count, IoPriority prio) {
+    RunLoad run;
+    if (claim_run(ref, first, count, run)) finish_run(ref, run, prio);
+}
+
+// Sorts the blocks of a run by where they will come from and reads those on
+// disk. The ones to fetch are marked in flight, so loads of them wait for
+// finish_run. False if the run has nothing left to load.
+bool CacheManager::claim_run(const ObjectRef& ref, std::size_t first, std::size_t count, RunLoad& run) {
+    const std::size_t bs = ref.block_size;
+    run.first = first;
+    run.count = count;
+    run.kind.assign(count, RunLoad::kCached);
+    run.bufs.resize(count);
+    run.got.assign(count, 0);
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        CacheEntry* ce = live_entry(ref);
+        if (!ce) return false;
+        run.gen = ce->write_gen;
+        for (std::size_t i = 0; i < count; ++i) {
+            BlockKey key = make_block_key(ref.id, first + i);
+            if (ram_.find(key)) continue;
+            run.kind[i] = inflight_.find(key) != inflight_.end() ? RunLoad::kOther
+                        : ce->present.get(first + i) == BlockPresence::kAbsent ? RunLoad::kFetch : RunLoad::kProbe;
+        }
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        if (run.kind[i] != RunLoad::kProbe) continue;
+        run.bufs[i] = BufferPool::instance().acquire(bs);
+        run.got[i] = read_stored(ref, make_block_key(ref.id, first + i), first + i, run.bufs[i].data());
+        // As in load_block: packed and inline copies may be short, tier blocks may not.
+        bool found = ref.packed || ref.inlined ? run.got[i] > 0 : run.got[i] == static_cast<ssize_t>(bs);
+        run.kind[i] = found ? RunLoad::kDisk : RunLoad::kFetch;
+    }
+    bool work = false;
+    std::lock_guard<std::mutex> g(mu_);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (run.kind[i] == RunLoad::kFetch) {
+            BlockKey key = make_block_key(ref.id, first + i);
+            if (ram_.find(key)) run.kind[i] = RunLoad::kCached;
+            else if (inflight_.find(key) != inflight_.end()) run.kind[i] = RunLoad::kOther;
+            else inflight_[key] = nullptr;
+        }
+        work |= run.kind[i] != RunLoad::kCached;
+    }
+    return work;
+}
+
+// Fetches the claimed blocks of a run, then publishes them and those read
+// from disk.
+void CacheManager::finish_run(const ObjectRef& ref, RunLoad& run, IoPriority prio) {
+    const std::size_t bs = ref.block_size;
+    const std::size_t first = run.first, count = run.count;
+    // Each stretch of fetched blocks, up to IOV_MAX of them, is one request
+    // scattered straight into the blocks' buffers.
+    std::vector<iovec> iov;
+    for (std::size_t i = 0; i < count;) {
+        if (run.kind[i] != RunLoad::kFetch) {
+            ++i;
+            continue;
+        }
+        std::size_t n = 1;
+        while (i + n < count && n < IOV_MAX && run.kind[i + n] == RunLoad::kFetch) ++n;
+        iov.clear();
+        for (std::size_t j = 0; j < n; ++j) {
+            run.bufs[i + j] = BufferPool::instance().acquire(bs);
+            iov.push_back({run.bufs[i + j].data(), bs});
+        }
+        ssize_t rc = fetch_range(ref, iov.data(), static_cast<int>(n), (first + i) * bs, prio);
+        for (std::size_t j = 0; j < n; ++j) {
+            run.got[i + j] = std::min<ssize_t>(rc - static_cast<ssize_t>(j * bs), bs);
+            if (run.got[i + j] <= 0) run.bufs[i + j] = BlockBuffer();
+        }
+        {
+            std::lock_guard<std::mutex> g(mu_);
+            ++backend_fetches_;
+        }
+        i += n;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        for (std::size_t i = 0; i < count; ++i)
+            if (run.kind[i] == RunLoad::kFetch) inflight_.erase(make_block_key(ref.id, first + i));
+        inflight_cv_.notify_all();
+        CacheEntry* ce = live_entry(ref);
+        if (!ce || ce->write_gen != run.gen) return;
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t blk = first + i;
+            const BlockKey key = make_block_key(ref.id, blk);
+            if (run.kind[i] == RunLoad::kDisk) {
+                ++(ref.inlined ? inline_hits_ : disk_hits_);
+                ce->present.set(blk, BlockPresence::kPresent);
+                ram_.put(key, std::move(run.bufs[i]), run.got[i]);
+            } else if (run.kind[i] == RunLoad::kFetch) {
+                if (run.got[i] <= 0) {
+                    ce->present.set(blk, BlockPresence::kAbsent);
+                    continue;
+                }
+                ++backend_reads_;
+                if (write_stored(ref, key, blk, run.bufs[i].data(), run.got[i]) > 0) note_stored(*ce);
+                ce->present.set(blk, BlockPresence::kPresent);
+                ram_.put(key, std::move(run.bufs[i]), run.got[i]);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < count; ++i)
+        if (run.kind[i] == RunLoad::kOther && !load_block(ref, first + i, prio)) return;
+}
+
+// Splits the blocks of first_blk .. last_blk missing from RAM, taken as runs
+// of consecutive blocks, into parts of about equal size, and those among at
+// most read_fan_out() loaders. The calling thread is one of them while the
+// pool runs the rest at demand priority; returns once all have landed.
+void CacheManager::fetch_misses(const ObjectRef& ref, std::size_t first_blk, std::size_t last_blk) {
+    if (ref.packed || ref.inlined || last_blk == first_blk || last_blk > kMaxKeyedBlock) return;
+    struct Run {
+        std::size_t first;
+        std::size_t count;
+    };
+    std::vector<Run> runs;
+    std::size_t missing = 0;
+    for (std::size_t blk = first_blk; blk <= last_blk; ++blk) {
+        if (ram_.find(make_block_key(ref.id, blk))) continue;
+        if (!runs.empty() && runs.back().first + runs.back().count == blk) ++runs.back().count;
+        else runs.push_back({blk, 1});
+        ++missing;
+    }
+    if (missing < 2) return;
+    const std::size_t fan_out = read_fan_out();
+    const std::size_t per_part = (missing + fan_out - 1) / fan_out;
+    std::vector<Run> parts;
+    for (const Run& r : runs)
+        for (std::size_t b = r.first; b < r.first + r.count; b += per_part)
+            parts.push_back({b, std::min(per_part, r.first + r.count - b)});
+
+    const std::size_t loaders = std::min(fan_out, parts.size());
+    auto load = [this, &ref, &parts, loaders](std::size_t k) {
+        for (std::size_t i = k * parts.size() / loaders; i < (k + 1) * parts.size() / loaders; ++i)
+            load_run(ref, parts[i].first, parts[i].count, IoPriority::kDemand);
+    };
+    std::vector<std::future<void>> landed;
+    for (std::size_t k = 1; k < loaders; ++k) landed.push_back(io_pool_.enqueue([&load, k] { load(k); }, IoPriority::kDemand));
+    load(0);
+    for (auto& f : landed) f.wait();
+}
+
+// Feeds the blocks read to the file's readahead state, its window bounded
+// by readahead_bounds().
+void CacheManager::note_read(const ObjectRef& ref, std::size_t first_blk, std::size_t last_blk) {
+    std::lock_guard<std::mutex> g(mu_);
+    CacheEntry* ce = live_entry(ref);
+    if (!ce) return;
+    auto profile = profiles_.find(ce->id);
+    if (profile != profiles_.end()) profile->second.record(first_blk, last_blk);
+    Readahead& ra = readahead_[ce->id];
+    const Readahead::Stats before = ra.stats();
+    const std::size_t end = (ce->size_hint + ref.block_size - 1) >> ref.block_shift;
+    std::size_t min_window, max_window;
+    readahead_bounds(ref.block_shift, min_window, max_window);
+    for (std::size_t blk = first_blk; blk <= last_blk; ++blk) {
+        touch_block(*ce, blk, 1.0);
+        note_access(*ce, blk);
+        ce->last_block = blk;
+        Readahead::Plan plan = ra.access(blk, end, min_window, max_window);
+        if (plan.count && !schedule_prefetch(ref, plan, ra.gen())) ra.retract(plan);
+    }
+    prefetch_issued_       += ra.stats().issued - before.issued;
+    prefetch_hits_         += ra.stats().hits - before.hits;
+    prefetch_wasted_bytes_ += (ra.stats().wasted - before.wasted) * ref.block_size;
+}
+
+// A prefetch stops once the file's pattern breaks (a newer readahead
+// generation) or the file is closed or evicted, and skips blocks already
+// on disk or being loaded. Long plans go back in the queue every
+// kPrefetchChunk blocks so one stream does not hold a worker. False if the
+// prefetch queue is full.
+bool CacheManager::schedule_prefetch(const ObjectRef& ref, const Readahead::Plan& plan, std::uint32_t gen) {
+    return io_pool_.try_post([this, ref, plan, gen]() {
+        for (std::size_t i = 0; i < plan.count; ++i) {
+            std::size_t blk = plan.first + i * plan.stride;
+            if (i == kPrefetchChunk) {
+                Readahead::Plan rest{blk, plan.stride, plan.count - i};
+                if (schedule_prefetch(ref, rest, gen)) return;
+            }
+            {
+                std::lock_guard<std::mutex> g(mu_);
+                CacheEntry* ce = live_entry(ref);
+                if (!ce) return;
+                auto it = readahead_.find(ref.id);
+                if (it == readahead_.end() || it->second.gen() != gen) return;
+                if (ce->present.get(blk) == BlockPresence::kPresent) continue;
+                if (blk <= kMaxKeyedBlock && inflight_.find(make_block_key(ref.id, blk)) != inflight_.end())
+                    continue;
+            }
+            if (!load_block(ref, blk, IoPriority::kPrefetch)) return;
+            std::lock_guard<std::mutex> g(mu_);
+            if (CacheEntry* ce = live_entry(ref)) touch_block(*ce, blk, 0.25);
+        }
+    }, IoPriority::kPrefetch);
+}
+
+// Called by the tier migrator, which holds no lock of ours.
+bool CacheManager::resolve_object(ObjectId id, char* name, std::size_t& name_len, std::size_t& bs) {
+    std::lock_guard<std::mutex> g(mu_);
+    CacheEntry* ce = entries_.get(id);
+    if (!ce || ce->evicted || !ce->block_size) return false;
+    std::memcpy(name, ce->name_buf, ce->name_len);
+    name_len = ce->name_len;
+    bs       = ce->block_size;
+    return true;
+}
+
+void CacheManager::get_stats(cache_stats& out) {
+    RamTier::Stats ram = ram_.stats();
+    out.ram_hits      = ram.hits;
+    out.ram_misses    = ram.misses;
+    out.ram_evictions = ram.evictions;
+    out.ram_bytes     = ram.bytes;
+    out.ram_blocks    = ram.blocks;
+    out.ram_hit_ratio = ram.hits + ram.misses ? double(ram.hits) / double(ram.hits + ram.misses) : 0.0;
+    StorageTiers::Stats tiers = tiers_.stats();
+    out.tier_promotions = tiers.promotions;
+    out.tier_demotions  = tiers.demotions;
+    out.tier_drops      = tiers.drops;
+    PackStore::Stats pack = pack_.stats();
+    out.pack_records    = pack.records;
+    out.pack_live_bytes = pack.live_bytes;
+    out.pack_dead_bytes = pack.dead_bytes;
+    std::lock_guard<std::mutex> g(mu_);
+    out.disk_hits     = disk_hits_;
+    out.inline_hits   = inline_hits_;
+    out.backend_reads = backend_reads_;
+    out.backend_fetches = backend_fetches_;
+    out.eager_fetches   = eager_fetches_;
+    out.profile_replays = profile_replays_;
+    out.profile_blocks  = profile_blocks_;
+    out.sibling_issued  = sibling_issued_;
+    out.sibling_hits    = sibling_hits_;
+    out.sibling_wasted  = sibling_wasted_;
+    const cache_fs::LinkEstimate link = cache_fs::backend_link_estimate();
+    const cache_fs::InflightStats inflight = cache_fs::backend_inflight_stats();
+    out.link_rtt_sec       = link.rtt_sec;
+    out.link_bytes_per_sec = link.bytes_per_sec;
+    out.backend_inflight_limit  = inflight.limit;
+    out.backend_inflight_target = inflight.target;
+    out.backend_backoffs        = inflight.backoffs;
+    out.backend_throttled    = 0;
+    out.backend_borrowed     = 0;
+    out.backend_throttle_sec = 0;
+    for (std::size_t c = 0; c < cache_fs::kTrafficClasses; ++c) {
+        const cache_fs::ThrottleStats t = cache_fs::backend_throttle_stats(static_cast<cache_fs::TrafficClass>(c));
+        out.backend_throttled    += t.throttled;
+        out.backend_borrowed     += t.borrowed;
+        out.backend_throttle_sec += t.wait_sec;
+    }
+    out.prefetch_issued       = prefetch_issued_;
+    out.prefetch_hits         = prefetch_hits_;
+    out.prefetch_wasted_bytes = prefetch_wasted_bytes_;
+}
+
+bool CacheManager::get_file_stats(std::string_view path, cache_file_stats& out) {
+    std::lock_guard<std::mutex> g(mu_);
+    CacheEntry* ce = entries_.find(path);
+    auto it = ce ? readahead_.find(ce->id) : readahead_.end();
+    if (it == readahead_.end()) return false;
+    const Readahead& ra = it->second;
+    out.readahead_stride      = ra.stride();
+    out.readahead_window      = ra.window();
+    out.prefetch_issued       = ra.stats().issued;
+    out.prefetch_hits         = ra.stats().hits;
+    out.prefetch_wasted_bytes = ra.stats().wasted * ce->block_size;
+    out.prefetch_accuracy     = ra.stats().issued ? double(ra.stats().hits) / double(ra.stats().issued) : 0.0;
+    return true;
+}
+
+// A small file costs a round trip per block read one at a time, and only
+// one plus its transfer time fetched whole. With about kEagerBdps
+// bandwidth-delay products or less to move, the whole fetch comes out ahead.
+std::size_t CacheManager::eager_limit() const {
+    const std::size_t cap = opts_.eager_fetch_max;
+    const std::size_t floor = std::min(cap, kMinEagerBytes);
+    cache_fs::LinkEstimate link = cache_fs::backend_link_estimate();
+    if (!link.bytes_per_sec) return floor;
+    const double bdp = link.rtt_sec * link.bytes_per_sec;
+    return std::clamp(static_cast<std::size_t>(std::min(kEagerBdps * bdp, double(cap))), floor, cap);
+}
+
+// Files of known size within eager_limit() are fetched whole, with one range
+// request for their missing blocks that runs on the pool. The blocks are
+// claimed before returning, so the first read waits for that request
+// rather than issuing its own. Larger files replay the profile learned
+// the last time they were open, and start recording a new one.
+// Opening a file that is already open only counts the open; recording
+// and prefetching started with the first.
+void CacheManager::open_file(std::string_view path) {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        CacheEntry& ce = entry(path);
+        if (!ce.evicted && ce.opens++) return;
+    }
+    prefetch_siblings(path);
+    const std::size_t limit = eager_limit();
+    std::optional<ObjectRef> ref;
+    std::size_t size;
+    AccessProfile learned;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        CacheEntry& ce = entry(path);
+        if (ce.evicted) return;
+        ref.emplace(ce);
+        size = ce.size_hint;
+        if (!size || size > limit) {
+            profiles_[ce.id] = AccessProfile();
+            if (auto blob = meta_.getProfile(ce.hash_hex())) learned = AccessProfile::decode(*blob);
+        }
+    }
+    if (!size || size > limit) {
+        replay_profile(*ref, learned, size);
+        return;
+    }
+    const std::size_t last = (size - 1) >> ref->block_shift;
+    if (last > kMaxKeyedBlock) return;
+    auto run = std::make_shared<RunLoad>();
+    if (!claim_run(*ref, 0, last + 1, *run)) return;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        ++eager_fetches_;
+    }
+    io_pool_.post([this, ref = *ref, run] { finish_run(ref, *run, IoPriority::kDemand); }, IoPriority::kDemand);
+}
+
+// Prefetches the ranges of a learned profile, up to kMaxReplayBytes of
+// them and none past the end of the file. They are cut into pieces of at
+// most kPrefetchChunk blocks, which at most read_fan_out() pool tasks load in
+// parallel, each taking its share of the pieces in the order they were
+// first read. Tasks that do not fit the prefetch queue are dropped.
+void CacheManager::replay_profile(const ObjectRef& ref, const AccessProfile& profile, std::size_t size) {
+    struct Piece {
+        std::size_t first;
+        std::size_t count;
+    };
+    const std::size_t end = size ? ((size - 1) >> ref.block_shift) + 1 : kMaxKeyedBlock + 1;
+    std::size_t budget = std::max<std::size_t>(kMaxReplayBytes >> ref.block_shift, 1);
+    auto pieces = std::make_shared<std::vector<Piece>>();
+    for (const AccessProfile::Range& r : profile.ranges()) {
+        const std::size_t stop = std::min<std::size_t>(r.first + std::size_t(r.count), end);
+        for (std::size_t blk = r.first; blk < stop && budget; blk += pieces->back().count) {
+            pieces->push_back({blk, std::min({kPrefetchChunk, stop - blk, budget})});
+            budget -= pieces->back().count;
+        }
+    }
+    if (pieces->empty()) return;
+
+    const std::size_t tasks = std::min(read_fan_out(), pieces->size());
+    std::size_t issued = 0;
+    for (std::size_t k = 0; k < tasks; ++k) {
+        const std::size_t lo = k * pieces->size() / tasks, hi = (k + 1) * pieces->size() / tasks;
+        bool queued = io_pool_.try_post([this, ref, pieces, lo, hi] {
+            for (std::size_t i = lo; i < hi; ++i) load_run(ref, (*pieces)[i].first, (*pieces)[i].count, IoPriority::kPrefetch);
+        }, IoPriority::kPrefetch);
+        if (!queued) break;
+        for (std::size_t i = lo; i < hi; ++i) issued += (*pieces)[i].count;
+    }
+    if (!issued) return;
+    std::lock_guard<std::mutex> g(mu_);
+    ++profile_replays_;
+    profile_blocks_ += issued;
+}
+
+// A file opened and closed without a read keeps its earlier profile.
+void CacheManager::save_profile(const CacheEntry& ce) {
+    auto it = profiles_.find(ce.id);
+    if (it != profiles_.end() && !it->second.empty()) meta_.putProfile(ce.hash_hex(), it->second.encode());
+}
+
+void CacheManager::note_directory(std::string_view dir, std::vector<std::string> names) {
+    if (!opts_.sibling_depth) return;
+    std::lock_guard<std::mutex> g(mu_);
+    auto it = dirs_.find(std::string(dir));
+    if (it == dirs_.end()) {
+        if (dirs_.size() >= kMaxScannedDirs) dirs_.erase(dirs_.begin());
+        it = dirs_.emplace(std::string(dir), DirectoryScan()).first;
+    }
+    it->second.set_names(std::move(names));
+}
+
+// Opening the files of a listed directory in name order prefetches the
+// first sibling_lead_bytes of the next ones, sibling_depth files at most;
+// see DirectoryScan. Siblings whose size is not known yet get the whole
+// lead requested, and the blocks past their end come back empty.
+void CacheManager::prefetch_siblings(std::string_view path) {
+    const std::size_t slash = path.rfind('/');
+    if (!opts_.sibling_depth || !opts_.sibling_lead_bytes || slash == std::string_view::npos) return;
+    const std::string dir(path.substr(0, slash ? slash : 1));
+    std::lock_guard<std::mutex> g(mu_);
+    auto it = dirs_.find(dir);
+    if (it == dirs_.end()) return;
+    DirectoryScan& scan = it->second;
+    const DirectoryScan::Stats before = scan.stats();
+    const DirectoryScan::Plan plan = scan.open(path.substr(slash + 1), opts_.sibling_depth);
+    for (std::size_t i = 0; i < plan.count; ++i) {
+        CacheEntry& ce = entry((slash ? dir + "/" : dir) + scan.names()[plan.first + i]);
+        if (ce.evicted) continue;
+        const std::size_t lead = ce.size_hint ? std::min(ce.size_hint, opts_.sibling_lead_bytes) : opts_.sibling_lead_bytes;
+        const std::size_t blocks = std::min(((lead - 1) >> ce.block_shift) + 1, kMaxKeyedBlock + 1);
+        bool queued = io_pool_.try_post([this, ref = ObjectRef(ce), blocks] {
+            load_run(ref, 0, blocks, IoPriority::kPrefetch);
+        }, IoPriority::kPrefetch);
+        if (!queued) {
+            scan.retract(DirectoryScan::Plan{plan.first + i, plan.count - i});
+            break;
+        }
+    }
+    sibling_issued_ += scan.stats().issued - before.issued;
+    sibling_hits_   += scan.stats().hits - before.hits;
+    sibling_wasted_ += scan.stats().wasted - before.wasted;
+}
+
+// Only the last close of a file ends it. Outstanding blocks count as
+// wasted, as on a broken pattern.
+void CacheManager::close_file(std::string_view path) {
+    std::lock_guard<std::mutex> g(mu_);
+    CacheEntry* ce = entries_.find(path);
+    if (ce && ce->opens > 1) {
+        --ce->opens;
+        return;
+    }
+    if (ce) {
+        ce->opens = 0;
+        save_profile(*ce);
+        profiles_.erase(ce->id);
+    }
+    auto it = ce ? readahead_.find(ce->id) : readahead_.end();
+    if (it == readahead_.end()) return;
+    const std::uint64_t wasted = it->second.stats().wasted;
+    it->second.cancel();
+    prefetch_wasted_bytes_ += (it->second.stats().wasted - wasted) * ce->block_size;
 }
 
 static std::unique_ptr<CacheManager> g_cache;
 
-int cache_init(const char* root, int) {
-    try { g_cache = std::make_unique<CacheManager>(root); return 0; }
+void cache_default_options(cache_options* opts) {
+    opts->block_size       = kDefaultBlockSize;
+    opts->adaptive_blocks  = 0;
+    opts->small_block_size = 16 * 1024;
+    opts->large_block_size = 1024 * 1024;
+    opts->small_file_max   = 256 * 1024;
+    opts->large_file_min   = 64 * 1024 * 1024;
+    opts->ram_bytes        = kDefaultRamBytes;
+    opts->hugepages        = 0;
+    opts->ntiers           = 0;
+    opts->migrate_bytes_per_sec = kDefaultMigrateRate;
+    opts->promote_hits     = 2;
+    opts->pack_max_size    = kDefaultPackMaxSize;
+    opts->inline_max_size  = kDefaultInlineMaxSize;
+    opts->preallocate_max_size = kDefaultPreallocMaxSize;
+    opts->defrag_interval_sec  = kDefaultDefragInterval;
+    opts->part_size        = fs_layout::kDefaultPartSize;
+    opts->eager_fetch_max  = kDefaultEagerMax;
+    opts->sibling_depth    = kDefaultSiblingDepth;
+    opts->sibling_lead_bytes = kDefaultSiblingLead;
+}
+
+int cache_init_opts(const char* root, const cache_options* opts) {
+    cache_options o;
+    if (opts) o = *opts;
+    else cache_default_options(&o);
+    if (!valid_block_size(o.block_size) ||
+        (o.adaptive_blocks && (!valid_block_size(o.small_block_size) || !valid_block_size(o.large_block_size))) ||
+        !fs_layout::valid_part_size(o.part_size) || o.ntiers < 0 || o.ntiers > CACHE_MAX_TIERS)
+        return -EINVAL;
+    for (int i = 0; i < o.ntiers; ++i) {
+        const cache_tier& t = o.tiers[i];
+        if (t.nroots < 1 || t.nroots > CACHE_MAX_DEVICES) return -EINVAL;
+        for (int d = 0; d < t.nroots; ++d)
+            if (!t.roots[d] || !*t.roots[d]) return -EINVAL;
+    }
+    BufferPool::instance().set_hugepages(o.hugepages != 0);
+    try { g_cache = std::make_unique<CacheManager>(root, o); return 0; }
     catch (...) { return -1; }
 }
+int cache_init(const char* root, int) {
+    cache_options o;
+    cache_default_options(&o);
+    return cache_init_opts(root, &o);
+}
+int cache_get_stats(cache_stats* out)
+{
+    if (!g_cache) return -ENODEV;
+    g_cache->get_stats(*out);
+    return 0;
+}
+int cache_get_file_stats(const char* p, cache_file_stats* out)
+{
+    if (!g_cache) return -ENODEV;
+    return g_cache->get_file_stats(p, *out) ? 0 : -ENOENT;
+}
+int cache_note_directory(const char* dir, const char* const* names, size_t count)
+{
+    if (!g_cache) return -ENODEV;
+    g_cache->note_directory(dir, std::vector<std::string>(names, names + count));
+    return 0;
+}
+int cache_open_file(const char* p)
+{
+    if (!g_cache) return -ENODEV;
+    g_cache->open_file(p);
+    return 0;
+}
+int cache_close_file(const char* p)
+{
+    if (!g_cache) return -ENODEV;
+    g_cache->close_file(p);
+    return 0;
+}
+int cache_hint_size(const char* p, size_t size)
+{
+    if (!g_cache) return -ENODEV;
+    g_cache->hint_size(p, size);
+    return 0;
+}
 int cache_store_file(const char* p, const char* d, size_t len, off_t off)
 {
     if (!g_cache) return -ENODEV;
@@ -6,6 +6,9 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
+#include "cache_options.h"
+#include "cache_stats.h"
+
 #define CACHE_TABLE_SIZE 1024
 
 typedef struct cache_entry {
@@ -20,6 +23,12 @@ typedef struct cache_entry {
 
 int cache_init(const char* backing_dir, int timeout);
 
+int cache_init_opts(const char* backing_dir, const cache_options* opts);
+
+// Records the file's size as the origin reports it. If the file holds data
+// cached at a different size, that data is dropped as stale.
+int cache_hint_size(const char* path, size_t size);
+
 bool cache_has_valid_entry(const char* path);
 
 cache_entry* cache_get_entry(const char* path);
@@ -30,6 +39,20 @@ ssize_t cache_read_file(const char* path, char* buffer, size_t size, off_t offse
 
 int cache_apply_eviction(void);
 
+// Records the names listed in a directory. Opening them in name order then
+// prefetches the start of the next ones; see sibling_depth.
+int cache_note_directory(const char* dir, const char* const* names, size_t count);
+
+// Starts fetching the file whole if it is small enough (see eager_fetch_max),
+// or else prefetching what was read after its last open. Reads until
+// cache_close_file() are recorded for the next open. Opens of a file that
+// is already open are only counted.
+int cache_open_file(const char* path);
+
+// Ends one open of the file. The last close cancels the file's readahead
+// (queued and running prefetches for it stop) and saves its access profile.
+int cache_close_file(const char* path);
+
 void cache_cleanup(void);
 
 #endif
\ No newline at end of file
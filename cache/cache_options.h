@@ -0,0 +1,77 @@
+#ifndef CACHE_OPTIONS_H
+#define CACHE_OPTIONS_H
+
+#include <stddef.h>
+
+#define CACHE_MAX_TIERS 4
+#define CACHE_MAX_DEVICES 8
+
+/* A disk tier striped over one or more roots, typically one per device.
+ * device_capacity caps each root (0 = until its filesystem runs low). */
+typedef struct cache_tier {
+    const char* roots[CACHE_MAX_DEVICES];
+    int         nroots;
+    size_t      capacity;   /* bytes; 0 = unbounded */
+    size_t      device_capacity;
+} cache_tier;
+
+/* Per-mount cache tuning. Block sizes must be powers of two between 4 KiB
+ * and 64 MiB. With adaptive_blocks set, each object picks small_block_size
+ * or large_block_size from its size and past access pattern; otherwise every
+ * object uses block_size. ram_bytes budgets the in-memory hot-block tier
+ * (0 disables it). With hugepages set, block buffers of 2 MiB and up are
+ * backed by huge pages where the kernel has them.
+ *
+ * tiers lists the disk tiers fastest first; with ntiers = 0 blocks live in
+ * one unbounded tier at the cache root. Blocks are demoted when a tier runs
+ * over capacity and promoted one tier after promote_hits reads, moving at
+ * most migrate_bytes_per_sec (0 = unthrottled).
+ *
+ * Objects known to be at most pack_max_size bytes are appended to shared
+ * segment files rather than getting part files of their own (0 = never).
+ * Files of at most inline_max_size bytes (and one block) are kept in the
+ * metadata store itself and never touch the block store (0 = never).
+ *
+ * Once the first block of a file of up to preallocate_max_size bytes is
+ * cached, its whole size is preallocated so later blocks land in contiguous
+ * extents (0 = never). Every defrag_interval_sec seconds part files split
+ * into many more extents than they need are rewritten (0 = never).
+ *
+ * part_size is the size objects are split into part files by, a power of
+ * two from 64 MiB to 1 TiB. It is recorded when a cache root is created;
+ * existing roots keep theirs.
+ *
+ * Opening a file of known size fetches all of it in one request when it is
+ * at most a few bandwidth-delay products of the link to the origin, as
+ * measured so far, capped at eager_fetch_max bytes (0 = never).
+ *
+ * Once files of a listed directory are opened in name order, the first
+ * sibling_lead_bytes of each of the next files are prefetched ahead of
+ * their open. Prefetches that are then opened deepen the scan, and wasted
+ * ones make it shallower, up to sibling_depth files ahead (0 = never). */
+typedef struct cache_options {
+    size_t block_size;
+    int    adaptive_blocks;
+    size_t small_block_size;
+    size_t large_block_size;
+    size_t small_file_max;
+    size_t large_file_min;
+    size_t ram_bytes;
+    int    hugepages;
+    cache_tier tiers[CACHE_MAX_TIERS];
+    int        ntiers;
+    size_t     migrate_bytes_per_sec;
+    unsigned   promote_hits;
+    size_t     pack_max_size;
+    size_t     inline_max_size;
+    size_t     preallocate_max_size;
+    unsigned   defrag_interval_sec;
+    size_t     part_size;
+    size_t     eager_fetch_max;
+    size_t     sibling_depth;
+    size_t     sibling_lead_bytes;
+} cache_options;
+
+void cache_default_options(cache_options* opts);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+
+/* Read-path counters since cache_init. RAM-tier lookups are counted on their
+ * own; disk_hits, inline_hits (tiny files kept in the metadata store) and
+ * backend_reads split the RAM misses by where the block was found;
+ * backend_fetches counts the range requests behind backend_reads, one of
+ * which can cover several blocks; eager_fetches counts files fetched whole
+ * on open. profile_* count opens that replayed the access profile learned
+ * on an earlier open, and the blocks those prefetched. sibling_* count
+ * files whose start was prefetched because a scan of their directory
+ * reached them, those then opened, and those dropped when the scan broke.
+ * link_* are the measured time to first byte and transfer rate of backend
+ * reads; backend_inflight_* the requests allowed to run at once and the
+ * number that would keep one bandwidth-delay product in flight, and
+ * backend_backoffs the times the limit was halved on rising latency.
+ * backend_throttled counts requests held back by a traffic class's rate
+ * limit, over backend_throttle_sec in all, and backend_borrowed those sent
+ * on tokens a more urgent class left unused.
+ * tier_* count block moves between disk tiers (drops leave the
+ * last tier). pack_* describe the segment files small objects are packed
+ * into; dead bytes are reclaimed by the background cleaner. prefetch_*
+ * count blocks requested ahead of readers, those then read, and the bytes
+ * of those cancelled unread when the access pattern changed. */
+typedef struct cache_stats {
+    unsigned long long ram_hits;
+    unsigned long long ram_misses;
+    unsigned long long ram_evictions;
+    unsigned long long ram_bytes;
+    unsigned long long ram_blocks;
+    double             ram_hit_ratio;
+    unsigned long long disk_hits;
+    unsigned long long inline_hits;
+    unsigned long long backend_reads;
+    unsigned long long backend_fetches;
+    unsigned long long eager_fetches;
+    unsigned long long profile_replays;
+    unsigned long long profile_blocks;
+    unsigned long long sibling_issued;
+    unsigned long long sibling_hits;
+    unsigned long long sibling_wasted;
+    double             link_rtt_sec;
+    double             link_bytes_per_sec;
+    unsigned long long backend_inflight_limit;
+    unsigned long long backend_inflight_target;
+    unsigned long long backend_backoffs;
+    unsigned long long backend_throttled;
+    unsigned long long backend_borrowed;
+    double             backend_throttle_sec;
+    unsigned long long tier_promotions;
+    unsigned long long tier_demotions;
+    unsigned long long tier_drops;
+    unsigned long long pack_records;
+    unsigned long long pack_live_bytes;
+    unsigned long long pack_dead_bytes;
+    unsigned long long prefetch_issued;
+    unsigned long long prefetch_hits;
+    unsigned long long prefetch_wasted_bytes;
+} cache_stats;
+
+/* Readahead state of one file: the detected stride in blocks (0 = none),
+ * the current window in blocks, and its prefetch counters. */
+typedef struct cache_file_stats {
+    long long          readahead_stride;
+    unsigned long long readahead_window;
+    unsigned long long prefetch_issued;
+    unsigned long long prefetch_hits;
+    unsigned long long prefetch_wasted_bytes;
+    double             prefetch_accuracy;
+} cache_file_stats;
+
+int cache_get_stats(cache_stats* stats);
+
+/* -ENOENT if the file has not been read since cache_init. */
+int cache_get_file_stats(const char* path, cache_file_stats* stats);
+
+#endif
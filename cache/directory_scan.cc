@@ -0,0 +1,38 @@
+#include "directory_scan.h"
+
+#include <algorithm>
+
+void DirectoryScan::set_names(std::vector<std::string> names) {
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    if (names == names_) return;
+    names_ = std::move(names);
+    last_  = kNone;
+    cursor_.reset();
+}
+
+void DirectoryScan::retract(const Plan& p) { cursor_.retract(p.count); }
+
+DirectoryScan::Plan DirectoryScan::open(std::string_view name, std::size_t max_depth) {
+    auto it = std::lower_bound(names_.begin(), names_.end(), name);
+    if (it == names_.end() || *it != name) return {};
+    const std::size_t idx = it - names_.begin();
+    if (idx == last_) return {};
+    const bool in_turn = last_ != kNone && idx == last_ + 1;
+    last_ = idx;
+    if (!in_turn) {
+        if (cursor_.cancel()) depth_ = PrefetchCursor::halve(depth_, 1);
+        return {};
+    }
+
+    if (cursor_.consume(idx, 1)) ++depth_;
+    depth_ = std::clamp<std::size_t>(depth_, 1, std::max<std::size_t>(max_depth, 1));
+    cursor_.restart(idx + 1);
+
+    Plan p;
+    p.first = cursor_.frontier(1);
+    if (p.first >= names_.size() || cursor_.ahead() >= depth_) return {};
+    p.count = std::min(depth_ - cursor_.ahead(), names_.size() - p.first);
+    cursor_.issue(p.count);
+    return p;
+}
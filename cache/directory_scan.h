@@ -0,0 +1,51 @@
+#ifndef CACHE_DIRECTORY_SCAN_H
+#define CACHE_DIRECTORY_SCAN_H
+
+#include "prefetch_cursor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Opens of the files of one directory, matched against its listing sorted
+// by name. Opening two consecutive names starts a scan. While it lasts, the
+// `depth` files after the one opened last are kept prefetched. A
+// prefetched file that is then opened is a hit and deepens the scan by one
+// file, up to the caller's limit. An open off the scan counts the files
+// still ahead as wasted and halves the depth.
+class DirectoryScan {
+public:
+    // Files first .. first + count - 1 of names() to prefetch.
+    struct Plan {
+        std::size_t first = 0;
+        std::size_t count = 0;
+    };
+
+    using Stats = PrefetchCursor::Stats;
+
+    // Sorts the listing; a listing that changed restarts the scan.
+    void set_names(std::vector<std::string> names);
+    const std::vector<std::string>& names() const { return names_; }
+
+    Plan open(std::string_view name, std::size_t max_depth);
+
+    // Takes back the plan just returned by open(), when it could not be
+    // queued; the next open asks for those files again.
+    void retract(const Plan& p);
+
+    std::size_t  depth() const { return depth_; }
+    const Stats& stats() const { return cursor_.stats(); }
+
+private:
+    static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+    std::vector<std::string> names_;
+    std::size_t last_ = kNone;
+    std::size_t depth_ = 1;
+    PrefetchCursor cursor_;
+};
+
+#endif
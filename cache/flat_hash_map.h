@@ -0,0 +1,170 @@
+#ifndef CACHE_FLAT_HASH_MAP_H
+#define CACHE_FLAT_HASH_MAP_H
+
+#include "path_hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+template <class K>
+struct FlatHash;
+
+template <>
+struct FlatHash<std::uint64_t> {
+    std::size_t operator()(std::uint64_t k) const {
+        k ^= k >> 33;
+        k *= 0xFF51AFD7ED558CCDULL;
+        k ^= k >> 33;
+        k *= 0xC4CEB9FE1A85EC53ULL;
+        k ^= k >> 33;
+        return static_cast<std::size_t>(k);
+    }
+};
+
+template <>
+struct FlatHash<std::uint32_t> {
+    std::size_t operator()(std::uint32_t k) const { return FlatHash<std::uint64_t>{}(k); }
+};
+
+template <>
+struct FlatHash<std::string_view> {
+    std::size_t operator()(std::string_view s) const {
+        return static_cast<std::size_t>(path_hash128(s.data(), s.size()).lo);
+    }
+};
+
+template <>
+struct FlatHash<std::string> {
+    std::size_t operator()(const std::string& s) const { return FlatHash<std::string_view>{}(s); }
+};
+
+// Open-addressing hash map in the Swiss-table style: one control byte per
+// slot holding 7 bits of the hash, probed 16 slots at a time with SSE2
+// (scalar fallback elsewhere). Each group's control bytes sit right before
+// its 16 slots in one flat array, so there is no allocation per insert and
+// a lookup usually touches one page.
+//
+// Unlike std::unordered_map, rehashing moves elements: references and
+// iterators are invalidated by any insert that grows the table.
+template <class K, class V, class Hash = FlatHash<K>, class Eq = std::equal_to<K>>
+class FlatHashMap {
+public:
+    using key_type    = K;
+    using mapped_type = V;
+    using value_type  = std::pair<K, V>;
+
+    template <bool Const>
+    class Iter {
+    public:
+        using Map = std::conditional_t<Const, const FlatHashMap, FlatHashMap>;
+        using Ref = std::conditional_t<Const, const value_type&, value_type&>;
+        using Ptr = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iter() = default;
+        Iter(Map* m, std::size_t i) : m_(m), i_(i) { skip(); }
+        operator Iter<true>() const { return Iter<true>(m_, i_); }
+
+        Ref operator*() const { return *m_->slot(i_); }
+        Ptr operator->() const { return m_->slot(i_); }
+        Iter& operator++() { ++i_; skip(); return *this; }
+        bool operator==(const Iter& o) const { return i_ == o.i_; }
+        bool operator!=(const Iter& o) const { return i_ != o.i_; }
+
+    private:
+        friend class FlatHashMap;
+        void skip() { while (i_ < m_->capacity_ && !is_full(m_->ctrl(i_))) ++i_; }
+        Map*        m_ = nullptr;
+        std::size_t i_ = 0;
+    };
+    using iterator       = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    FlatHashMap() = default;
+    explicit FlatHashMap(std::size_t n) { reserve(n); }
+    FlatHashMap(FlatHashMap&& o) noexcept;
+    FlatHashMap& operator=(FlatHashMap&& o) noexcept;
+    ~FlatHashMap();
+
+    iterator       begin()       { return iterator(this, 0); }
+    iterator       end()         { return iterator(this, capacity_); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end()   const { return const_iterator(this, capacity_); }
+
+    std::size_t size()     const { return size_; }
+    bool        empty()    const { return size_ == 0; }
+    std::size_t capacity() const { return capacity_; }
+
+    // Bytes owned by the table (control bytes + slots).
+    std::size_t memory_bytes() const { return capacity_ / kGroup * sizeof(Group); }
+
+    iterator       find(const K& key);
+    const_iterator find(const K& key) const;
+    bool contains(const K& key) const { return find(key) != end(); }
+    std::size_t count(const K& key) const { return contains(key) ? 1 : 0; }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args);
+    std::pair<iterator, bool> emplace(const K& key, V value) { return try_emplace(key, std::move(value)); }
+    std::pair<iterator, bool> insert(value_type kv) { return try_emplace(kv.first, std::move(kv.second)); }
+    V& operator[](const K& key) { return try_emplace(key).first->second; }
+
+    iterator    erase(iterator it);
+    std::size_t erase(const K& key);
+
+    void clear();
+    void reserve(std::size_t n);
+
+private:
+    static constexpr std::size_t  kGroup   = 16;
+    static constexpr std::int8_t  kEmpty   = -128;
+    static constexpr std::int8_t  kDeleted = -2;
+
+    struct Group {
+        alignas(16) std::int8_t ctrl[kGroup];
+        alignas(value_type) unsigned char slots[kGroup * sizeof(value_type)];
+    };
+
+    static bool is_full(std::int8_t c) { return c >= 0; }
+
+    std::int8_t&       ctrl(std::size_t i)       { return groups_[i / kGroup].ctrl[i % kGroup]; }
+    const std::int8_t& ctrl(std::size_t i) const { return groups_[i / kGroup].ctrl[i % kGroup]; }
+    value_type* slot(std::size_t i) const {
+        return reinterpret_cast<value_type*>(groups_[i / kGroup].slots) + i % kGroup;
+    }
+    static std::size_t max_load(std::size_t cap) { return cap - cap / 8; }
+
+    struct Probe {
+        std::size_t group;
+        std::size_t step = 0;
+        std::size_t mask;
+        void next() { ++step; group = (group + step) & mask; }
+    };
+    Probe probe(std::size_t h) const { return Probe{(h >> 7) & (capacity_ / kGroup - 1), 0, capacity_ / kGroup - 1}; }
+
+    static std::uint32_t match(const std::int8_t* g, std::int8_t h2);
+    static std::uint32_t match_empty(const std::int8_t* g);
+    static std::uint32_t match_free(const std::int8_t* g);
+
+    std::size_t find_index(const K& key, std::size_t h) const;
+    std::size_t find_free(std::size_t h) const;
+    void        rehash(std::size_t new_cap);
+    void        release();
+
+    Group*       groups_      = nullptr;
+    std::size_t  capacity_    = 0;
+    std::size_t  size_        = 0;
+    std::size_t  growth_left_ = 0;
+    Hash         hash_;
+    Eq           eq_;
+
+    FlatHashMap(const FlatHashMap&)            = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+};
+
+#include "flat_hash_map.inl"
+
+#endif
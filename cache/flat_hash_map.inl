@@ -0,0 +1,190 @@
+#pragma once
+#include <cstring>
+#include <new>
+#include <tuple>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+template <class K, class V, class H, class E>
+FlatHashMap<K, V, H, E>::FlatHashMap(FlatHashMap&& o) noexcept
+    : groups_(o.groups_), capacity_(o.capacity_), size_(o.size_), growth_left_(o.growth_left_) {
+    o.groups_ = nullptr;
+    o.capacity_ = o.size_ = o.growth_left_ = 0;
+}
+
+template <class K, class V, class H, class E>
+FlatHashMap<K, V, H, E>& FlatHashMap<K, V, H, E>::operator=(FlatHashMap&& o) noexcept {
+    if (this != &o) {
+        release();
+        groups_ = o.groups_;
+        capacity_ = o.capacity_; size_ = o.size_; growth_left_ = o.growth_left_;
+        o.groups_ = nullptr;
+        o.capacity_ = o.size_ = o.growth_left_ = 0;
+    }
+    return *this;
+}
+
+template <class K, class V, class H, class E>
+FlatHashMap<K, V, H, E>::~FlatHashMap() { release(); }
+
+template <class K, class V, class H, class E>
+std::uint32_t FlatHashMap<K, V, H, E>::match(const std::int8_t* g, std::int8_t h2) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(g));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))));
+#else
+    std::uint32_t m = 0;
+    for (std::size_t i = 0; i < kGroup; ++i) m |= std::uint32_t(g[i] == h2) << i;
+    return m;
+#endif
+}
+
+template <class K, class V, class H, class E>
+std::uint32_t FlatHashMap<K, V, H, E>::match_empty(const std::int8_t* g) {
+    return match(g, kEmpty);
+}
+
+template <class K, class V, class H, class E>
+std::uint32_t FlatHashMap<K, V, H, E>::match_free(const std::int8_t* g) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(g));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+    std::uint32_t m = 0;
+    for (std::size_t i = 0; i < kGroup; ++i) m |= std::uint32_t(g[i] < 0) << i;
+    return m;
+#endif
+}
+
+template <class K, class V, class H, class E>
+std::size_t FlatHashMap<K, V, H, E>::find_index(const K& key, std::size_t h) const {
+    if (capacity_ == 0) return capacity_;
+    std::int8_t h2 = static_cast<std::int8_t>(h & 0x7F);
+    for (Probe p = probe(h);; p.next()) {
+        const std::int8_t* g = groups_[p.group].ctrl;
+        for (std::uint32_t m = match(g, h2); m; m &= m - 1) {
+            std::size_t i = p.group * kGroup + __builtin_ctz(m);
+            if (eq_(slot(i)->first, key)) return i;
+        }
+        if (match_empty(g)) return capacity_;
+    }
+}
+
+template <class K, class V, class H, class E>
+std::size_t FlatHashMap<K, V, H, E>::find_free(std::size_t h) const {
+    for (Probe p = probe(h);; p.next()) {
+        std::uint32_t m = match_free(groups_[p.group].ctrl);
+        if (m) return p.group * kGroup + __builtin_ctz(m);
+    }
+}
+
+template <class K, class V, class H, class E>
+typename FlatHashMap<K, V, H, E>::iterator FlatHashMap<K, V, H, E>::find(const K& key) {
+    return iterator(this, find_index(key, hash_(key)));
+}
+
+template <class K, class V, class H, class E>
+typename FlatHashMap<K, V, H, E>::const_iterator FlatHashMap<K, V, H, E>::find(const K& key) const {
+    return const_iterator(this, find_index(key, hash_(key)));
+}
+
+template <class K, class V, class H, class E>
+template <class... Args>
+std::pair<typename FlatHashMap<K, V, H, E>::iterator, bool>
+FlatHashMap<K, V, H, E>::try_emplace(const K& key, Args&&... args) {
+    std::size_t h = hash_(key);
+    std::size_t i = find_index(key, h);
+    if (i != capacity_) return {iterator(this, i), false};
+
+    if (growth_left_ == 0) {
+        // Mostly tombstones: clean up in place instead of doubling.
+        std::size_t cap = capacity_ == 0 ? kGroup
+                        : (size_ < max_load(capacity_) / 2 ? capacity_ : capacity_ * 2);
+        rehash(cap);
+    }
+    i = find_free(h);
+    if (ctrl(i) == kEmpty) --growth_left_;
+    ctrl(i) = static_cast<std::int8_t>(h & 0x7F);
+    new (slot(i)) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+    ++size_;
+    return {iterator(this, i), true};
+}
+
+template <class K, class V, class H, class E>
+typename FlatHashMap<K, V, H, E>::iterator FlatHashMap<K, V, H, E>::erase(iterator it) {
+    std::size_t i = it.i_;
+    slot(i)->~value_type();
+    --size_;
+    // A probe only stops at a group holding an empty slot, so the slot can
+    // go back to empty only if its group already had one.
+    if (match_empty(groups_[i / kGroup].ctrl)) {
+        ctrl(i) = kEmpty;
+        ++growth_left_;
+    } else {
+        ctrl(i) = kDeleted;
+    }
+    return iterator(this, i + 1);
+}
+
+template <class K, class V, class H, class E>
+std::size_t FlatHashMap<K, V, H, E>::erase(const K& key) {
+    iterator it = find(key);
+    if (it == end()) return 0;
+    erase(it);
+    return 1;
+}
+
+template <class K, class V, class H, class E>
+void FlatHashMap<K, V, H, E>::clear() {
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        if (is_full(ctrl(i))) slot(i)->~value_type();
+        ctrl(i) = kEmpty;
+    }
+    size_        = 0;
+    growth_left_ = max_load(capacity_);
+}
+
+template <class K, class V, class H, class E>
+void FlatHashMap<K, V, H, E>::reserve(std::size_t n) {
+    std::size_t cap = kGroup;
+    while (max_load(cap) < n) cap *= 2;
+    if (cap > capacity_) rehash(cap);
+}
+
+template <class K, class V, class H, class E>
+void FlatHashMap<K, V, H, E>::rehash(std::size_t new_cap) {
+    Group*      old_groups = groups_;
+    std::size_t old_cap    = capacity_;
+
+    groups_ = static_cast<Group*>(::operator new(new_cap / kGroup * sizeof(Group),
+                                                 std::align_val_t(alignof(Group))));
+    for (std::size_t g = 0; g < new_cap / kGroup; ++g) std::memset(groups_[g].ctrl, kEmpty, kGroup);
+    capacity_    = new_cap;
+    growth_left_ = max_load(new_cap) - size_;
+
+    for (std::size_t i = 0; i < old_cap; ++i) {
+        Group& og = old_groups[i / kGroup];
+        if (!is_full(og.ctrl[i % kGroup])) continue;
+        value_type* old = reinterpret_cast<value_type*>(og.slots) + i % kGroup;
+        std::size_t h = hash_(old->first);
+        std::size_t j = find_free(h);
+        ctrl(j) = static_cast<std::int8_t>(h & 0x7F);
+        new (slot(j)) value_type(std::move(*old));
+        old->~value_type();
+    }
+    if (old_groups) ::operator delete(old_groups, std::align_val_t(alignof(Group)));
+}
+
+template <class K, class V, class H, class E>
+void FlatHashMap<K, V, H, E>::release() {
+    if (!groups_) return;
+    for (std::size_t i = 0; i < capacity_; ++i) {
+        if (is_full(ctrl(i))) slot(i)->~value_type();
+    }
+    ::operator delete(groups_, std::align_val_t(alignof(Group)));
+    groups_ = nullptr;
+    capacity_ = size_ = growth_left_ = 0;
+}
@@ -1,25 +1,67 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <string>
+#include <string_view>
 
 namespace fs_layout {
 
-constexpr std::size_t kMaxPartSize = 2ULL * 1024 * 1024 * 1024;
+// Bumped whenever object naming or file formats change. Version 1 named
+// objects with std::hash, version 2 with the stable 128-bit path hash,
+// version 3 appends the object's block size as ".b<log2>".
+constexpr unsigned kLayoutVersion = 3;
+
+// Objects are split into part files of a fixed size per cache root, recorded
+// in its LAYOUT header; roots without one use the default.
+constexpr std::size_t kDefaultPartSize = 2ULL * 1024 * 1024 * 1024;
+constexpr std::size_t kMinPartSize     = 64ULL * 1024 * 1024;
+constexpr std::size_t kMaxPartSize     = 1ULL << 40;
+
+inline bool valid_part_size(std::size_t ps) {
+    return ps >= kMinPartSize && ps <= kMaxPartSize && (ps & (ps - 1)) == 0;
+}
 
 constexpr std::size_t kFilesPerDir = 256;
 
+constexpr std::size_t kPathMax = 4096;
+
+
+inline std::string layout_file(const std::string& cache_root) {
+    return cache_root + "/LAYOUT";
+}
+
+inline std::string shard_dir(std::string_view hash_hex) {
+    return std::string(hash_hex.substr(0, 2)) + "/" + std::string(hash_hex.substr(2, 2));
+}
+
+inline std::string data_part_path(const std::string& cache_root, std::string_view hash_hex, std::size_t part_idx) {
+    return cache_root + "/" + shard_dir(hash_hex) + "/" + std::string(hash_hex) + "." + std::to_string(part_idx) + ".blk";
+}
+
+inline std::string bitmap_path(const std::string& cache_root, std::string_view hash_hex, std::size_t part_idx) {
+    return cache_root + "/" + shard_dir(hash_hex) + "/" + std::string(hash_hex) + "." + std::to_string(part_idx) + ".dmap";
+}
 
-inline std::string shard_dir(const std::string& hash_hex) {
-    return hash_hex.substr(0, 2) + "/" + hash_hex.substr(2, 2);
+// Segment files of the packed small-object store.
+inline std::string pack_dir(const std::string& cache_root) {
+    return cache_root + "/packs";
 }
 
-inline std::string data_part_path(const std::string& cache_root, const std::string& hash_hex, std::size_t part_idx) {
-    return cache_root + "/" + shard_dir(hash_hex) + "/" + hash_hex + "." + std::to_string(part_idx) + ".blk";
+inline std::string segment_path(const std::string& pack_dir, std::uint32_t id) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "%08x.seg", id);
+    return pack_dir + "/" + name;
 }
 
-inline std::string bitmap_path(const std::string& cache_root, const std::string& hash_hex, std::size_t part_idx) {
-    return cache_root + "/" + shard_dir(hash_hex) + "/" + hash_hex + "." + std::to_string(part_idx) + ".dmap";
+// Allocation-free variant of data_part_path for the block I/O path.
+// Returns false if the result does not fit in out[kPathMax].
+inline bool format_part_path(char* out, const std::string& cache_root, std::string_view hash_hex, std::size_t part_idx) {
+    int n = std::snprintf(out, kPathMax, "%s/%.2s/%.2s/%.*s.%zu.blk",
+                          cache_root.c_str(), hash_hex.data(), hash_hex.data() + 2,
+                          static_cast<int>(hash_hex.size()), hash_hex.data(), part_idx);
+    return n > 0 && static_cast<std::size_t>(n) < kPathMax;
 }
 
 }
@@ -0,0 +1,18 @@
+#ifndef CACHE_IO_PRIORITY_H
+#define CACHE_IO_PRIORITY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Classes of I/O work, most urgent first. Demand is a user's blocking read;
+// the rest run in the background and yield to it.
+enum class IoPriority : std::uint8_t {
+    kDemand,
+    kPrefetch,
+    kWriteBack,
+    kBackground,   // eviction, scrubbing, preallocation
+};
+
+constexpr std::size_t kIoPriorities = 4;
+
+#endif
@@ -0,0 +1,41 @@
+#include "object_table.h"
+
+#include <cstring>
+#include <stdexcept>
+
+void CacheEntry::set_block_shift(unsigned shift) {
+    block_shift = static_cast<std::uint8_t>(shift);
+    block_size  = std::size_t(1) << shift;
+    // Valid shifts (12..26) always take two digits.
+    std::memcpy(name_buf, hex, kPathHashHexLen);
+    char* p = name_buf + kPathHashHexLen;
+    p[0] = '.';
+    p[1] = 'b';
+    p[2] = static_cast<char>('0' + shift / 10);
+    p[3] = static_cast<char>('0' + shift % 10);
+    name_len = static_cast<std::uint8_t>(kObjectNameMax);
+}
+
+CacheEntry& ObjectTable::intern(std::string_view path) {
+    auto it = ids_.find(path);
+    if (it != ids_.end()) return objects_[it->second];
+
+    if (objects_.size() >= kInvalidObject) throw std::length_error("object table full");
+    ObjectId id = objects_.alloc();
+    CacheEntry& ce = objects_[id];
+    ce.id   = id;
+    ce.path = paths_.intern(path);
+    ce.hash = path_hash128(ce.path.data(), ce.path.size());
+    path_hash_to_hex(ce.hash, ce.hex);
+    ids_.emplace(ce.path, id);
+    return ce;
+}
+
+CacheEntry* ObjectTable::find(std::string_view path) {
+    auto it = ids_.find(path);
+    return it != ids_.end() ? &objects_[it->second] : nullptr;
+}
+
+CacheEntry* ObjectTable::get(ObjectId id) {
+    return id < objects_.size() ? &objects_[id] : nullptr;
+}
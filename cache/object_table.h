@@ -0,0 +1,100 @@
+#ifndef CACHE_OBJECT_TABLE_H
+#define CACHE_OBJECT_TABLE_H
+
+#include "block_id.h"
+#include "flat_hash_map.h"
+#include "path_hash.h"
+#include "slab_pool.h"
+#include "string_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+// Per-block residency as last observed by the cache. kUnknown blocks are
+// probed on disk once (e.g. after a restart); the rest skip the probe.
+class BlockPresence {
+public:
+    enum State : std::uint8_t { kUnknown = 0, kAbsent = 1, kPresent = 2 };
+
+    State get(std::size_t blk) const {
+        return blk < states_.size() ? static_cast<State>(states_[blk]) : kUnknown;
+    }
+    void set(std::size_t blk, State s) {
+        if (states_.size() <= blk) states_.resize(blk + 1, kUnknown);
+        states_[blk] = s;
+    }
+    void clear() { states_.clear(); }
+    std::size_t size() const { return states_.size(); }
+    std::size_t count(State s) const {
+        std::size_t n = 0;
+        for (std::uint8_t st : states_) n += st == s;
+        return n;
+    }
+
+private:
+    std::vector<std::uint8_t> states_;
+};
+
+// On-disk object name: "<hash hex>.b<log2 block size>".
+constexpr std::size_t kObjectNameMax = kPathHashHexLen + 4;
+
+// The path lives in the table's string arena and the hex name inline, so an
+// entry owns no heap strings.
+struct CacheEntry {
+    ObjectId         id = kInvalidObject;
+    bool             evicted = false;
+    bool             has_data = false;
+    bool             packed = false;
+    bool             inlined = false;
+    std::uint8_t     block_shift = 0;
+    std::uint8_t     name_len = 0;
+    std::size_t      block_size = 0;
+    std::size_t      size_hint = 0;
+    std::uint32_t    seq_reads = 0;
+    std::uint32_t    rand_reads = 0;
+    std::uint32_t    write_gen = 0;
+    std::uint32_t    opens = 0;        // cache_open_file() calls not yet closed
+    std::size_t      last_block = std::numeric_limits<std::size_t>::max();
+    std::string_view path;
+    PathHash         hash;
+    char             hex[kPathHashHexLen];
+    char             name_buf[kObjectNameMax];
+    BlockPresence    present;
+
+    std::string_view hash_hex() const { return {hex, kPathHashHexLen}; }
+    std::string_view name() const { return {name_buf, name_len}; }
+
+    // Switches the entry to 2^shift byte blocks and renames its objects.
+    void set_block_shift(unsigned shift);
+};
+
+// Dense path -> ObjectId table. Entries are never removed and live in slab
+// storage indexed by id, so references and ids stay valid for the life of
+// the table. Not thread-safe; callers serialise access.
+class ObjectTable {
+public:
+    CacheEntry& intern(std::string_view path);
+    CacheEntry* find(std::string_view path);
+    CacheEntry* get(ObjectId id);
+
+    std::size_t size() const { return objects_.size(); }
+
+    std::size_t memory_bytes() const {
+        return objects_.memory_bytes() + ids_.memory_bytes() + paths_.memory_bytes();
+    }
+
+    template <class F>
+    void for_each(F&& f) {
+        for (ObjectId id = 0; id < objects_.size(); ++id) f(objects_[id]);
+    }
+
+private:
+    SlabPool<CacheEntry, 1024>            objects_;
+    FlatHashMap<std::string_view, ObjectId> ids_;
+    StringArena                           paths_;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "pack_store.h"
+#include "fs_layout.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::uint32_t kMagic         = 0x4B504353;   // "SCPK"
+constexpr std::uint32_t kTombstone     = 0xFFFFFFFF;
+constexpr auto          kCleanInterval = std::chrono::seconds(1);
+
+}
+
+PackStore::Segment::~Segment() {
+    if (fd >= 0) ::close(fd);
+}
+
+PackStore::PackStore(std::string dir, std::size_t segment_size)
+: dir_(std::move(dir)), segment_size_(segment_size) {}
+
+PackStore::~PackStore() {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (cleaner_.joinable()) cleaner_.join();
+}
+
+std::uint32_t PackStore::checksum(const Header& h, const char* data) {
+    PathHash d = path_hash128(data, h.len == kTombstone ? 0 : h.len, h.hi ^ h.lo);
+    return static_cast<std::uint32_t>(d.lo ^ (d.lo >> 32)) ^ h.blk ^ (h.shift << 24) ^ h.len;
+}
+
+std::shared_ptr<PackStore::Segment> PackStore::open_segment(std::uint32_t id, bool create) {
+    std::string path = fs_layout::segment_path(dir_, id);
+    int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    if (fd < 0) {
+        std::cerr << "[pack_store] failed to open " << path << ": " << std::strerror(errno) << '\n';
+        return nullptr;
+    }
+    auto seg = std::make_shared<Segment>();
+    seg->id = id;
+    seg->fd = fd;
+    return seg;
+}
+
+// Segments are replayed oldest first, so later records win; a segment ends
+// at its first torn record.
+bool PackStore::init() {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) {
+        std::cerr << "[pack_store] failed to create '" << dir_ << "': " << ec.message() << '\n';
+        return false;
+    }
+    std::vector<std::uint32_t> ids;
+    for (auto const& f : fs::directory_iterator(dir_, ec))
+        if (f.path().extension() == ".seg")
+            ids.push_back(static_cast<std::uint32_t>(std::strtoul(f.path().stem().c_str(), nullptr, 16)));
+    std::sort(ids.begin(), ids.end());
+
+    std::lock_guard<std::mutex> g(mu_);
+    for (std::uint32_t id : ids) {
+        auto seg = open_segment(id, false);
+        if (!seg) continue;
+        segments_[id] = seg;
+        scan(*seg);
+    }
+    cleaner_ = std::thread(&PackStore::clean_loop, this);
+    return true;
+}
+
+bool PackStore::scan(Segment& seg) {
+    struct stat st;
+    if (::fstat(seg.fd, &st) != 0) return false;
+    const std::size_t end = static_cast<std::size_t>(st.st_size);
+    std::size_t pos = 0;
+    Header h;
+    while (pos + sizeof(Header) <= end) {
+        if (::pread(seg.fd, &h, sizeof(h), pos) != static_cast<ssize_t>(sizeof(h)) || h.magic != kMagic) break;
+        std::size_t rec = sizeof(Header) + (h.len == kTombstone ? 0 : h.len);
+        if (pos + rec > end) break;
+        PackKey key{h.hi, h.lo, h.blk, h.shift};
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            drop(it->second);
+            index_.erase(it);
+        }
+        if (h.len != kTombstone) {
+            index_.emplace(key, Loc{seg.id, h.len, pos});
+            seg.live += rec;
+        }
+        pos += rec;
+    }
+    seg.size = pos;
+    return true;
+}
+
+void PackStore::drop(const Loc& loc) {
+    auto it = segments_.find(loc.seg);
+    if (it != segments_.end()) it->second->live -= sizeof(Header) + loc.len;
+}
+
+// Appends one record to the active segment, starting a new one when full.
+// Called with mu_ held.
+ssize_t PackStore::append(const PackKey& key, const char* buf, std::uint32_t len, Loc& loc) {
+    const std::size_t data = len == kTombstone ? 0 : len;
+    const std::size_t rec  = sizeof(Header) + data;
+    if (!active_ || (active_->size && active_->size + rec > segment_size_)) {
+        std::uint32_t id = segments_.empty() ? 0 : segments_.rbegin()->first + 1;
+        auto seg = open_segment(id, true);
+        if (!seg) return -EIO;
+        segments_[id] = seg;
+        active_ = std::move(seg);
+    }
+    Header h{kMagic, len, key.hi, key.lo, key.blk, key.shift, 0, 0};
+    h.check = checksum(h, buf);
+    iovec iov[2] = {{&h, sizeof(h)}, {const_cast<char*>(buf), data}};
+    ssize_t n = ::pwritev(active_->fd, iov, data ? 2 : 1, active_->size);
+    if (n < 0) return -errno;
+    if (static_cast<std::size_t>(n) != rec) return -EIO;
+    loc = Loc{active_->id, len, active_->size};
+    active_->size += rec;
+    return static_cast<ssize_t>(data);
+}
+
+ssize_t PackStore::write(const PackKey& key, const char* buf, std::size_t len) {
+    if (len >= kTombstone || sizeof(Header) + len > segment_size_) return -EFBIG;
+    std::lock_guard<std::mutex> g(mu_);
+    Loc loc;
+    ssize_t n = append(key, buf, static_cast<std::uint32_t>(len), loc);
+    if (n < 0) return n;
+    auto [it, inserted] = index_.try_emplace(key, loc);
+    if (!inserted) {
+        drop(it->second);
+        it->second = loc;
+    }
+    active_->live += sizeof(Header) + len;
+    return n;
+}
+
+bool PackStore::erase(const PackKey& key) {
+    std::lock_guard<std::mutex> g(mu_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    drop(it->second);
+    index_.erase(it);
+    Loc loc;
+    append(key, nullptr, kTombstone, loc);
+    return true;
+}
+
+std::size_t PackStore::erase_object(std::uint64_t hi, std::uint64_t lo) {
+    std::lock_guard<std::mutex> g(mu_);
+    std::size_t n = 0;
+    for (auto it = index_.begin(); it != index_.end();) {
+        if (it->first.hi != hi || it->first.lo != lo) {
+            ++it;
+            continue;
+        }
+        const PackKey key = it->first;
+        drop(it->second);
+        it = index_.erase(it);
+        Loc loc;
+        append(key, nullptr, kTombstone, loc);
+        ++n;
+    }
+    return n;
+}
+
+// The segment is pinned by the handle, so a concurrent clean cannot close
+// it underneath the read.
+ssize_t PackStore::read(const PackKey& key, char* buf, std::size_t len) {
+    Loc loc;
+    std::shared_ptr<Segment> seg;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        auto it = index_.find(key);
+        if (it == index_.end()) return -ENOENT;
+        loc = it->second;
+        seg = segments_.at(loc.seg);
+    }
+    if (len < loc.len) return -EOVERFLOW;
+
+    Header h;
+    iovec iov[2] = {{&h, sizeof(h)}, {buf, loc.len}};
+    ssize_t n = ::preadv(seg->fd, iov, 2, loc.off);
+    if (n < 0) return -errno;
+    if (static_cast<std::size_t>(n) == sizeof(h) + loc.len && h.magic == kMagic && h.len == loc.len &&
+        h.hi == key.hi && h.lo == key.lo && h.blk == key.blk && h.shift == key.shift &&
+        h.check == checksum(h, buf))
+        return loc.len;
+
+    std::cerr << "[pack_store] dropping corrupt record in " << fs_layout::segment_path(dir_, loc.seg) << '\n';
+    std::lock_guard<std::mutex> g(mu_);
+    auto it = index_.find(key);
+    if (it != index_.end() && it->second.seg == loc.seg && it->second.off == loc.off) {
+        drop(it->second);
+        index_.erase(it);
+    }
+    return -EIO;
+}
+
+// Live records are re-appended to the active segment one at a time, each
+// committed only if the index still points at the old copy. Tombstones are
+// carried over while an older segment may still hold what they delete.
+bool PackStore::collect() {
+    std::shared_ptr<Segment> victim;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        if (stop_) return false;
+        for (auto& [id, seg] : segments_) {
+            if (seg == active_ || seg->live * 2 > seg->size) continue;
+            if (!victim || seg->live * victim->size < victim->live * seg->size) victim = seg;
+        }
+        if (!victim) return false;
+    }
+
+    std::vector<char> data;
+    std::size_t pos = 0;
+    Header h;
+    while (pos + sizeof(Header) <= victim->size) {
+        if (::pread(victim->fd, &h, sizeof(h), pos) != static_cast<ssize_t>(sizeof(h)) || h.magic != kMagic) return false;
+        const std::size_t rec_off = pos;
+        const std::size_t len     = h.len == kTombstone ? 0 : h.len;
+        pos += sizeof(Header) + len;
+        PackKey key{h.hi, h.lo, h.blk, h.shift};
+
+        if (h.len == kTombstone) {
+            std::lock_guard<std::mutex> g(mu_);
+            Loc loc;
+            if (!index_.contains(key) && segments_.begin()->first < victim->id &&
+                append(key, nullptr, kTombstone, loc) < 0)
+                return false;
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> g(mu_);
+            auto it = index_.find(key);
+            if (it == index_.end() || it->second.seg != victim->id || it->second.off != rec_off) continue;
+        }
+        data.resize(len);
+        if (::pread(victim->fd, data.data(), len, rec_off + sizeof(Header)) != static_cast<ssize_t>(len)) return false;
+        bool intact = checksum(h, data.data()) == h.check;
+
+        std::lock_guard<std::mutex> g(mu_);
+        auto it = index_.find(key);
+        if (it == index_.end() || it->second.seg != victim->id || it->second.off != rec_off) continue;
+        drop(it->second);
+        if (!intact) {
+            index_.erase(it);
+            continue;
+        }
+        Loc loc;
+        if (append(key, data.data(), h.len, loc) < 0) {
+            victim->live += sizeof(Header) + len;
+            return false;
+        }
+        it->second = loc;
+        active_->live += sizeof(Header) + len;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        if (victim->live) return false;
+        segments_.erase(victim->id);
+        ++collected_;
+    }
+    ::unlink(fs_layout::segment_path(dir_, victim->id).c_str());
+    return true;
+}
+
+void PackStore::clean_loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!stop_) {
+        cv_.wait_for(lk, kCleanInterval, [&] { return stop_; });
+        if (stop_) break;
+        lk.unlock();
+        while (collect()) {}
+        lk.lock();
+    }
+}
+
+PackStore::Stats PackStore::stats() {
+    std::lock_guard<std::mutex> g(mu_);
+    Stats s;
+    s.segments  = segments_.size();
+    s.records   = index_.size();
+    s.collected = collected_;
+    for (auto& [id, seg] : segments_) {
+        s.live_bytes += seg->live;
+        s.dead_bytes += seg->size - seg->live;
+    }
+    return s;
+}
@@ -0,0 +1,121 @@
+#ifndef CACHE_PACK_STORE_H
+#define CACHE_PACK_STORE_H
+
+#include "flat_hash_map.h"
+#include "path_hash.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/types.h>
+
+// One block of a packed object: the object's path hash, its block shift and
+// the block index.
+struct PackKey {
+    std::uint64_t hi;
+    std::uint64_t lo;
+    std::uint32_t blk;
+    std::uint32_t shift;
+
+    bool operator==(const PackKey& o) const {
+        return hi == o.hi && lo == o.lo && blk == o.blk && shift == o.shift;
+    }
+};
+
+struct PackKeyHash {
+    std::size_t operator()(const PackKey& k) const {
+        return FlatHash<std::uint64_t>{}(k.lo ^ (k.hi * 0x9E3779B97F4A7C15ULL) ^ (std::uint64_t(k.shift) << 32 | k.blk));
+    }
+};
+
+// Blocks of small objects appended to large segment files, so caching one
+// costs no open, mkdir or unlink of its own. An in-memory index maps each
+// key to its latest record and is rebuilt from the record headers on
+// startup; deletes append a tombstone. Rewrites and deletes leave dead bytes
+// behind, and a background cleaner copies the live records out of mostly
+// dead segments and unlinks them. Every record carries a checksum of its
+// contents that reads verify, so a torn write reads as a miss.
+class PackStore {
+public:
+    static constexpr std::size_t kDefaultSegmentSize = 64 * 1024 * 1024;
+
+    struct Stats {
+        std::size_t   segments = 0;
+        std::size_t   records = 0;
+        std::size_t   live_bytes = 0;
+        std::size_t   dead_bytes = 0;
+        std::uint64_t collected = 0;   // segments reclaimed by the cleaner
+    };
+
+    explicit PackStore(std::string dir, std::size_t segment_size = kDefaultSegmentSize);
+    ~PackStore();
+
+    bool init();
+
+    ssize_t read(const PackKey& key, char* buf, std::size_t len);
+    ssize_t write(const PackKey& key, const char* buf, std::size_t len);
+    bool    erase(const PackKey& key);
+    // Erases every record of the object, at any block size; returns how many.
+    std::size_t erase_object(std::uint64_t hi, std::uint64_t lo);
+
+    // Reclaims the sealed segment with the fewest live bytes if at most
+    // half of it is live; false if there was none.
+    bool collect();
+
+    Stats stats();
+
+private:
+    struct Header {
+        std::uint32_t magic;
+        std::uint32_t len;
+        std::uint64_t hi;
+        std::uint64_t lo;
+        std::uint32_t blk;
+        std::uint32_t shift;
+        std::uint32_t check;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(Header) == 40, "record header layout is on disk");
+    struct Segment {
+        std::uint32_t id = 0;
+        int           fd = -1;
+        std::size_t   size = 0;    // bytes appended
+        std::size_t   live = 0;    // bytes of records still indexed
+        ~Segment();
+    };
+    struct Loc {
+        std::uint32_t seg;
+        std::uint32_t len;
+        std::uint64_t off;         // record start
+    };
+
+    static std::uint32_t checksum(const Header& h, const char* data);
+
+    std::shared_ptr<Segment> open_segment(std::uint32_t id, bool create);
+    bool    scan(Segment& seg);
+    ssize_t append(const PackKey& key, const char* buf, std::uint32_t len, Loc& loc);
+    void    drop(const Loc& loc);
+    void    clean_loop();
+
+    std::string  dir_;
+    std::size_t  segment_size_;
+
+    std::mutex                                          mu_;
+    std::condition_variable                             cv_;
+    FlatHashMap<PackKey, Loc, PackKeyHash>              index_;
+    std::map<std::uint32_t, std::shared_ptr<Segment>>   segments_;
+    std::shared_ptr<Segment>                            active_;
+    std::uint64_t                                       collected_ = 0;
+    bool                                                stop_ = false;
+    std::thread                                         cleaner_;
+
+    PackStore(const PackStore&)            = delete;
+    PackStore& operator=(const PackStore&) = delete;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "path_hash.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr std::uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+constexpr std::uint64_t kPrime32_1 = 0x9E3779B1ULL;
+constexpr std::uint64_t kPrime32_2 = 0x85EBCA77ULL;
+constexpr std::uint64_t kPrime32_3 = 0xC2B2AE3DULL;
+
+constexpr std::size_t kSecretWords     = 24;
+constexpr std::size_t kStripeLen       = 64;
+constexpr std::size_t kLanes           = 8;
+constexpr std::size_t kStripesPerBlock = 16;
+
+// The key material is generated from a fixed seed with splitmix64, so it is
+// part of the on-disk format: changing it requires bumping kLayoutVersion.
+struct Secret {
+    std::uint64_t w[kSecretWords];
+};
+
+constexpr Secret make_secret() {
+    Secret s{};
+    std::uint64_t x = 0x6361636865667321ULL;
+    for (std::size_t i = 0; i < kSecretWords; ++i) {
+        x += 0x9E3779B97F4A7C15ULL;
+        std::uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        s.w[i] = z ^ (z >> 31);
+    }
+    return s;
+}
+
+constexpr Secret kSecret = make_secret();
+
+inline std::uint64_t read64(const std::uint8_t* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline std::uint64_t read32(const std::uint8_t* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline std::uint64_t rotl64(std::uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+inline std::uint64_t mul_fold(std::uint64_t a, std::uint64_t b) {
+    unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+    return static_cast<std::uint64_t>(p) ^ static_cast<std::uint64_t>(p >> 64);
+}
+
+inline std::uint64_t avalanche(std::uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+inline std::uint64_t mix16(const std::uint8_t* p, const std::uint64_t* sec, std::uint64_t seed) {
+    return mul_fold(read64(p) ^ (sec[0] + seed), read64(p + 8) ^ (sec[1] - seed));
+}
+
+PathHash hash_short(const std::uint8_t* p, std::size_t len, std::uint64_t seed) {
+    std::uint64_t a = 0, b = 0;
+    if (len > 8) {
+        a = read64(p);
+        b = read64(p + len - 8);
+    } else if (len >= 4) {
+        a = read32(p);
+        b = read32(p + len - 4);
+    } else if (len > 0) {
+        a = std::uint64_t(p[0]) | std::uint64_t(p[len >> 1]) << 8 | std::uint64_t(p[len - 1]) << 16;
+    }
+    const std::uint64_t* s = kSecret.w;
+    PathHash h;
+    h.lo = avalanche(mul_fold(a ^ (s[0] + seed), b ^ (s[1] - seed)) ^ (len * kPrime64_1));
+    h.hi = avalanche(mul_fold(a ^ (s[2] - seed), rotl64(b, 29) ^ (s[3] + seed)) + (len * kPrime64_2));
+    return h;
+}
+
+PathHash hash_mid(const std::uint8_t* p, std::size_t len, std::uint64_t seed) {
+    const std::uint64_t* s = kSecret.w;
+    std::uint64_t lo = len * kPrime64_1;
+    std::uint64_t hi = len * kPrime64_4;
+    std::size_t chunks = (len - 1) / 16;
+    for (std::size_t i = 0; i < chunks; ++i) {
+        const std::uint8_t* c = p + 16 * i;
+        lo += mix16(c, s + (2 * i) % 16, seed);
+        hi  = rotl64(hi ^ mix16(c, s + (2 * i + 5) % 16, seed), 27) * kPrime64_1;
+    }
+    const std::uint8_t* tail = p + len - 16;
+    lo += mix16(tail, s + 16, seed);
+    hi += mix16(tail, s + 18, seed);
+    PathHash h;
+    h.lo = avalanche(lo + hi * kPrime64_3);
+    h.hi = avalanche(hi ^ (lo * kPrime64_5));
+    return h;
+}
+
+// The lane loop has no cross-lane dependency inside a stripe and vectorises
+// to SSE2/AVX2 multiplies at -O2.
+inline void accumulate(std::uint64_t* acc, const std::uint8_t* in, const std::uint64_t* sec) {
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        std::uint64_t v = read64(in + 8 * i);
+        std::uint64_t k = v ^ sec[i];
+        acc[i ^ 1] += v;
+        acc[i]     += (k & 0xFFFFFFFFULL) * (k >> 32);
+    }
+}
+
+inline void scramble(std::uint64_t* acc, const std::uint64_t* sec) {
+    for (std::size_t i = 0; i < kLanes; ++i) {
+        std::uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= sec[i];
+        acc[i] = a * kPrime32_1;
+    }
+}
+
+PathHash hash_long(const std::uint8_t* p, std::size_t len, std::uint64_t seed) {
+    std::uint64_t acc[kLanes] = {
+        kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+        kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+    for (auto& a : acc) a ^= seed;
+
+    const std::uint64_t* s = kSecret.w;
+    std::size_t stripes = (len - 1) / kStripeLen;
+    for (std::size_t n = 0; n < stripes; ++n) {
+        accumulate(acc, p + n * kStripeLen, s + n % kStripesPerBlock);
+        if (n % kStripesPerBlock == kStripesPerBlock - 1) scramble(acc, s + 16);
+    }
+    accumulate(acc, p + len - kStripeLen, s + 15);
+
+    std::uint64_t lo = len * kPrime64_1;
+    std::uint64_t hi = ~(len * kPrime64_2);
+    for (std::size_t i = 0; i < 4; ++i) {
+        lo += mul_fold(acc[2 * i] ^ s[2 * i], acc[2 * i + 1] ^ s[2 * i + 1]);
+        hi += mul_fold(acc[2 * i] ^ s[2 * i + 11], acc[2 * i + 1] ^ s[2 * i + 12]);
+    }
+    PathHash h;
+    h.lo = avalanche(lo);
+    h.hi = avalanche(hi);
+    return h;
+}
+
+}
+
+PathHash path_hash128(const void* data, std::size_t len, std::uint64_t seed) {
+    const auto* p = static_cast<const std::uint8_t*>(data);
+    if (len <= 16)  return hash_short(p, len, seed);
+    if (len <= 128) return hash_mid(p, len, seed);
+    return hash_long(p, len, seed);
+}
+
+void path_hash_to_hex(const PathHash& h, char* out) {
+    static const char kDigits[] = "0123456789abcdef";
+    for (int i = 0; i < 16; ++i) {
+        out[i]      = kDigits[(h.hi >> (60 - 4 * i)) & 0xF];
+        out[16 + i] = kDigits[(h.lo >> (60 - 4 * i)) & 0xF];
+    }
+}
+
+std::string path_hash_hex(const std::string& path) {
+    char buf[kPathHashHexLen];
+    path_hash_to_hex(path_hash128(path), buf);
+    return std::string(buf, kPathHashHexLen);
+}
@@ -0,0 +1,32 @@
+#ifndef CACHE_PATH_HASH_H
+#define CACHE_PATH_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Stable 128-bit non-cryptographic hash used to name cached objects.
+// The output depends only on the input bytes, never on the compiler or the
+// standard library, so object names survive binary upgrades.
+struct PathHash {
+    std::uint64_t lo = 0;
+    std::uint64_t hi = 0;
+
+    bool operator==(const PathHash& o) const { return lo == o.lo && hi == o.hi; }
+    bool operator!=(const PathHash& o) const { return !(*this == o); }
+};
+
+constexpr std::size_t kPathHashHexLen = 32;
+
+PathHash path_hash128(const void* data, std::size_t len, std::uint64_t seed = 0);
+
+inline PathHash path_hash128(const std::string& s) {
+    return path_hash128(s.data(), s.size());
+}
+
+// Writes exactly kPathHashHexLen lowercase hex digits, no terminator.
+void path_hash_to_hex(const PathHash& h, char* out);
+
+std::string path_hash_hex(const std::string& path);
+
+#endif
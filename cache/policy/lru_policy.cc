@@ -1,56 +1,84 @@
 #include "lru_policy.h"
 
+#include <algorithm>
 #include <cfloat>
-#include <limits>
 
 
 LruPolicy::LruPolicy(std::size_t capacity)
-: capacity_(capacity) {}
+: capacity_(capacity) {
+    nodes_.reserve(capacity);
+    map_.reserve(capacity);
+}
+
+
+void LruPolicy::link_front(Index i) {
+    Node& n = nodes_[i];
+    n.prev = kNil;
+    n.next = head_;
+    if (head_ != kNil) nodes_[head_].prev = i;
+    head_ = i;
+    if (tail_ == kNil) tail_ = i;
+}
+
+void LruPolicy::unlink(Index i) {
+    Node& n = nodes_[i];
+    if (n.prev != kNil) nodes_[n.prev].next = n.next; else head_ = n.next;
+    if (n.next != kNil) nodes_[n.next].prev = n.prev; else tail_ = n.prev;
+}
+
+void LruPolicy::drop(Index i) {
+    unlink(i);
+    map_.erase(nodes_[i].id);
+    nodes_.free(i);
+}
 
 
-void LruPolicy::touch(std::size_t blockId, std::size_t bytes, double hotness) {
+void LruPolicy::touch(BlockKey blockId, std::size_t bytes, double hotness) {
 auto it = map_.find(blockId);
 
 if (it != map_.end()) {
-    order_.erase(it->second);
-    map_.erase(it);
+    Index i = it->second;
+    unlink(i);
+    nodes_[i].bytes   = static_cast<std::uint32_t>(std::min<std::size_t>(bytes, UINT32_MAX));
+    nodes_[i].hotness = static_cast<float>(hotness);
+    link_front(i);
+    return;
 }
-if (order_.size() >= capacity_) {
-    std::size_t victim = evict();
+if (nodes_.size() >= capacity_) {
+    BlockKey victim = evict();
     (void)victim;
 }
 
-order_.push_front({blockId, bytes, hotness});
-map_[blockId] = order_.begin();
+Index i = nodes_.alloc(Node{blockId, kNil, kNil,
+                            static_cast<std::uint32_t>(std::min<std::size_t>(bytes, UINT32_MAX)),
+                            static_cast<float>(hotness)});
+link_front(i);
+map_[blockId] = i;
 }
 
 
-void LruPolicy::remove(std::size_t blockId) {
+void LruPolicy::remove(BlockKey blockId) {
 auto it = map_.find(blockId);
-if (it != map_.end()) {
-    order_.erase(it->second);
-    map_.erase(it);
-}
+if (it != map_.end()) drop(it->second);
 }
 
 
-std::size_t LruPolicy::evict() {
-if (order_.empty()) return std::numeric_limits<std::size_t>::max();
+BlockKey LruPolicy::evict() {
+if (head_ == kNil) return kInvalidBlockKey;
 
-auto victim_it   = order_.end();
+Index victim = kNil;
 double worstScore = -DBL_MAX;
 
-for (auto it = order_.begin(); it != order_.end(); ++it) {
-    double s = score(*it);
+for (Index i = head_; i != kNil; i = nodes_[i].next) {
+    double s = score(nodes_[i]);
     if (s > worstScore) {
         worstScore = s;
-        victim_it  = it;
+        victim     = i;
     }
 }
-if (victim_it == order_.end()) return std::numeric_limits<std::size_t>::max();
+if (victim == kNil) return kInvalidBlockKey;
 
-std::size_t victimId = victim_it->id;
-order_.erase(victim_it);
-map_.erase(victimId);
+BlockKey victimId = nodes_[victim].id;
+drop(victim);
 return victimId;
 }
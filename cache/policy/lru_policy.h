@@ -1,35 +1,55 @@
 #ifndef CACHE_POLICY_LRU_POLICY_H
 #define CACHE_POLICY_LRU_POLICY_H
 
+#include "block_id.h"
+#include "flat_hash_map.h"
+#include "slab_pool.h"
+
 #include <cstddef>
-#include <list>
-#include <unordered_map>
+#include <cstdint>
 
 class LruPolicy {
 public:
     explicit LruPolicy(std::size_t capacity);
 
-    void touch(std::size_t blockId, std::size_t bytes, double hotness);
+    void touch(BlockKey blockId, std::size_t bytes, double hotness);
+
+    void remove(BlockKey blockId);
+
+    BlockKey evict();
 
-    void remove(std::size_t blockId);
+    std::size_t size() const { return nodes_.size(); }
 
-    std::size_t evict();
+    // Heap bytes held by the policy; divide by size() for per-block cost.
+    std::size_t memory_bytes() const { return nodes_.memory_bytes() + map_.memory_bytes(); }
 
 private:
+    using Index = SlabPool<int>::Index;
+    static constexpr Index kNil = SlabPool<int>::kNil;
+
+    // 24 bytes per tracked block; the recency list is threaded through the
+    // pool so touching a block relinks it without allocating.
     struct Node {
-        std::size_t id;
-        std::size_t bytes;
-        double      hotness;
+        BlockKey      id;
+        Index         prev;
+        Index         next;
+        std::uint32_t bytes;
+        float         hotness;
     };
 
     static inline double score(const Node& n) {
         return n.bytes * (1.0 - n.hotness);
     }
 
+    void link_front(Index i);
+    void unlink(Index i);
+    void drop(Index i);
+
     std::size_t capacity_;
-    std::list<Node> order_;
-    std::unordered_map<std::size_t,
-        std::list<Node>::iterator> map_;
+    SlabPool<Node> nodes_;
+    FlatHashMap<BlockKey, Index> map_;
+    Index head_ = kNil;
+    Index tail_ = kNil;
 
     LruPolicy(const LruPolicy&)            = delete;
     LruPolicy& operator=(const LruPolicy&) = delete;
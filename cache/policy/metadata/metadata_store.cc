@@ -6,6 +6,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <filesystem>
@@ -38,6 +39,24 @@ bool MetadataStore::init() {
         "timestamp INTEGER,"
         "last_accessed INTEGER,"
         "dirty INTEGER"
+        ");"
+        "CREATE TABLE IF NOT EXISTS objects ("
+        "hash TEXT PRIMARY KEY,"
+        "path TEXT,"
+        "block_size INTEGER,"
+        "size INTEGER,"
+        "seq_reads INTEGER,"
+        "rand_reads INTEGER,"
+        "packed INTEGER DEFAULT 0,"
+        "inlined INTEGER DEFAULT 0"
+        ");"
+        "CREATE TABLE IF NOT EXISTS inline_data ("
+        "hash TEXT PRIMARY KEY,"
+        "data BLOB"
+        ");"
+        "CREATE TABLE IF NOT EXISTS access_profiles ("
+        "hash TEXT PRIMARY KEY,"
+        "ranges BLOB"
         ");";
     char* errmsg = nullptr;
     if (sqlite3_exec(db, create_sql, nullptr, nullptr, &errmsg) != SQLITE_OK) {
@@ -45,6 +64,9 @@ bool MetadataStore::init() {
         sqlite3_free(errmsg);
         return false;
     }
+    // Tables created before objects could be packed or inlined lack the columns.
+    sqlite3_exec(db, "ALTER TABLE objects ADD COLUMN packed INTEGER DEFAULT 0;", nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "ALTER TABLE objects ADD COLUMN inlined INTEGER DEFAULT 0;", nullptr, nullptr, nullptr);
     return true;
 }
 
@@ -164,7 +186,8 @@ std::vector<CacheMetadata> MetadataStore::allEntries() {
 
 void MetadataStore::cleanup() {
     if (db_handle_) {
-        const char* sql = "DROP TABLE IF EXISTS metadata;";
+        const char* sql = "DROP TABLE IF EXISTS metadata; DROP TABLE IF EXISTS objects; "
+                          "DROP TABLE IF EXISTS inline_data; DROP TABLE IF EXISTS access_profiles;";
         char* errmsg = nullptr;
         sqlite3_exec(static_cast<sqlite3*>(db_handle_), sql, nullptr, nullptr, &errmsg);
         if (errmsg) sqlite3_free(errmsg);
@@ -173,20 +196,145 @@ void MetadataStore::cleanup() {
     }
 }
 
+std::optional<ObjectRecord> MetadataStore::getObject(std::string_view hash_hex) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql =
+        "SELECT path, block_size, size, seq_reads, rand_reads, packed, inlined "
+        "FROM objects WHERE hash=?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+        return std::nullopt;
 
-void MetadataStore::markDirtyBlock(const std::string& hash_hex, std::size_t part_idx,std::size_t block_idx) {
-    auto& vec = bitmap_[hash_hex][part_idx];
+    sqlite3_bind_text(stmt, 1, hash_hex.data(), static_cast<int>(hash_hex.size()), SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        ObjectRecord rec;
+        rec.hash       = std::string(hash_hex);
+        rec.path       = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        rec.block_size = sqlite3_column_int64(stmt, 1);
+        rec.size       = sqlite3_column_int64(stmt, 2);
+        rec.seq_reads  = static_cast<std::uint32_t>(sqlite3_column_int64(stmt, 3));
+        rec.rand_reads = static_cast<std::uint32_t>(sqlite3_column_int64(stmt, 4));
+        rec.packed     = sqlite3_column_int(stmt, 5) != 0;
+        rec.inlined    = sqlite3_column_int(stmt, 6) != 0;
+        sqlite3_finalize(stmt);
+        return rec;
+    }
+    sqlite3_finalize(stmt);
+    return std::nullopt;
+}
+
+bool MetadataStore::putObject(const ObjectRecord& rec) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql =
+        "INSERT INTO objects "
+        "(hash, path, block_size, size, seq_reads, rand_reads, packed, inlined) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT(hash) DO UPDATE SET "
+        "path=excluded.path, block_size=excluded.block_size, "
+        "size=excluded.size, seq_reads=excluded.seq_reads, "
+        "rand_reads=excluded.rand_reads, packed=excluded.packed, "
+        "inlined=excluded.inlined;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    sqlite3_bind_text(stmt, 1, rec.hash.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, rec.path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(rec.block_size));
+    sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(rec.size));
+    sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(rec.seq_reads));
+    sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(rec.rand_reads));
+    sqlite3_bind_int(stmt, 7, rec.packed ? 1 : 0);
+    sqlite3_bind_int(stmt, 8, rec.inlined ? 1 : 0);
+
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+ssize_t MetadataStore::getInline(std::string_view hash_hex, char* buf, std::size_t len) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql = "SELECT data FROM inline_data WHERE hash=?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return -EIO;
+
+    sqlite3_bind_text(stmt, 1, hash_hex.data(), static_cast<int>(hash_hex.size()), SQLITE_TRANSIENT);
+    ssize_t n = -ENOENT;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        n = std::min<ssize_t>(sqlite3_column_bytes(stmt, 0), static_cast<ssize_t>(len));
+        if (n > 0) std::memcpy(buf, sqlite3_column_blob(stmt, 0), n);
+    }
+    sqlite3_finalize(stmt);
+    return n;
+}
+
+bool MetadataStore::putInline(std::string_view hash_hex, const char* data, std::size_t len) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql = "INSERT OR REPLACE INTO inline_data (hash, data) VALUES (?, ?);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    sqlite3_bind_text(stmt, 1, hash_hex.data(), static_cast<int>(hash_hex.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 2, data, static_cast<int>(len), SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool MetadataStore::eraseInline(std::string_view hash_hex) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql = "DELETE FROM inline_data WHERE hash=?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    sqlite3_bind_text(stmt, 1, hash_hex.data(), static_cast<int>(hash_hex.size()), SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+std::optional<std::string> MetadataStore::getProfile(std::string_view hash_hex) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql = "SELECT ranges FROM access_profiles WHERE hash=?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return std::nullopt;
+
+    sqlite3_bind_text(stmt, 1, hash_hex.data(), static_cast<int>(hash_hex.size()), SQLITE_TRANSIENT);
+    std::optional<std::string> blob;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+        blob.emplace(data ? data : "", sqlite3_column_bytes(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return blob;
+}
+
+bool MetadataStore::putProfile(std::string_view hash_hex, std::string_view blob) {
+    sqlite3* db = static_cast<sqlite3*>(db_handle_);
+    const char* sql = "INSERT OR REPLACE INTO access_profiles (hash, ranges) VALUES (?, ?);";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    sqlite3_bind_text(stmt, 1, hash_hex.data(), static_cast<int>(hash_hex.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 2, blob.data(), static_cast<int>(blob.size()), SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+
+void MetadataStore::markDirtyBlock(std::string_view hash_hex, std::size_t part_idx,std::size_t block_idx) {
+    auto& vec = bitmap_[std::string(hash_hex)][part_idx];
     if (vec.size() <= block_idx) vec.resize(block_idx + 1, false);
     vec[block_idx] = true;
 }
 
-bool MetadataStore::flushBitmaps(const std::string& hash_hex) {
+bool MetadataStore::flushBitmaps(std::string_view hash_hex) {
     bool ok = true;
-    auto it = bitmap_.find(hash_hex);
+    auto it = bitmap_.find(std::string(hash_hex));
     if (it == bitmap_.end()) return true;
 
     for (auto& [part_idx, bits] : it->second) {
-        ok &= persistBitmap(hash_hex, part_idx, bits);
+        ok &= persistBitmap(it->first, part_idx, bits);
     }
     return ok;
 }
@@ -218,13 +366,18 @@ bool MetadataStore::persistBitmap(const std::string& hash_hex, std::size_t part_
     if (bits.empty()) return true;
 
     std::string path = bitmap_path(cache_root_, hash_hex, part_idx);
-    fs::create_directories(fs::path(path).parent_path());
     std::vector<uint8_t> bytes((bits.size() + 7) / 8, 0);
     for (std::size_t i = 0; i < bits.size(); ++i) {
         if (bits[i]) bytes[i / 8] |= (1u << (i % 8));
     }
 
+    // The shard directory usually exists already; create it only if missing.
     int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 && errno == ENOENT) {
+        std::error_code ec;
+        fs::create_directories(fs::path(path).parent_path(), ec);
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
     if (fd < 0) return false;
 
     ssize_t n = ::write(fd, bytes.data(), bytes.size());
@@ -7,8 +7,10 @@
 #include <ctime>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
+#include <sys/types.h>
 
 struct CacheMetadata {
 std::string path;
@@ -19,6 +21,18 @@ std::time_t last_accessed = 0;
 bool        dirty = false;
 };
 
+// Per-object layout and access history, keyed by the path hash.
+struct ObjectRecord {
+std::string   hash;
+std::string   path;
+std::size_t   block_size = 0;
+std::size_t   size = 0;
+std::uint32_t seq_reads = 0;
+std::uint32_t rand_reads = 0;
+bool          packed = false;
+bool          inlined = false;
+};
+
 
 class MetadataStore {
 public:
@@ -36,9 +50,22 @@ bool remove(const std::string& path);
 std::vector<CacheMetadata> allEntries();
 void cleanup();
 
-void markDirtyBlock(const std::string& hash_hex, std::size_t part_idx, std::size_t block_idx);
+std::optional<ObjectRecord> getObject(std::string_view hash_hex);
+bool putObject(const ObjectRecord& rec);
+
+// Contents of tiny objects, kept in the database instead of block files.
+// getInline copies at most `len` bytes and returns the count, or -ENOENT.
+ssize_t getInline(std::string_view hash_hex, char* buf, std::size_t len);
+bool putInline(std::string_view hash_hex, const char* data, std::size_t len);
+bool eraseInline(std::string_view hash_hex);
+
+// Encoded access profile of an object (see AccessProfile), or nullopt.
+std::optional<std::string> getProfile(std::string_view hash_hex);
+bool putProfile(std::string_view hash_hex, std::string_view blob);
+
+void markDirtyBlock(std::string_view hash_hex, std::size_t part_idx, std::size_t block_idx);
 
-bool flushBitmaps(const std::string& hash_hex);
+bool flushBitmaps(std::string_view hash_hex);
 
 private:
 std::string db_path_;
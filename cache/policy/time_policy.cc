@@ -3,17 +3,17 @@
 TimePolicy::TimePolicy(long ttlSeconds)
     : ttlSeconds_(ttlSeconds) {}
 
-void TimePolicy::touch(size_t blockId) {
+void TimePolicy::touch(BlockKey blockId) {
     timestamps_[blockId] = Clock::now();
 }
 
-void TimePolicy::remove(size_t blockId) {
+void TimePolicy::remove(BlockKey blockId) {
     timestamps_.erase(blockId);
 }
 
-size_t TimePolicy::evict() {
+BlockKey TimePolicy::evict() {
     auto now = Clock::now();
-    size_t victim = SIZE_MAX;
+    BlockKey victim = kInvalidBlockKey;
     for (auto& [blockId, ts] : timestamps_) {
         auto age = std::chrono::duration_cast<std::chrono::seconds>(now - ts).count();
         if (age >= ttlSeconds_) {
@@ -21,7 +21,7 @@ size_t TimePolicy::evict() {
             break;
         }
     }
-    if (victim != SIZE_MAX) {
+    if (victim != kInvalidBlockKey) {
         timestamps_.erase(victim);
     }
     return victim;
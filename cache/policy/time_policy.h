@@ -1,9 +1,11 @@
 #ifndef TIME_POLICY_H
 #define TIME_POLICY_H
 
+#include "block_id.h"
+#include "flat_hash_map.h"
+
 #include <cstddef>
 #include <chrono>
-#include <unordered_map>
 
 class TimePolicy {
 public:
@@ -11,15 +13,15 @@ public:
 
     TimePolicy(long ttlSeconds);
 
-    void touch(size_t blockId);
+    void touch(BlockKey blockId);
 
-    void remove(size_t blockId);
+    void remove(BlockKey blockId);
 
-    size_t evict();
+    BlockKey evict();
 
 private:
     long ttlSeconds_;
-    std::unordered_map<size_t, Clock::time_point> timestamps_;
+    FlatHashMap<BlockKey, Clock::time_point> timestamps_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef CACHE_PREFETCH_CURSOR_H
+#define CACHE_PREFETCH_CURSOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Items requested ahead of a reader that moves `step` at a time: `ahead()`
+// of them from `next()` on. Readahead walks a file's blocks with it and
+// DirectoryScan a directory's files; each keeps its own idea of how far
+// ahead to stay and uses halve() to shrink that when the pattern breaks.
+class PrefetchCursor {
+public:
+    struct Stats {
+        std::uint64_t issued = 0;   // items requested ahead of the reader
+        std::uint64_t hits = 0;     // of those, items the reader then asked for
+        std::uint64_t wasted = 0;   // of those, items cancelled unread
+    };
+
+    static std::size_t halve(std::size_t size, std::size_t floor) { return std::max(size / 2, floor); }
+
+    std::size_t  next() const { return next_; }
+    std::size_t  ahead() const { return ahead_; }
+    const Stats& stats() const { return stats_; }
+
+    // The reader asked for `item`; true, a hit, if it is the next one
+    // outstanding.
+    bool consume(std::size_t item, std::int64_t step) {
+        if (!ahead_ || item != next_) return false;
+        ++stats_.hits;
+        next_ += step;
+        --ahead_;
+        return true;
+    }
+
+    // With nothing outstanding, the next request starts at `from`.
+    void restart(std::size_t from) {
+        if (!ahead_) next_ = from;
+    }
+
+    // The first item past those outstanding.
+    std::size_t frontier(std::int64_t step) const { return next_ + ahead_ * step; }
+
+    void issue(std::size_t n) {
+        ahead_        += n;
+        stats_.issued += n;
+    }
+
+    // Takes back `n` items just issued that could not be queued.
+    void retract(std::size_t n) {
+        ahead_        -= std::min(ahead_, n);
+        stats_.issued -= std::min<std::uint64_t>(stats_.issued, n);
+    }
+
+    // Counts what is outstanding as wasted and drops it; false if nothing was.
+    bool cancel() {
+        stats_.wasted += ahead_;
+        bool any = ahead_ != 0;
+        ahead_ = 0;
+        return any;
+    }
+
+    // Forgets what is outstanding without counting it.
+    void reset() {
+        next_  = 0;
+        ahead_ = 0;
+    }
+
+private:
+    std::size_t next_ = 0;
+    std::size_t ahead_ = 0;
+    Stats       stats_;
+};
+
+#endif
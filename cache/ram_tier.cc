@@ -0,0 +1,164 @@
+#include "ram_tier.h"
+
+struct RamTier::Shard {
+    alignas(64) std::mutex       mu;
+    FlatHashMap<BlockKey, Index> map;
+    SlabPool<Node, 1024>         nodes;
+    List                         probation;
+    List                         protect;
+    std::size_t                  capacity = 0;
+    std::uint64_t                hits = 0;
+    std::uint64_t                misses = 0;
+    std::uint64_t                evictions = 0;
+
+    List& list_of(const Node& n) { return n.hot ? protect : probation; }
+
+    void link_front(List& l, Index i) {
+        Node& n = nodes[i];
+        n.prev = kNil;
+        n.next = l.head;
+        if (l.head != kNil) nodes[l.head].prev = i;
+        l.head = i;
+        if (l.tail == kNil) l.tail = i;
+        l.bytes += n.block->buf.size();
+    }
+
+    void unlink(List& l, Index i) {
+        Node& n = nodes[i];
+        if (n.prev != kNil) nodes[n.prev].next = n.next; else l.head = n.next;
+        if (n.next != kNil) nodes[n.next].prev = n.prev; else l.tail = n.prev;
+        l.bytes -= n.block->buf.size();
+    }
+
+    void drop(Index i) {
+        unlink(list_of(nodes[i]), i);
+        map.erase(nodes[i].key);
+        nodes.free(i);
+    }
+
+    std::size_t bytes() const { return probation.bytes + protect.bytes; }
+
+    // Overflow from the protected segment goes back to probation.
+    void balance() {
+        std::size_t protect_cap = capacity - capacity / 5;
+        while (protect.bytes > protect_cap && protect.tail != kNil) {
+            Index i = protect.tail;
+            unlink(protect, i);
+            nodes[i].hot = false;
+            link_front(probation, i);
+        }
+    }
+
+    void evict(Index keep) {
+        while (bytes() > capacity) {
+            Index victim = probation.tail != kNil && probation.tail != keep ? probation.tail : protect.tail;
+            if (victim == kNil || victim == keep) break;
+            drop(victim);
+            ++evictions;
+        }
+    }
+};
+
+RamTier::RamTier(std::size_t capacity_bytes, std::size_t shards)
+: capacity_(capacity_bytes), shard_bits_(0) {
+    while ((std::size_t(1) << shard_bits_) < shards) ++shard_bits_;
+    nshards_ = std::size_t(1) << shard_bits_;
+    shards_.reset(new Shard[nshards_]);
+    for (std::size_t i = 0; i < nshards_; ++i) shards_[i].capacity = capacity_ / nshards_;
+}
+
+RamTier::~RamTier() = default;
+
+// The top hash bits pick the shard; the shard's map uses the low bits.
+RamTier::Shard& RamTier::shard_for(BlockKey key) {
+    if (shard_bits_ == 0) return shards_[0];
+    return shards_[FlatHash<BlockKey>{}(key) >> (64 - shard_bits_)];
+}
+
+RamTier::Handle RamTier::get(BlockKey key) {
+    Shard& s = shard_for(key);
+    std::lock_guard<std::mutex> g(s.mu);
+    auto it = s.map.find(key);
+    if (it == s.map.end()) {
+        ++s.misses;
+        return nullptr;
+    }
+    ++s.hits;
+    Index i = it->second;
+    Node& n = s.nodes[i];
+    s.unlink(s.list_of(n), i);
+    n.hot = true;
+    s.link_front(s.protect, i);
+    s.balance();
+    return n.block;
+}
+
+RamTier::Handle RamTier::find(BlockKey key) {
+    Shard& s = shard_for(key);
+    std::lock_guard<std::mutex> g(s.mu);
+    auto it = s.map.find(key);
+    return it != s.map.end() ? s.nodes[it->second].block : nullptr;
+}
+
+RamTier::Handle RamTier::put(BlockKey key, BlockBuffer buf, std::size_t len) {
+    auto block = std::make_shared<RamBlock>();
+    block->buf = std::move(buf);
+    block->len = len;
+    Handle h = std::move(block);
+
+    Shard& s = shard_for(key);
+    if (h->buf.size() > s.capacity) return h;
+
+    std::lock_guard<std::mutex> g(s.mu);
+    auto it = s.map.find(key);
+    Index i;
+    if (it != s.map.end()) {
+        i = it->second;
+        Node& n = s.nodes[i];
+        List& l = s.list_of(n);
+        s.unlink(l, i);
+        n.block = h;
+        s.link_front(l, i);
+    } else {
+        i = s.nodes.alloc(Node{key, kNil, kNil, false, h});
+        s.link_front(s.probation, i);
+        s.map.emplace(key, i);
+    }
+    s.evict(i);
+    return h;
+}
+
+void RamTier::erase(BlockKey key) {
+    Shard& s = shard_for(key);
+    std::lock_guard<std::mutex> g(s.mu);
+    auto it = s.map.find(key);
+    if (it != s.map.end()) s.drop(it->second);
+}
+
+void RamTier::erase_object(ObjectId id) {
+    for (std::size_t k = 0; k < nshards_; ++k) {
+        Shard& s = shards_[k];
+        std::lock_guard<std::mutex> g(s.mu);
+        for (List* l : {&s.probation, &s.protect}) {
+            for (Index i = l->head; i != kNil;) {
+                Index next = s.nodes[i].next;
+                if (key_object(s.nodes[i].key) == id) s.drop(i);
+                i = next;
+            }
+        }
+    }
+}
+
+RamTier::Stats RamTier::stats() const {
+    Stats st;
+    for (std::size_t k = 0; k < nshards_; ++k) {
+        Shard& s = shards_[k];
+        std::lock_guard<std::mutex> g(s.mu);
+        st.hits      += s.hits;
+        st.misses    += s.misses;
+        st.evictions += s.evictions;
+        st.bytes     += s.bytes();
+        st.blocks    += s.nodes.size();
+    }
+    return st;
+}
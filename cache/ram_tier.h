@@ -0,0 +1,91 @@
+#ifndef CACHE_RAM_TIER_H
+#define CACHE_RAM_TIER_H
+
+#include "block_id.h"
+#include "buffer_pool.h"
+#include "flat_hash_map.h"
+#include "slab_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Immutable block held in RAM. `len` is short for the last block of a file.
+struct RamBlock {
+    BlockBuffer buf;
+    std::size_t len = 0;
+
+    const char* data() const { return buf.data(); }
+};
+
+// In-memory block cache in front of the disk store. Blocks are handed out
+// as shared, read-only handles, so a hit copies no data under the lock and
+// an evicted or overwritten block stays valid for readers still holding it.
+//
+// Keys are spread over independently locked shards. Each shard is a
+// segmented LRU: new blocks enter a probation list and move to a protected
+// list (at most 80% of the shard) on their second hit, so a one-pass scan
+// cannot flush the frequently used set.
+class RamTier {
+public:
+    using Handle = std::shared_ptr<const RamBlock>;
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        std::size_t   bytes = 0;
+        std::size_t   blocks = 0;
+    };
+
+    explicit RamTier(std::size_t capacity_bytes, std::size_t shards = 16);
+    ~RamTier();
+
+    // nullptr on a miss.
+    Handle get(BlockKey key);
+
+    // Like get() but neither counted nor promoted; for writers updating a block.
+    Handle find(BlockKey key);
+
+    // Takes ownership of the buffer and returns a handle to it; replaces any
+    // block already cached under the key. Blocks larger than a shard's
+    // budget are returned uncached.
+    Handle put(BlockKey key, BlockBuffer buf, std::size_t len);
+
+    void erase(BlockKey key);
+    void erase_object(ObjectId id);
+
+    Stats stats() const;
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    using Index = SlabPool<int>::Index;
+    static constexpr Index kNil = SlabPool<int>::kNil;
+
+    struct Node {
+        BlockKey key;
+        Index    prev;
+        Index    next;
+        bool     hot;
+        Handle   block;
+    };
+    struct List {
+        Index       head = kNil;
+        Index       tail = kNil;
+        std::size_t bytes = 0;
+    };
+    struct Shard;
+
+    Shard& shard_for(BlockKey key);
+
+    std::size_t               capacity_;
+    std::size_t               shard_bits_;
+    std::unique_ptr<Shard[]>  shards_;
+    std::size_t               nshards_;
+
+    RamTier(const RamTier&)            = delete;
+    RamTier& operator=(const RamTier&) = delete;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "readahead.h"
+
+#include <algorithm>
+
+void Readahead::cancel() {
+    cursor_.cancel();
+    ++gen_;
+}
+
+void Readahead::retract(const Plan& p) { cursor_.retract(p.count); }
+
+Readahead::Plan Readahead::access(std::size_t blk, std::size_t end, std::size_t min_window,
+                                  std::size_t max_window) {
+    if (blk == last_) return {};
+    if (last_ == kNone) {
+        last_ = blk;
+        return {};
+    }
+    std::int64_t d = static_cast<std::int64_t>(blk - last_);
+    last_ = blk;
+    if (d != stride_ || d > kMaxStride || d < -kMaxStride) {
+        if (cursor_.cancel()) {
+            ++gen_;
+            window_ = PrefetchCursor::halve(window_, min_window);
+        }
+        stride_ = d;
+        run_    = 1;
+        return {};
+    }
+    ++run_;
+    cursor_.consume(blk, stride_);
+    if (cursor_.ahead() * 2 > window_) return {};
+
+    // First window once the pattern is confirmed, a doubled one after.
+    cursor_.restart(blk + stride_);
+    window_ = window_ && run_ > 2 ? std::min(window_ * 2, max_window) : std::max(window_, min_window);
+
+    Plan p;
+    p.first  = cursor_.frontier(stride_);
+    p.stride = stride_;
+    p.count  = window_ - cursor_.ahead();
+    // Stay within the file: past its end going forward, before 0 going back.
+    if (stride_ > 0 && end) {
+        if (p.first >= end) return {};
+        p.count = std::min<std::size_t>(p.count, (end - 1 - p.first) / stride_ + 1);
+    } else if (stride_ < 0) {
+        if (static_cast<std::int64_t>(p.first) < 0) return {};
+        p.count = std::min<std::size_t>(p.count, p.first / static_cast<std::size_t>(-stride_) + 1);
+    }
+    cursor_.issue(p.count);
+    return p;
+}
@@ -0,0 +1,58 @@
+#ifndef CACHE_READAHEAD_H
+#define CACHE_READAHEAD_H
+
+#include "prefetch_cursor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Readahead state of one file, fed its demand block accesses in order. A
+// pattern is a constant stride between accesses (1 for sequential, -1 for
+// backward, or a fixed skip) seen twice in a row. While it holds, the next
+// `window` blocks along it are kept requested, and like Linux readahead the
+// window doubles each time the reader consumes half of what is outstanding.
+// An access off the pattern cancels the outstanding blocks, counting them
+// as wasted, and halves the window.
+class Readahead {
+public:
+    static constexpr std::int64_t kMaxStride = 64;
+
+    // Blocks first, first + stride, ... (count of them) to prefetch.
+    struct Plan {
+        std::size_t  first = 0;
+        std::int64_t stride = 0;
+        std::size_t  count = 0;
+    };
+
+    using Stats = PrefetchCursor::Stats;
+
+    // `end` is the file's block count (0 if unknown); `min_window` and
+    // `max_window` bound the window in blocks.
+    Plan access(std::size_t blk, std::size_t end, std::size_t min_window, std::size_t max_window);
+
+    // Drops whatever is outstanding; in-flight prefetches of an older
+    // generation stop.
+    void cancel();
+
+    // Takes back the plan just returned by access(), when it could not be
+    // queued; the next access asks for those blocks again.
+    void retract(const Plan& p);
+
+    std::uint32_t gen() const { return gen_; }
+    std::size_t   window() const { return window_; }
+    std::int64_t  stride() const { return run_ >= 2 ? stride_ : 0; }
+    const Stats&  stats() const { return cursor_.stats(); }
+
+private:
+    static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+    std::size_t   last_ = kNone;
+    std::int64_t  stride_ = 0;
+    std::uint32_t run_ = 0;       // consecutive accesses at stride_
+    std::uint32_t gen_ = 0;
+    std::size_t   window_ = 0;
+    PrefetchCursor cursor_;
+};
+
+#endif
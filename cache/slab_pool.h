@@ -0,0 +1,85 @@
+#ifndef CACHE_SLAB_POOL_H
+#define CACHE_SLAB_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed-size object pool addressed by 32-bit index. Objects live in slabs of
+// SlabSize contiguous elements that are never moved or returned to the heap,
+// so indexes and references stay valid and alloc()/free() after warm-up
+// perform no heap allocation. Not thread-safe.
+template <class T, std::size_t SlabSize = 4096>
+class SlabPool {
+public:
+    using Index = std::uint32_t;
+    static constexpr Index kNil = UINT32_MAX;
+
+    SlabPool() = default;
+    ~SlabPool() {
+        for (Index i = 0; i < next_; ++i) {
+            if (live(i)) (*this)[i].~T();
+        }
+    }
+
+    template <class... Args>
+    Index alloc(Args&&... args) {
+        Index i;
+        if (!free_.empty()) {
+            i = free_.back();
+            free_.pop_back();
+        } else {
+            if (next_ == kNil) throw std::bad_alloc();
+            if (next_ % SlabSize == 0) {
+                slabs_.emplace_back(static_cast<Storage*>(::operator new(sizeof(Storage) * SlabSize)));
+                live_.resize((next_ + SlabSize + 63) / 64, 0);
+            }
+            i = next_++;
+        }
+        new (&slot(i)) T(std::forward<Args>(args)...);
+        live_[i / 64] |= (1ULL << (i % 64));
+        ++size_;
+        return i;
+    }
+
+    void free(Index i) {
+        (*this)[i].~T();
+        live_[i / 64] &= ~(1ULL << (i % 64));
+        free_.push_back(i);
+        --size_;
+    }
+
+    void reserve(std::size_t n) { slabs_.reserve((n + SlabSize - 1) / SlabSize); }
+
+    T&       operator[](Index i)       { return *std::launder(reinterpret_cast<T*>(&slot(i))); }
+    const T& operator[](Index i) const { return *std::launder(reinterpret_cast<const T*>(&slot(i))); }
+
+    bool        live(Index i) const { return i < next_ && (live_[i / 64] >> (i % 64)) & 1; }
+    std::size_t size() const { return size_; }
+
+    std::size_t memory_bytes() const {
+        return slabs_.size() * SlabSize * sizeof(T) + free_.capacity() * sizeof(Index) +
+               live_.capacity() * sizeof(std::uint64_t) + slabs_.capacity() * sizeof(void*);
+    }
+
+private:
+    struct Storage { alignas(T) unsigned char b[sizeof(T)]; };
+    struct SlabFree { void operator()(Storage* p) const { ::operator delete(p); } };
+
+    Storage&       slot(Index i)       { return slabs_[i / SlabSize].get()[i % SlabSize]; }
+    const Storage& slot(Index i) const { return slabs_[i / SlabSize].get()[i % SlabSize]; }
+
+    std::vector<std::unique_ptr<Storage, SlabFree>> slabs_;
+    std::vector<Index>                              free_;
+    std::vector<std::uint64_t>                      live_;
+    Index                                           next_ = 0;
+    std::size_t                                     size_ = 0;
+
+    SlabPool(const SlabPool&)            = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+};
+
+#endif
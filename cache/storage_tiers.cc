@@ -0,0 +1,350 @@
+#include "storage_tiers.h"
+#include "buffer_pool.h"
+#include "object_table.h"
+
+#include <algorithm>
+#include <cerrno>
+
+StorageTiers::StorageTiers(std::vector<TierConfig> tiers, std::size_t block_size,
+                           std::size_t migrate_rate, unsigned promote_hits)
+: block_size_(block_size), migrate_rate_(migrate_rate),
+  promote_hits_(std::min(std::max(promote_hits, 1u), 255u)) {
+    for (auto& cfg : tiers) {
+        Tier t;
+        t.store    = std::make_unique<BlockStore>(std::move(cfg.roots), block_size_);
+        t.capacity = cfg.capacity;
+        tiers_.push_back(std::move(t));
+    }
+}
+
+StorageTiers::~StorageTiers() {
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (migrator_.joinable()) migrator_.join();
+}
+
+bool StorageTiers::init(Resolver resolve) {
+    bool ok = true;
+    for (auto& t : tiers_) ok &= t.store->init();
+    resolve_ = std::move(resolve);
+    if (tiers_.size() > 1) {
+        next_slot_ = std::chrono::steady_clock::now();
+        migrator_  = std::thread(&StorageTiers::migrate_loop, this);
+    }
+    return ok;
+}
+
+StorageTiers::Node* StorageTiers::locate(BlockKey key) {
+    auto it = map_.find(key);
+    return it != map_.end() ? &nodes_[it->second] : nullptr;
+}
+
+// Admission may run a tier up to 1/8 (and at least one block) over budget
+// while the migrator trims it; past that, new blocks spill to the next tier.
+int StorageTiers::pick_tier() const {
+    for (std::size_t t = 0; t + 1 < tiers_.size(); ++t) {
+        const Tier& tier = tiers_[t];
+        if (!tier.capacity || tier.used < tier.capacity + tier.capacity / 8) return static_cast<int>(t);
+    }
+    return static_cast<int>(tiers_.size() - 1);
+}
+
+void StorageTiers::link_front(Index i) {
+    Node& n = nodes_[i];
+    Tier& t = tiers_[n.tier];
+    n.prev = kNil;
+    n.next = t.head;
+    if (t.head != kNil) nodes_[t.head].prev = i;
+    t.head = i;
+    if (t.tail == kNil) t.tail = i;
+}
+
+void StorageTiers::unlink(Index i) {
+    Node& n = nodes_[i];
+    Tier& t = tiers_[n.tier];
+    if (n.prev != kNil) nodes_[n.prev].next = n.next; else t.head = n.next;
+    if (n.next != kNil) nodes_[n.next].prev = n.prev; else t.tail = n.prev;
+}
+
+void StorageTiers::forget(Index i) {
+    unlink(i);
+    tiers_[nodes_[i].tier].used -= nodes_[i].bytes;
+    map_.erase(nodes_[i].key);
+    nodes_.free(i);
+}
+
+ssize_t StorageTiers::read(BlockKey key, std::string_view name, char* buf, std::size_t len, off_t off) {
+    if (tiers_.size() == 1 || key == kInvalidBlockKey) return tiers_[0].store->read(name, buf, len, off);
+
+    for (;;) {
+        int tier;
+        std::uint32_t gen;
+        {
+            std::lock_guard<std::mutex> g(mu_);
+            Node* n = locate(key);
+            if (!n) break;
+            tier = n->tier;
+            gen  = n->gen;
+        }
+        ssize_t got = tiers_[tier].store->read(name, buf, len, off);
+
+        std::lock_guard<std::mutex> g(mu_);
+        auto it = map_.find(key);
+        if (it == map_.end()) break;
+        Index i = it->second;
+        Node& n = nodes_[i];
+        if (n.tier != tier || n.gen != gen) continue;
+        unlink(i);
+        link_front(i);
+        if (tier > 0 && !n.queued && ++n.hits >= promote_hits_) {
+            n.queued = true;
+            n.hits   = 0;
+            moves_.push_back(Move{key, tier, tier - 1});
+            cv_.notify_one();
+        }
+        return got;
+    }
+
+    // Not located: probe fastest first, skipping blocks punched out by a move.
+    for (std::size_t t = 0; t < tiers_.size(); ++t) {
+        if (!tiers_[t].store->holds(name, off)) continue;
+        ssize_t got = tiers_[t].store->read(name, buf, len, off);
+        if (got <= 0) continue;
+        std::lock_guard<std::mutex> g(mu_);
+        if (!locate(key)) {
+            Index i = nodes_.alloc(Node{key, kNil, kNil, 0, static_cast<std::uint32_t>(got),
+                                        static_cast<std::uint8_t>(t), 0, false});
+            map_.emplace(key, i);
+            link_front(i);
+            tiers_[t].used += got;
+            if (over_budget(t)) cv_.notify_one();
+        }
+        return got;
+    }
+    return -ENOENT;
+}
+
+// The write is retried if a move or drop of the block committed while it
+// was in flight, since the bytes may have landed in the old location.
+ssize_t StorageTiers::write(BlockKey key, std::string_view name, const char* buf, std::size_t len, off_t off) {
+    if (tiers_.size() == 1 || key == kInvalidBlockKey) return tiers_[0].store->write(name, buf, len, off, false);
+
+    for (;;) {
+        int tier;
+        std::uint32_t gen = 0;
+        bool existed;
+        {
+            std::lock_guard<std::mutex> g(mu_);
+            Node* n = locate(key);
+            existed = n != nullptr;
+            if (n) {
+                gen  = ++n->gen;
+                tier = n->tier;
+            } else {
+                tier = pick_tier();
+            }
+        }
+        ssize_t wrote = tiers_[tier].store->write(name, buf, len, off, false);
+        if (wrote <= 0) return wrote;
+
+        std::lock_guard<std::mutex> g(mu_);
+        auto it = map_.find(key);
+        Index i;
+        if (it == map_.end()) {
+            if (existed) continue;
+            i = nodes_.alloc(Node{key, kNil, kNil, 0, 0, static_cast<std::uint8_t>(tier), 0, false});
+            map_.emplace(key, i);
+        } else {
+            i = it->second;
+            if (nodes_[i].tier != tier || (existed && nodes_[i].gen != gen)) continue;
+            unlink(i);
+            tiers_[tier].used -= nodes_[i].bytes;
+        }
+        Node& n = nodes_[i];
+        n.bytes = static_cast<std::uint32_t>(len);
+        ++n.gen;
+        tiers_[tier].used += len;
+        link_front(i);
+        if (over_budget(tier)) cv_.notify_one();
+        return wrote;
+    }
+}
+
+bool StorageTiers::delete_object(ObjectId id, std::string_view hash_hex) {
+    if (tiers_.size() > 1) {
+        std::lock_guard<std::mutex> g(mu_);
+        for (auto it = map_.begin(); it != map_.end();) {
+            if (key_object(it->first) != id) {
+                ++it;
+                continue;
+            }
+            Index i = it->second;
+            unlink(i);
+            tiers_[nodes_[i].tier].used -= nodes_[i].bytes;
+            nodes_.free(i);
+            it = map_.erase(it);
+        }
+    }
+    bool ok = true;
+    for (auto& t : tiers_) ok &= t.store->delete_object(hash_hex);
+    return ok;
+}
+
+bool StorageTiers::reserve(std::string_view name, std::size_t size) {
+    int tier = 0;
+    if (tiers_.size() > 1) {
+        std::lock_guard<std::mutex> g(mu_);
+        tier = pick_tier();
+    }
+    return tiers_[tier].store->reserve(name, size);
+}
+
+void StorageTiers::start_defragmenter(std::chrono::seconds interval) {
+    for (auto& t : tiers_) t.store->start_defragmenter(interval);
+}
+
+int StorageTiers::tier_of(BlockKey key) {
+    std::lock_guard<std::mutex> g(mu_);
+    Node* n = locate(key);
+    return n ? n->tier : -1;
+}
+
+std::size_t StorageTiers::used(std::size_t tier) {
+    std::lock_guard<std::mutex> g(mu_);
+    return tier < tiers_.size() ? tiers_[tier].used : 0;
+}
+
+StorageTiers::Stats StorageTiers::stats() {
+    std::lock_guard<std::mutex> g(mu_);
+    return stats_;
+}
+
+bool StorageTiers::over_budget(std::size_t t) const {
+    const Tier& tier = tiers_[t];
+    return tier.capacity && tier.used > tier.capacity && tier.tail != kNil;
+}
+
+void StorageTiers::drain() {
+    std::unique_lock<std::mutex> lk(mu_);
+    idle_cv_.wait(lk, [&] {
+        if (stop_ || !migrator_.joinable()) return true;
+        if (busy_ || !moves_.empty()) return false;
+        for (std::size_t t = 0; t < tiers_.size(); ++t)
+            if (over_budget(t)) return false;
+        return true;
+    });
+}
+
+// Queues the coldest block of the first tier over budget. Called with mu_ held.
+bool StorageTiers::plan_demotion() {
+    for (std::size_t t = 0; t < tiers_.size(); ++t) {
+        if (!over_budget(t)) continue;
+        for (Index i = tiers_[t].tail; i != kNil; i = nodes_[i].prev) {
+            Node& n = nodes_[i];
+            if (n.queued) continue;
+            n.queued = true;
+            int to = t + 1 < tiers_.size() ? static_cast<int>(t + 1) : -1;
+            moves_.push_back(Move{n.key, static_cast<int>(t), to});
+            return true;
+        }
+    }
+    return false;
+}
+
+void StorageTiers::migrate_loop() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait(lk, [&] { return stop_ || !moves_.empty() || plan_demotion(); });
+        if (stop_) break;
+        Move m = moves_.front();
+        moves_.pop_front();
+        busy_ = true;
+        lk.unlock();
+        run(m);
+        lk.lock();
+        busy_ = false;
+        idle_cv_.notify_all();
+    }
+    idle_cv_.notify_all();
+}
+
+// Copies the block, then switches its location only if no write or other
+// move touched it meanwhile; the source copy is punched out afterwards.
+void StorageTiers::run(const Move& m) {
+    char name_buf[kObjectNameMax];
+    std::size_t name_len = 0, bs = 0;
+    bool known = resolve_ && resolve_(key_object(m.key), name_buf, name_len, bs);
+
+    std::uint32_t gen, bytes;
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        auto it = map_.find(m.key);
+        if (it == map_.end()) return;
+        Node& n = nodes_[it->second];
+        if (!known) {
+            forget(it->second);
+            return;
+        }
+        if (n.tier != m.from) {
+            n.queued = false;
+            return;
+        }
+        gen   = n.gen;
+        bytes = n.bytes;
+    }
+
+    std::string_view name(name_buf, name_len);
+    off_t off = static_cast<off_t>(key_block(m.key)) * bs;
+    BlockStore& src = *tiers_[m.from].store;
+
+    bool copied = false;
+    if (m.to >= 0) {
+        throttle(bytes);
+        BlockBuffer buf = BufferPool::instance().acquire(bytes);
+        copied = src.read(name, buf.data(), bytes, off) == static_cast<ssize_t>(bytes) &&
+                 tiers_[m.to].store->write(name, buf.data(), bytes, off, false) == static_cast<ssize_t>(bytes);
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mu_);
+        auto it = map_.find(m.key);
+        Node* n = it != map_.end() ? &nodes_[it->second] : nullptr;
+        bool valid = n && n->gen == gen && n->tier == m.from && (m.to < 0 || copied);
+        if (!valid) {
+            if (n) n->queued = false;
+            if (copied) tiers_[m.to].store->punch(name, off, bytes);
+            return;
+        }
+        if (m.to < 0) {
+            forget(it->second);
+            ++stats_.drops;
+        } else {
+            unlink(it->second);
+            tiers_[m.from].used -= bytes;
+            n->tier   = static_cast<std::uint8_t>(m.to);
+            n->queued = false;
+            n->hits   = 0;
+            ++n->gen;
+            tiers_[m.to].used += bytes;
+            link_front(it->second);
+            if (m.to < m.from) ++stats_.promotions;
+            else ++stats_.demotions;
+        }
+    }
+    src.punch(name, off, bytes);
+}
+
+// Paces copies to migrate_rate_ bytes/s, allowing up to one second of burst
+// after an idle period.
+void StorageTiers::throttle(std::size_t bytes) {
+    if (!migrate_rate_) return;
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lk(mu_);
+    auto now = clock::now();
+    if (next_slot_ < now - std::chrono::seconds(1)) next_slot_ = now - std::chrono::seconds(1);
+    next_slot_ += std::chrono::nanoseconds(static_cast<std::uint64_t>(bytes) * 1'000'000'000ull / migrate_rate_);
+    cv_.wait_until(lk, next_slot_, [&] { return stop_; });
+}
@@ -0,0 +1,146 @@
+#ifndef CACHE_STORAGE_TIERS_H
+#define CACHE_STORAGE_TIERS_H
+
+#include "block_id.h"
+#include "block_store.h"
+#include "flat_hash_map.h"
+#include "slab_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct TierConfig {
+    TierConfig(std::string root, std::size_t cap) : roots{StoreRoot{std::move(root), 0}}, capacity(cap) {}
+    TierConfig(std::vector<StoreRoot> devices, std::size_t cap) : roots(std::move(devices)), capacity(cap) {}
+
+    std::vector<StoreRoot> roots;   // striped across when more than one
+    std::size_t capacity = 0;       // bytes; 0 = unbounded
+};
+
+// Ordered disk tiers, fastest first, each a BlockStore with its own byte
+// budget. New blocks go to the fastest tier with room. A background thread
+// demotes the least recently used blocks of a tier over budget to the next
+// tier (the last tier drops them) and promotes blocks read `promote_hits`
+// times from a slower tier one step up, copying at most `migrate_rate`
+// bytes per second.
+//
+// Every located block carries a generation that writes and moves bump, so
+// a read or a move that raced with either is retried or abandoned. With a
+// single tier there is nothing to migrate and blocks go straight to the
+// store untracked.
+class StorageTiers {
+public:
+    // Fills in the object name and block size for a block being migrated;
+    // false if the object is gone.
+    using Resolver = std::function<bool(ObjectId, char* name, std::size_t& name_len, std::size_t& block_size)>;
+
+    struct Stats {
+        std::uint64_t promotions = 0;
+        std::uint64_t demotions = 0;
+        std::uint64_t drops = 0;
+    };
+
+    StorageTiers(std::vector<TierConfig> tiers, std::size_t block_size,
+                 std::size_t migrate_rate, unsigned promote_hits);
+    ~StorageTiers();
+
+    bool init(Resolver resolve);
+
+    std::size_t count() const { return tiers_.size(); }
+
+    // Reads a block from whichever tier holds it. Blocks not yet located
+    // (e.g. after a restart) are probed fastest tier first.
+    ssize_t read(BlockKey key, std::string_view name, char* buf, std::size_t len, off_t off);
+
+    // Writes a block in place, or to the fastest tier with room if new.
+    ssize_t write(BlockKey key, std::string_view name, const char* buf, std::size_t len, off_t off);
+
+    bool delete_object(ObjectId id, std::string_view hash_hex);
+
+    // Preallocates an object of `size` bytes in the tier new blocks go to.
+    bool reserve(std::string_view name, std::size_t size);
+
+    // Starts each tier's background defragmenter.
+    void start_defragmenter(std::chrono::seconds interval);
+
+    // Tier holding the block, or -1 if not located.
+    int tier_of(BlockKey key);
+    std::size_t used(std::size_t tier);
+
+    // Blocks until queued and pending migrations are done.
+    void drain();
+
+    Stats stats();
+
+private:
+    using Index = SlabPool<int>::Index;
+    static constexpr Index kNil = SlabPool<int>::kNil;
+
+    struct Tier {
+        std::unique_ptr<BlockStore> store;
+        std::size_t capacity = 0;
+        std::size_t used = 0;
+        Index       head = kNil;
+        Index       tail = kNil;
+    };
+    struct Node {
+        BlockKey      key;
+        Index         prev;
+        Index         next;
+        std::uint32_t gen;
+        std::uint32_t bytes;
+        std::uint8_t  tier;
+        std::uint8_t  hits;
+        bool          queued;
+    };
+    struct Move {
+        BlockKey key;
+        int      from;
+        int      to;        // -1 drops the block
+    };
+
+    Node* locate(BlockKey key);
+    int   pick_tier() const;
+    void  link_front(Index i);
+    void  unlink(Index i);
+    void  forget(Index i);
+    bool  over_budget(std::size_t t) const;
+    bool  plan_demotion();
+    void  run(const Move& m);
+    void  throttle(std::size_t bytes);
+    void  migrate_loop();
+
+    std::vector<Tier>            tiers_;
+    std::size_t                  block_size_;
+    std::size_t                  migrate_rate_;
+    unsigned                     promote_hits_;
+    Resolver                     resolve_;
+
+    std::mutex                   mu_;
+    std::condition_variable      cv_;
+    std::condition_variable      idle_cv_;
+    SlabPool<Node>               nodes_;
+    FlatHashMap<BlockKey, Index> map_;
+    std::deque<Move>             moves_;
+    bool                         busy_ = false;
+    bool                         stop_ = false;
+    Stats                        stats_;
+    std::chrono::steady_clock::time_point next_slot_;
+    std::thread                  migrator_;
+
+    StorageTiers(const StorageTiers&)            = delete;
+    StorageTiers& operator=(const StorageTiers&) = delete;
+};
+
+#endif
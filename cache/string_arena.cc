@@ -0,0 +1,26 @@
+#include "string_arena.h"
+
+#include <cstring>
+
+StringArena::StringArena(std::size_t chunk_size) : chunk_size_(chunk_size) {}
+
+std::string_view StringArena::intern(std::string_view s) {
+    if (s.empty()) return {};
+    if (s.size() > left_) {
+        std::size_t n = s.size() > chunk_size_ / 4 ? s.size() : chunk_size_;
+        chunks_.emplace_back(new char[n]);
+        bytes_ += n;
+        // Oversized strings get a private chunk; keep filling the current one.
+        if (n != chunk_size_) {
+            std::memcpy(chunks_.back().get(), s.data(), s.size());
+            return {chunks_.back().get(), s.size()};
+        }
+        cur_  = chunks_.back().get();
+        left_ = n;
+    }
+    char* p = cur_;
+    std::memcpy(p, s.data(), s.size());
+    cur_  += s.size();
+    left_ -= s.size();
+    return {p, s.size()};
+}
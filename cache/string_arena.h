@@ -0,0 +1,30 @@
+#ifndef CACHE_STRING_ARENA_H
+#define CACHE_STRING_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only string storage. Interned views stay valid for the lifetime of
+// the arena; nothing is freed individually. Not thread-safe.
+class StringArena {
+public:
+    explicit StringArena(std::size_t chunk_size = 64 * 1024);
+
+    std::string_view intern(std::string_view s);
+
+    std::size_t memory_bytes() const { return bytes_; }
+
+private:
+    std::size_t                          chunk_size_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char*                                cur_  = nullptr;
+    std::size_t                          left_ = 0;
+    std::size_t                          bytes_ = 0;
+
+    StringArena(const StringArena&)            = delete;
+    StringArena& operator=(const StringArena&) = delete;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef CACHE_TASK_H
+#define CACHE_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only `void()` callable. Callables up to kInlineSize bytes that move
+// without throwing are stored in place, so posting one does not allocate;
+// larger ones go on the heap. Unlike std::function it accepts move-only
+// callables such as std::packaged_task.
+class Task {
+public:
+    static constexpr std::size_t kInlineSize = 48;
+
+    Task() = default;
+
+    template <class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+    Task(F&& f);
+
+    Task(Task&& other) noexcept;
+    Task& operator=(Task&& other) noexcept;
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    void operator()() { ops_->invoke(buf_); }
+
+    void reset();
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);   // leaves src destroyed
+        void (*destroy)(void*);
+    };
+
+    template <class F>
+    struct InlineOps;
+    template <class F>
+    struct HeapOps;
+
+    alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+    const Ops* ops_ = nullptr;
+};
+
+#include "task.inl"
+
+#endif
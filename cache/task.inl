@@ -0,0 +1,54 @@
+#pragma once
+
+template <class F>
+struct Task::InlineOps {
+    static void invoke(void* p) { (*static_cast<F*>(p))(); }
+    static void move(void* dst, void* src) {
+        ::new (dst) F(std::move(*static_cast<F*>(src)));
+        static_cast<F*>(src)->~F();
+    }
+    static void destroy(void* p) { static_cast<F*>(p)->~F(); }
+    static constexpr Ops ops{invoke, move, destroy};
+};
+
+template <class F>
+struct Task::HeapOps {
+    static F*& ptr(void* p) { return *static_cast<F**>(p); }
+    static void invoke(void* p) { (*ptr(p))(); }
+    static void move(void* dst, void* src) { ::new (dst) F*(ptr(src)); }
+    static void destroy(void* p) { delete ptr(p); }
+    static constexpr Ops ops{invoke, move, destroy};
+};
+
+template <class F, class>
+Task::Task(F&& f) {
+    using Fn = std::decay_t<F>;
+    if constexpr (sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+                  std::is_nothrow_move_constructible_v<Fn>) {
+        ::new (buf_) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::ops;
+    } else {
+        ::new (buf_) Fn*(new Fn(std::forward<F>(f)));
+        ops_ = &HeapOps<Fn>::ops;
+    }
+}
+
+inline Task::Task(Task&& other) noexcept : ops_(other.ops_) {
+    if (ops_) ops_->move(buf_, other.buf_);
+    other.ops_ = nullptr;
+}
+
+inline Task& Task::operator=(Task&& other) noexcept {
+    if (this != &other) {
+        reset();
+        ops_ = other.ops_;
+        if (ops_) ops_->move(buf_, other.buf_);
+        other.ops_ = nullptr;
+    }
+    return *this;
+}
+
+inline void Task::reset() {
+    if (ops_) ops_->destroy(buf_);
+    ops_ = nullptr;
+}
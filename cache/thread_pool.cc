@@ -1,10 +1,17 @@
 #include "thread_pool.h"
 
-ThreadPool::ThreadPool(std::size_t numThreads) {
+namespace {
+
+// The pool and index of the worker running on this thread, if any.
+thread_local const ThreadPool* tls_pool = nullptr;
+thread_local std::size_t       tls_index = 0;
+
+}
+
+ThreadPool::ThreadPool(std::size_t numThreads, std::size_t max_queue) : max_queue_(max_queue) {
     if (numThreads == 0) numThreads = 1;
-    for (std::size_t i = 0; i < numThreads; ++i) {
-        workers_.emplace_back(&ThreadPool::worker_loop, this);
-    }
+    for (std::size_t i = 0; i < numThreads; ++i) workers_.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < numThreads; ++i) workers_[i]->thread = std::thread(&ThreadPool::worker_loop, this, i);
 }
 
 ThreadPool::~ThreadPool() {
@@ -13,19 +20,90 @@ ThreadPool::~ThreadPool() {
         stop_ = true;
     }
     cv_.notify_all();
-    for (auto& th : workers_) th.join();
-}
-
-void ThreadPool::worker_loop() {
-    while (true) {
-        std::function<void()> job;
-        {
-            std::unique_lock<std::mutex> lock(mu_);
-            cv_.wait(lock, [&] { return stop_ || !tasks_.empty(); });
-            if (stop_ && tasks_.empty()) return;
-            job = std::move(tasks_.front());
-            tasks_.pop();
+    for (auto& w : workers_) w->thread.join();
+}
+
+bool ThreadPool::admit(std::size_t cls, bool wait) {
+    if (!max_queue_ || cls == static_cast<std::size_t>(IoPriority::kDemand)) {
+        queued_[cls].fetch_add(1);
+        return true;
+    }
+    for (;;) {
+        std::size_t n = queued_[cls].load();
+        while (n < max_queue_) {
+            if (queued_[cls].compare_exchange_weak(n, n + 1)) return true;
+        }
+        if (!wait) return false;
+        std::unique_lock<std::mutex> lock(mu_);
+        ++room_waiters_;
+        room_cv_.wait(lock, [&] { return queued_[cls].load() < max_queue_; });
+        --room_waiters_;
+    }
+}
+
+bool ThreadPool::submit(Task task, IoPriority prio, bool wait) {
+    const std::size_t cls = static_cast<std::size_t>(prio);
+    if (!admit(cls, wait)) return false;
+    ++total_;
+    if (tls_pool != this || !workers_[tls_index]->deques[cls].push(task)) {
+        std::lock_guard<std::mutex> lock(mu_);
+        shared_[cls].push_back(std::move(task));
+        ++shared_size_[cls];
+    }
+    if (sleepers_.load()) {
+        { std::lock_guard<std::mutex> lock(mu_); }
+        cv_.notify_one();
+    }
+    return true;
+}
+
+bool ThreadPool::take(std::size_t self, Task& out) {
+    const std::size_t n = workers_.size();
+    for (std::size_t cls = 0; cls < kIoPriorities; ++cls) {
+        bool got = workers_[self]->deques[cls].pop(out);
+        if (!got && shared_size_[cls].load()) {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (!shared_[cls].empty()) {
+                out = std::move(shared_[cls].front());
+                shared_[cls].pop_front();
+                --shared_size_[cls];
+                got = true;
+            }
         }
-        job();
+        for (std::size_t i = 1; !got && i < n; ++i) got = workers_[(self + i) % n]->deques[cls].steal(out);
+        if (!got) continue;
+        --total_;
+        --queued_[cls];
+        if (room_waiters_.load()) {
+            { std::lock_guard<std::mutex> lock(mu_); }
+            room_cv_.notify_all();
+        }
+        return true;
     }
+    return false;
+}
+
+void ThreadPool::worker_loop(std::size_t self) {
+    tls_pool  = this;
+    tls_index = self;
+    for (;;) {
+        Task job;
+        if (take(self, job)) {
+            job();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mu_);
+        ++sleepers_;
+        cv_.wait(lock, [&] { return stop_ || total_.load(); });
+        --sleepers_;
+        if (stop_ && !total_.load()) return;
+    }
+}
+
+std::size_t ThreadPool::pending() {
+    return total_.load();
+}
+
+std::size_t ThreadPool::pending(IoPriority prio) {
+    return queued_[static_cast<std::size_t>(prio)].load();
 }
@@ -1,31 +1,75 @@
 #ifndef CACHE_THREAD_POOL_H
 #define CACHE_THREAD_POOL_H
 
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
-#include <functional>
+#include <deque>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <vector>
 
+#include "io_priority.h"
+#include "task.h"
+#include "work_deque.h"
+
+// Work-stealing pool with a queue per priority class. Tasks posted from a
+// worker go on that worker's own deque, others on a shared queue; a free
+// worker takes the most urgent class first, from its own deque, then the
+// shared queue, then by stealing from another worker. Long background
+// tasks should be split into short ones to let urgent work in between.
+// With max_queue set, at most that many tasks of each class but demand wait
+// to run: post and enqueue block until one is taken and try_post refuses
+// the task. Demand tasks are never held back, since a reader waits on them.
 class ThreadPool {
 public:
-    explicit ThreadPool(std::size_t numThreads = std::thread::hardware_concurrency());
+    explicit ThreadPool(std::size_t numThreads = std::thread::hardware_concurrency(), std::size_t max_queue = 0);
     ~ThreadPool();
 
     template <class F>
-    std::future<void> enqueue(F&& task);
+    std::future<void> enqueue(F&& task, IoPriority prio = IoPriority::kDemand);
+
+    // Fire and forget: no future, and no allocation for small callables.
+    template <class F>
+    void post(F&& task, IoPriority prio = IoPriority::kDemand) { submit(Task(std::forward<F>(task)), prio, true); }
+
+    // False, without running the task, if the class's queue is full.
+    template <class F>
+    bool try_post(F&& task, IoPriority prio = IoPriority::kDemand) {
+        return submit(Task(std::forward<F>(task)), prio, false);
+    }
+
+    std::size_t pending();
+    std::size_t pending(IoPriority prio);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
 
 private:
-    void worker_loop();
+    struct Worker {
+        WorkDeque   deques[kIoPriorities];
+        std::thread thread;
+    };
+
+    bool submit(Task task, IoPriority prio, bool wait);
+    bool admit(std::size_t cls, bool wait);
+    bool take(std::size_t self, Task& out);
+    void worker_loop(std::size_t self);
 
-    std::vector<std::thread>               workers_;
-    std::queue<std::function<void()>>      tasks_;
-    std::mutex                             mu_;
-    std::condition_variable                cv_;
-    bool                                   stop_ = false;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::deque<Task>                     shared_[kIoPriorities];   // guarded by mu_
+    std::atomic<std::size_t>             shared_size_[kIoPriorities] = {};
+    std::atomic<std::size_t>             queued_[kIoPriorities] = {};
+    std::atomic<std::size_t>             total_{0};
+    std::atomic<std::size_t>             sleepers_{0};
+    std::atomic<std::size_t>             room_waiters_{0};
+    std::size_t                          max_queue_;
+    std::mutex                           mu_;
+    std::condition_variable              cv_;
+    std::condition_variable              room_cv_;
+    bool                                 stop_ = false;
 };
 
 #include "thread_pool.inl"
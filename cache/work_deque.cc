@@ -0,0 +1,45 @@
+#include "work_deque.h"
+
+static_assert((WorkDeque::kCapacity & (WorkDeque::kCapacity - 1)) == 0, "capacity must be a power of two");
+
+Task WorkDeque::take(Slot& s) {
+    Task t = std::move(s.task);
+    s.full.store(false, std::memory_order_release);
+    return t;
+}
+
+bool WorkDeque::push(Task& task) {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    Slot& s = slots_[b & (kCapacity - 1)];
+    if (s.full.load(std::memory_order_acquire)) return false;
+    s.task = std::move(task);
+    s.full.store(true, std::memory_order_relaxed);
+    bottom_.store(b + 1);
+    return true;
+}
+
+// Only the last task can be contended: owner and thieves race for it on top_.
+bool WorkDeque::pop(Task& out) {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b);
+    std::int64_t t = top_.load();
+    if (t > b) {
+        bottom_.store(b + 1);
+        return false;
+    }
+    if (t == b) {
+        bool won = top_.compare_exchange_strong(t, t + 1);
+        bottom_.store(b + 1);
+        if (!won) return false;
+    }
+    out = take(slots_[b & (kCapacity - 1)]);
+    return true;
+}
+
+bool WorkDeque::steal(Task& out) {
+    std::int64_t t = top_.load();
+    const std::int64_t b = bottom_.load();
+    if (t >= b || !top_.compare_exchange_strong(t, t + 1)) return false;
+    out = take(slots_[t & (kCapacity - 1)]);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef CACHE_WORK_DEQUE_H
+#define CACHE_WORK_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "task.h"
+
+// Fixed-size Chase-Lev deque: its owner pushes and pops the newest task
+// without locking, other threads steal the oldest with one CAS. A slot is
+// reused only once whoever claimed its last task has moved it out, so push
+// fails when the deque is full rather than growing.
+class WorkDeque {
+public:
+    static constexpr std::size_t kCapacity = 256;
+
+    // Owner only. On failure `task` is left untouched.
+    bool push(Task& task);
+    bool pop(Task& out);
+
+    bool steal(Task& out);
+
+    bool empty() const { return top_.load() >= bottom_.load(); }
+
+private:
+    struct Slot {
+        std::atomic<bool> full{false};
+        Task              task;
+    };
+
+    static Task take(Slot& s);
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    Slot slots_[kCapacity];
+};
+
+#endif
@@ -33,6 +33,8 @@
 #include <cctype>
 // stoi which converts a string to an integer
 #include <cstdlib>
+// offsetof for the mount option table
+#include <cstddef>
 
 #include "cache/cache_manager.h"
 #include "backend/backend.h"
@@ -46,6 +48,143 @@ static string cacheDirectory;
 static string fileRemoteDirectory;
 static bool httpMode = false;
 
+// cache settings that can be passed as mount options (-o cache_block_size=N,cache_adaptive_blocks,cache_ram_size=N)
+struct cacheMountOptions {
+    size_t blockSize;
+    int adaptiveBlocks;
+    size_t ramSize;
+    int hugepages;
+    size_t migrateRate;
+    unsigned promoteHits;
+    size_t deviceSize;
+    size_t packMaxSize;
+    size_t inlineMaxSize;
+    size_t preallocMaxSize;
+    unsigned defragInterval;
+    size_t partSize;
+    size_t eagerMax;
+    size_t siblingDepth;
+    size_t siblingLead;
+};
+
+// key for the repeatable cache_tier=PATH[+PATH...][:SIZE] option (fastest tier first),
+// then one key per backend_rate_CLASS=BYTES[:REQUESTS] option (per second, in traffic class order)
+enum { KEY_CACHE_TIER = 1, KEY_RATE_FIRST };
+
+static const char* const rateOptionNames[cache_fs::kTrafficClasses] = {
+    "backend_rate_demand=", "backend_rate_metadata=", "backend_rate_prefetch=", "backend_rate_writeback="};
+
+static struct fuse_opt cacheOptionSpecs[] = {
+    {"cache_block_size=%zu", offsetof(cacheMountOptions, blockSize), 0},
+    {"cache_adaptive_blocks", offsetof(cacheMountOptions, adaptiveBlocks), 1},
+    {"cache_ram_size=%zu", offsetof(cacheMountOptions, ramSize), 0},
+    {"cache_hugepages", offsetof(cacheMountOptions, hugepages), 1},
+    {"cache_migrate_rate=%zu", offsetof(cacheMountOptions, migrateRate), 0},
+    {"cache_promote_hits=%u", offsetof(cacheMountOptions, promoteHits), 0},
+    {"cache_device_size=%zu", offsetof(cacheMountOptions, deviceSize), 0},
+    {"cache_pack_max=%zu", offsetof(cacheMountOptions, packMaxSize), 0},
+    {"cache_inline_max=%zu", offsetof(cacheMountOptions, inlineMaxSize), 0},
+    {"cache_prealloc_max=%zu", offsetof(cacheMountOptions, preallocMaxSize), 0},
+    {"cache_defrag_interval=%u", offsetof(cacheMountOptions, defragInterval), 0},
+    {"cache_part_size=%zu", offsetof(cacheMountOptions, partSize), 0},
+    {"cache_eager_max=%zu", offsetof(cacheMountOptions, eagerMax), 0},
+    {"cache_sibling_depth=%zu", offsetof(cacheMountOptions, siblingDepth), 0},
+    {"cache_sibling_lead=%zu", offsetof(cacheMountOptions, siblingLead), 0},
+    FUSE_OPT_KEY("cache_tier=", KEY_CACHE_TIER),
+    FUSE_OPT_KEY("backend_rate_demand=", KEY_RATE_FIRST + 0),
+    FUSE_OPT_KEY("backend_rate_metadata=", KEY_RATE_FIRST + 1),
+    FUSE_OPT_KEY("backend_rate_prefetch=", KEY_RATE_FIRST + 2),
+    FUSE_OPT_KEY("backend_rate_writeback=", KEY_RATE_FIRST + 3),
+    FUSE_OPT_END
+};
+
+// storage tiers from the mount options, each with its device roots (kept alive for the cache)
+static vector<vector<string>> tierRoots;
+static vector<size_t> tierCapacities;
+// origin limits per traffic class from the mount options (zero is unlimited)
+static cache_fs::RateLimit rateLimits[cache_fs::kTrafficClasses];
+
+// turns "100G" style sizes into bytes
+static bool parseSize(const string& text, size_t& bytes) {
+    char* end = nullptr;
+    unsigned long long value = strtoull(text.c_str(), &end, 10);
+    // no digits at all
+    if (end == text.c_str()) {
+        return false;
+    }
+    // optional K/M/G/T suffix
+    switch (toupper(static_cast<unsigned char>(*end))) {
+        case 'T': value <<= 10; // fall through
+        case 'G': value <<= 10; // fall through
+        case 'M': value <<= 10; // fall through
+        case 'K': value <<= 10; ++end; break;
+        default: break;
+    }
+    bytes = value;
+    return *end == '\0';
+}
+
+// reads BYTES[:REQUESTS], both per second, into a traffic class's limit
+static int parseRateOption(const char* arg, size_t cls) {
+    string value(arg + strlen(rateOptionNames[cls]));
+    size_t bytes = 0, requests = 0;
+    auto colon = value.find(':');
+    bool ok = parseSize(value.substr(0, colon), bytes);
+    if (ok && colon != string::npos) {
+        ok = parseSize(value.substr(colon + 1), requests);
+    }
+    if (!ok) {
+        fprintf(stderr, "bad rate in '%s' (expected BYTES[:REQUESTS] per second)\n", arg);
+        return -1;
+    }
+    rateLimits[cls].bytes_per_sec = static_cast<double>(bytes);
+    rateLimits[cls].requests_per_sec = static_cast<double>(requests);
+    return 0;
+}
+
+// collects cache_tier and backend_rate_* options, every other argument is left for fuse
+static int parseCacheOption(void*, const char* arg, int key, struct fuse_args*) {
+    if (key >= KEY_RATE_FIRST && key < KEY_RATE_FIRST + static_cast<int>(cache_fs::kTrafficClasses)) {
+        return parseRateOption(arg, key - KEY_RATE_FIRST);
+    }
+    if (key != KEY_CACHE_TIER) {
+        return 1;
+    }
+    // the part after cache_tier= is PATH or PATH:SIZE, where PATH may list several devices joined by '+'
+    string value(arg + strlen("cache_tier="));
+    size_t capacity = 0;
+    auto colon = value.rfind(':');
+    if (colon != string::npos) {
+        if (!parseSize(value.substr(colon + 1), capacity)) {
+            fprintf(stderr, "bad cache_tier size in '%s'\n", arg);
+            return -1;
+        }
+        value.resize(colon);
+    }
+    // split the devices the tier is striped across
+    vector<string> roots;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t plus = value.find('+', start);
+        if (plus == string::npos) {
+            plus = value.size();
+        }
+        roots.push_back(value.substr(start, plus - start));
+        start = plus + 1;
+    }
+    bool emptyRoot = false;
+    for (const string& root : roots) {
+        emptyRoot = emptyRoot || root.empty();
+    }
+    if (emptyRoot || roots.size() > CACHE_MAX_DEVICES || tierRoots.size() >= CACHE_MAX_TIERS) {
+        fprintf(stderr, "bad cache_tier '%s' (at most %d tiers of %d devices)\n", arg, CACHE_MAX_TIERS, CACHE_MAX_DEVICES);
+        return -1;
+    }
+    tierRoots.push_back(roots);
+    tierCapacities.push_back(capacity);
+    return 0;
+}
+
 // if there is a slash, keep it for the cache
 static string realCachePath(const char* path) {
 
@@ -127,7 +266,7 @@ static bool getFileInfo(const char* path, bool &isDirectory, off_t &size) {
 
     vector<char> buf(1024);
     string filePath = string("/info") + path;
-    ssize_t bytes = apiBackend->download(filePath, buf.data(), buf.size(), 0);
+    ssize_t bytes = cache_fs::backend_read_metadata(*apiBackend, filePath, buf.data(), buf.size());
     if (bytes < 0) {
         return false;
     }
@@ -175,7 +314,7 @@ static int getAttribute(const char* path, struct stat* stbuf, struct fuse_file_i
     // zero out the buffer
     memset(stbuf, 0, sizeof(*stbuf));
     // check if path is to the root directory
-    if (path == "/") {
+    if (strcmp(path, "/") == 0) {
         // gives root directory file permissions
         stbuf->st_mode = S_IFDIR | 0755;
         stbuf->st_nlink = 2;
@@ -189,6 +328,10 @@ static int getAttribute(const char* path, struct stat* stbuf, struct fuse_file_i
         if (stat(rp.c_str(), stbuf) == -1) {
             return -1;
         } else {
+            // let the cache size its blocks for this file
+            if (S_ISREG(stbuf->st_mode)) {
+                cache_hint_size(path, stbuf->st_size);
+            }
             return 0;
         }
     }
@@ -206,6 +349,8 @@ static int getAttribute(const char* path, struct stat* stbuf, struct fuse_file_i
             stbuf->st_mode = S_IFREG | 0644;
             stbuf->st_nlink = 1;
             stbuf->st_size = fsize;
+            // let the cache size its blocks for this file
+            cache_hint_size(path, fsize);
         }
         return 0;
     }
@@ -243,8 +388,8 @@ static int getStats(const char*, struct statvfs* stbuf) {
 
 static int readDirectory(const char* path, void* buf, fuse_fill_dir_t filler, off_t, struct fuse_file_info*, enum fuse_readdir_flags) {
 
-    // if the file path is corrupt, return an error
-    if (path != "/") {
+    // only the root is listed
+    if (strcmp(path, "/") != 0) {
         return -1;
     }
 
@@ -256,6 +401,8 @@ static int readDirectory(const char* path, void* buf, fuse_fill_dir_t filler, of
 
     // set of files
     set<string> directories;
+    // files listed by the remote server, which the cache may prefetch
+    set<string> remoteNames;
 
     // directory entry used in loops
     struct dirent* directoryEntry;
@@ -284,10 +431,11 @@ static int readDirectory(const char* path, void* buf, fuse_fill_dir_t filler, of
         vector<char> jsonBuffer(64 * 1024);
         string directoryPath = string("/list") + path;
         // bytes stores the downloaded bytes
-        ssize_t bytes = apiBackend->download(directoryPath, jsonBuffer.data(), jsonBuffer.size(), 0);
+        ssize_t bytes = cache_fs::backend_read_metadata(*apiBackend, directoryPath, jsonBuffer.data(), jsonBuffer.size());
         if (bytes > 0) {
             string json(jsonBuffer.data(), jsonBuffer.data() + bytes);
-            findJsonNames(json, directories);
+            findJsonNames(json, remoteNames);
+            directories.insert(remoteNames.begin(), remoteNames.end());
         }
     }
 
@@ -310,6 +458,15 @@ static int readDirectory(const char* path, void* buf, fuse_fill_dir_t filler, of
         filler(buf, n.c_str(), nullptr, 0, FUSE_FILL_DIR_PLUS);
     }
 
+    // the cache watches for the remote files being opened in this order (only reads in http mode use the cache)
+    if (httpMode) {
+        vector<const char*> names;
+        for (auto &n : remoteNames) {
+            names.push_back(n.c_str());
+        }
+        cache_note_directory(path, names.data(), names.size());
+    }
+
     return 0;
 
 }
@@ -342,7 +499,11 @@ static int removeFile(const char* path) {
 
 }
 
-static int openFile(const char*, struct fuse_file_info*) {
+static int openFile(const char* path, struct fuse_file_info*) {
+    // small files start downloading whole, ahead of the first read (only reads in http mode use the cache)
+    if (httpMode) {
+        cache_open_file(path);
+    }
     return 0;
 }
 
@@ -373,8 +534,12 @@ static int readFile(const char* path, char* buf, size_t sz, off_t off, struct fu
         // return number of bytes from file
         return (int)numBytes;
     }
-    // get number of bytes and download the contents of the file
-    ssize_t numBytes = dataBackend->download(path, buf, sz, off);
+    // read through the cache, which fetches the missing blocks (in parallel for wide reads)
+    ssize_t numBytes = cache_read_file(path, buf, sz, off);
+    // evicted entries are not refilled, so download the contents of the file directly
+    if (numBytes < 0) {
+        numBytes = cache_fs::backend_read_range(path, buf, sz, off, IoPriority::kDemand);
+    }
     if (numBytes < 0) {
         return -1;
     } else {
@@ -401,23 +566,27 @@ static int writeFile(const char* path, const char* buf, size_t sz, off_t off, st
         close(file);
         if (numBytes < 0) {
             return -1;
-        } else {
-            return (int)numBytes;
         }
+        // reads are served from the cache, so it takes the new bytes too
+        cache_store_file(path, buf, numBytes, off);
+        return (int)numBytes;
     }
     // get the number of bytes from the file
-    ssize_t numBytes = dataBackend->upload(path, buf, sz, off);
+    // the caller waits on this write, so it is not queued as write-back
+    ssize_t numBytes = cache_fs::backend_put_range(path, buf, sz, off, IoPriority::kDemand);
     if (numBytes < 0) {
         return -1;
-    } else {
-        return (int)numBytes;
     }
+    // reads are served from the cache, so it takes the new bytes too
+    cache_store_file(path, buf, numBytes, off);
+    return (int)numBytes;
 
 }
 
-static int releaseFiles(const char*, struct fuse_file_info*) {
+static int releaseFiles(const char* path, struct fuse_file_info*) {
 
-    // cleans files that are no longer used
+    // stops readahead for the file and cleans files that are no longer used
+    cache_close_file(path);
     cache_apply_eviction();
     return 0;
 
@@ -438,9 +607,48 @@ int main(int argc, char* argv[]) {
 
     // path must have been correct
     cacheDirectory = realPath;
-    // timeout cache at 60
-    if (cache_init(cacheDirectory.c_str(), 60) != 0) {
-        fprintf(stderr, "cache_init failed\n");
+
+    // declare fuse arguments
+    struct fuse_args args = FUSE_ARGS_INIT(argc - 2, argv + 2);
+    // start from the default cache settings
+    cache_options cacheOptions;
+    cache_default_options(&cacheOptions);
+    cacheMountOptions mountOptions = {cacheOptions.block_size, 0, cacheOptions.ram_bytes, 0,
+                                      cacheOptions.migrate_bytes_per_sec, cacheOptions.promote_hits, 0,
+                                      cacheOptions.pack_max_size, cacheOptions.inline_max_size,
+                                      cacheOptions.preallocate_max_size, cacheOptions.defrag_interval_sec,
+                                      cacheOptions.part_size, cacheOptions.eager_fetch_max,
+                                      cacheOptions.sibling_depth, cacheOptions.sibling_lead_bytes};
+    // take the cache options out of the arguments, fuse gets the rest
+    if (fuse_opt_parse(&args, &mountOptions, cacheOptionSpecs, parseCacheOption) == -1) {
+        return -1;
+    }
+    // hand over the storage tiers (none means one tier in the cache directory)
+    for (size_t i = 0; i < tierRoots.size(); i++) {
+        for (size_t d = 0; d < tierRoots[i].size(); d++) {
+            cacheOptions.tiers[i].roots[d] = tierRoots[i][d].c_str();
+        }
+        cacheOptions.tiers[i].nroots = static_cast<int>(tierRoots[i].size());
+        cacheOptions.tiers[i].capacity = tierCapacities[i];
+        cacheOptions.tiers[i].device_capacity = mountOptions.deviceSize;
+    }
+    cacheOptions.ntiers = static_cast<int>(tierRoots.size());
+    cacheOptions.migrate_bytes_per_sec = mountOptions.migrateRate;
+    cacheOptions.promote_hits = mountOptions.promoteHits;
+    cacheOptions.pack_max_size = mountOptions.packMaxSize;
+    cacheOptions.inline_max_size = mountOptions.inlineMaxSize;
+    cacheOptions.preallocate_max_size = mountOptions.preallocMaxSize;
+    cacheOptions.defrag_interval_sec = mountOptions.defragInterval;
+    cacheOptions.part_size = mountOptions.partSize;
+    cacheOptions.eager_fetch_max = mountOptions.eagerMax;
+    cacheOptions.sibling_depth = mountOptions.siblingDepth;
+    cacheOptions.sibling_lead_bytes = mountOptions.siblingLead;
+    cacheOptions.block_size = mountOptions.blockSize;
+    cacheOptions.adaptive_blocks = mountOptions.adaptiveBlocks;
+    cacheOptions.ram_bytes = mountOptions.ramSize;
+    cacheOptions.hugepages = mountOptions.hugepages;
+    if (cache_init_opts(cacheDirectory.c_str(), &cacheOptions) != 0) {
+        fprintf(stderr, "cache_init failed (block size must be a power of two from 4K to 64M, part size from 64M to 1T)\n");
         return -1;
     }
 
@@ -468,6 +676,11 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // limit each class of traffic to the origin
+    for (size_t c = 0; c < cache_fs::kTrafficClasses; c++) {
+        cache_fs::backend_set_rate_limit(static_cast<cache_fs::TrafficClass>(c), rateLimits[c]);
+    }
+
     // initializes the HTTP backend
     dataBackend = cache_fs::create_backend(url);
     if (!dataBackend) {
@@ -490,9 +703,9 @@ int main(int argc, char* argv[]) {
         .create   = createFile,
     };
 
-    // declare fuse arguments
-    struct fuse_args args = FUSE_ARGS_INIT(argc - 2, argv + 2);
     int ret = fuse_main(args.argc, args.argv, &operations, nullptr);
+    // free the arguments left over from option parsing
+    fuse_opt_free_args(&args);
 
     // cleanup cache at the end
     cache_cleanup();
@@ -33,7 +33,9 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    BlockStore blockStore(mountpoint + "/blocks", 4096);
+    cache_options options;
+    cache_default_options(&options);
+    BlockStore blockStore(mountpoint + "/blocks", options.block_size);
     if (!blockStore.init()) {
         std::cerr << "BlockStore::init() failed" << std::endl;
         return 1;
@@ -0,0 +1,64 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "cache/cache_manager.h"
+#include "cache/fs_layout.h"
+#include "cache/path_hash.h"
+
+static bool has_object(const char* path, unsigned shift) {
+    std::string name = path_hash_hex(path) + ".b" + std::to_string(shift);
+    struct stat st;
+    return ::stat(fs_layout::data_part_path("./cache_dir", name, 0).c_str(), &st) == 0;
+}
+
+static bool round_trip(const char* path, std::size_t size) {
+    std::vector<char> data(size), back(size);
+    for (std::size_t i = 0; i < size; ++i) data[i] = static_cast<char>('a' + i % 23);
+    if (cache_store_file(path, data.data(), size, 0) != 0) return false;
+    return cache_read_file(path, back.data(), size, 0) == static_cast<ssize_t>(size) &&
+           std::memcmp(data.data(), back.data(), size) == 0;
+}
+
+int main() {
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.block_size = 3000;
+    if (cache_init_opts("./cache_dir", &opts) != -EINVAL) {
+        std::cerr << "non power-of-two block size accepted\n";
+        return 1;
+    }
+    std::cout << "invalid block size rejected OK\n";
+
+    cache_default_options(&opts);
+    opts.adaptive_blocks = 1;
+    opts.pack_max_size = 0;
+    if (cache_init_opts("./cache_dir", &opts) != 0) {
+        std::cerr << "cache_init_opts failed\n";
+        return 1;
+    }
+
+    const struct { const char* path; std::size_t size_hint; unsigned shift; } cases[] = {
+        {"/small.cfg",  8 * 1024,           14},
+        {"/medium.bin", 0,                  16},
+        {"/large.mp4",  512ull * 1024 * 1024, 20},
+    };
+    for (auto& c : cases) {
+        if (c.size_hint) cache_hint_size(c.path, c.size_hint);
+        if (!round_trip(c.path, 40000)) {
+            std::cerr << "round trip failed for " << c.path << "\n";
+            return 1;
+        }
+        if (!has_object(c.path, c.shift)) {
+            std::cerr << c.path << " not stored with 2^" << c.shift << " byte blocks\n";
+            return 1;
+        }
+    }
+    std::cout << "per-file block sizes OK\n";
+
+    cache_cleanup();
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#include "cache/buffer_pool.h"
+
+static bool aligned(const BlockBuffer& b) {
+    return reinterpret_cast<std::uintptr_t>(b.data()) % BufferPool::kAlign == 0;
+}
+
+int main() {
+    BufferPool& pool = BufferPool::instance();
+
+    // Sizes round up to a power-of-two class of at least 4 KiB, and every
+    // buffer is page aligned.
+    const std::size_t sizes[][2] = {{1, 4096}, {4096, 4096}, {5000, 8192}, {65536, 65536},
+                                    {65537, 131072}, {3 << 20, 4 << 20}, {BufferPool::kMaxSize, BufferPool::kMaxSize}};
+    for (const auto& s : sizes) {
+        BlockBuffer b = pool.acquire(s[0]);
+        if (!b || b.size() != s[1] || !aligned(b)) {
+            std::cerr << "acquire(" << s[0] << ") gave " << b.size() << " bytes\n";
+            return 1;
+        }
+        std::memset(b.data(), 0x5a, b.size());
+    }
+    try {
+        pool.acquire(BufferPool::kMaxSize + 1);
+        return 1;
+    } catch (const std::bad_alloc&) {
+    }
+    std::cout << "size classes OK\n";
+
+    // A released buffer comes back to the same thread for the next acquire
+    // of its class; a moved-from buffer returns nothing.
+    {
+        char* p;
+        {
+            BlockBuffer a = pool.acquire(20000);
+            p = a.data();
+            BlockBuffer b = std::move(a);
+            if (a || b.data() != p) return 1;
+        }
+        BlockBuffer again = pool.acquire(32768);
+        if (again.data() != p) {
+            std::cerr << "thread cache did not reuse the buffer\n";
+            return 1;
+        }
+    }
+    std::cout << "thread cache OK\n";
+
+    // Buffers cached by a thread that exits go to the shared lists.
+    {
+        char* p = nullptr;
+        std::thread t([&] {
+            BlockBuffer b = pool.acquire(256 * 1024);
+            p = b.data();
+        });
+        t.join();
+        BlockBuffer b = pool.acquire(256 * 1024);
+        if (b.data() != p) {
+            std::cerr << "exited thread's buffer not shared\n";
+            return 1;
+        }
+    }
+    std::cout << "shared lists OK\n";
+
+    // With huge pages on, large buffers still come back usable and aligned,
+    // whether or not the kernel has huge pages to give.
+    pool.set_hugepages(true);
+    {
+        BlockBuffer b = pool.acquire(8 << 20);
+        if (!b || b.size() != (8u << 20) || !aligned(b)) return 1;
+        std::memset(b.data(), 1, b.size());
+    }
+    pool.set_hugepages(false);
+    std::cout << "huge pages OK\n";
+    std::cout << "Buffer pool test OK\n";
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "backend/backend.h"
+#include "cache/cache_manager.h"
+#include "cache/cache_stats.h"
+
+static constexpr std::size_t kChunk = 16 * 1024;
+static constexpr auto kFirstByteDelay = std::chrono::milliseconds(20);
+static constexpr auto kChunkDelay     = std::chrono::milliseconds(2);
+
+static std::map<std::string, std::vector<char>> g_files;
+static std::map<std::string, int> g_requests;
+static std::mutex g_mu;
+
+// Answers range GETs from g_files after a fixed delay, then a chunk at a
+// time, so the link has a round trip and a rate to measure.
+static void serve(int fd) {
+    char req[4096];
+    ssize_t n = ::recv(fd, req, sizeof(req) - 1, 0);
+    if (n > 0) {
+        req[n] = 0;
+        char path[256] = "";
+        std::sscanf(req, "GET %255s", path);
+        const std::vector<char>* data;
+        {
+            std::lock_guard<std::mutex> g(g_mu);
+            ++g_requests[path];
+            data = &g_files[path];
+        }
+        std::size_t first = 0, last = data->size() - 1;
+        if (const char* r = std::strstr(req, "Range: bytes=")) std::sscanf(r, "Range: bytes=%zu-%zu", &first, &last);
+        last = std::min(last, data->size() - 1);
+        std::string hdr = "HTTP/1.1 206 Partial Content\r\nContent-Length: " + std::to_string(last - first + 1) +
+                          "\r\nConnection: close\r\n\r\n";
+        ::send(fd, hdr.data(), hdr.size(), MSG_NOSIGNAL);
+        std::this_thread::sleep_for(kFirstByteDelay);
+        for (std::size_t off = first; off <= last; off += kChunk) {
+            if (off != first) std::this_thread::sleep_for(kChunkDelay);
+            std::size_t len = std::min(kChunk, last + 1 - off);
+            if (::send(fd, data->data() + off, len, MSG_NOSIGNAL) != static_cast<ssize_t>(len)) break;
+        }
+    }
+    ::close(fd);
+}
+
+static void add_file(const std::string& path, std::size_t size) {
+    std::vector<char>& data = g_files[path];
+    data.resize(size);
+    for (std::size_t i = 0; i < size; ++i) data[i] = static_cast<char>(i * 7 + path.size() + i / 4096);
+}
+
+static int requests(const std::string& path) {
+    std::lock_guard<std::mutex> g(g_mu);
+    return g_requests[path];
+}
+
+static bool read_all(const std::string& path) {
+    const std::vector<char>& want = g_files[path];
+    std::vector<char> got(want.size());
+    for (std::size_t off = 0; off < want.size(); off += 4096) {
+        std::size_t len = std::min<std::size_t>(4096, want.size() - off);
+        if (cache_read_file(path.c_str(), got.data() + off, len, off) != static_cast<ssize_t>(len)) return false;
+    }
+    return got == want;
+}
+
+int main() {
+    add_file("/cold.bin", 160 * 1024);
+    add_file("/warmup.bin", 512 * 1024);
+    add_file("/small.bin", 160 * 1024);
+    add_file("/large.bin", 4 * 1024 * 1024);
+
+    int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (lfd < 0 || ::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(lfd, 16) != 0 ||
+        ::getsockname(lfd, reinterpret_cast<sockaddr*>(&addr), &alen) != 0) {
+        std::cerr << "cannot listen\n";
+        return 1;
+    }
+    std::thread([lfd] {
+        for (;;) {
+            int fd = ::accept(lfd, nullptr, nullptr);
+            if (fd < 0) return;
+            std::thread(serve, fd).detach();
+        }
+    }).detach();
+
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    fs::create_directories("./cache_dir");
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.eager_fetch_max = 1024 * 1024;
+    if (cache_init_opts("./cache_dir", &opts) != 0) return 1;
+    if (!cache_fs::create_backend("http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)))) return 1;
+    for (const auto& f : g_files) cache_hint_size(f.first.c_str(), f.second.size());
+
+    // Before anything is measured only files of a block or so are fetched whole.
+    cache_stats st;
+    cache_open_file("/cold.bin");
+    cache_get_stats(&st);
+    if (st.eager_fetches != 0) {
+        std::cerr << "160 KiB file fetched whole on an unmeasured link\n";
+        return 1;
+    }
+
+    // Once the link is measured, the limit grows to a few bandwidth-delay
+    // products (here about 20 ms at 8 MB/s).
+    char buf[512 * 1024];
+    if (cache_read_file("/warmup.bin", buf, sizeof(buf), 0) != static_cast<ssize_t>(sizeof(buf))) return 1;
+    cache_fs::LinkEstimate link = cache_fs::backend_link_estimate();
+    std::cout << "link rtt " << link.rtt_sec * 1000 << " ms, " << link.bytes_per_sec / 1e6 << " MB/s\n";
+
+    // The first read, issued right after open, waits for the whole-file
+    // request rather than making its own.
+    cache_open_file("/small.bin");
+    if (!read_all("/small.bin") || requests("/small.bin") != 1) {
+        std::cerr << "small file took " << requests("/small.bin") << " requests or read wrong data\n";
+        return 1;
+    }
+    cache_get_stats(&st);
+    if (st.eager_fetches != 1) {
+        std::cerr << "expected one eager fetch, saw " << st.eager_fetches << "\n";
+        return 1;
+    }
+    std::cout << "small file in one request OK\n";
+
+    // Opening a cached file again fetches nothing.
+    cache_open_file("/small.bin");
+    cache_open_file("/large.bin");
+    cache_get_stats(&st);
+    if (st.eager_fetches != 1 || requests("/small.bin") != 1 || requests("/large.bin") != 0) {
+        std::cerr << "reopen or large file fetched eagerly\n";
+        return 1;
+    }
+    std::cout << "large and cached files left alone OK\n";
+
+    cache_cleanup();
+    ::shutdown(lfd, SHUT_RDWR);
+    ::close(lfd);
+    fs::remove_all("./cache_dir");
+    std::cout << "Eager fetch test OK\n";
+    return 0;
+}
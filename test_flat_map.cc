@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "cache/flat_hash_map.h"
+
+int main() {
+    FlatHashMap<std::uint64_t, std::uint64_t> flat;
+    std::unordered_map<std::uint64_t, std::uint64_t> ref;
+    std::mt19937_64 rng(42);
+
+    for (int op = 0; op < 2000000; ++op) {
+        std::uint64_t k = rng() % 50000;
+        switch (rng() % 3) {
+        case 0: flat[k] = op; ref[k] = op; break;
+        case 1: flat.erase(k); ref.erase(k); break;
+        default: {
+            auto it = flat.find(k);
+            auto rt = ref.find(k);
+            if ((it == flat.end()) != (rt == ref.end()) ||
+                (it != flat.end() && it->second != rt->second)) {
+                std::cerr << "lookup mismatch for key " << k << " at op " << op << "\n";
+                return 1;
+            }
+        }
+        }
+    }
+    if (flat.size() != ref.size()) {
+        std::cerr << "size mismatch: " << flat.size() << " vs " << ref.size() << "\n";
+        return 1;
+    }
+    std::size_t seen = 0;
+    for (auto& [k, v] : flat) {
+        if (ref.at(k) != v) { std::cerr << "iteration mismatch\n"; return 1; }
+        ++seen;
+    }
+    if (seen != ref.size()) { std::cerr << "iteration count mismatch\n"; return 1; }
+    std::cout << "uint64 keys vs unordered_map OK (" << flat.size() << " live)\n";
+
+    FlatHashMap<std::string, std::uint32_t> names;
+    for (std::uint32_t i = 0; i < 10000; ++i) names.emplace("/dir/file-" + std::to_string(i), i);
+    for (std::uint32_t i = 0; i < 10000; i += 2) names.erase("/dir/file-" + std::to_string(i));
+    for (std::uint32_t i = 0; i < 10000; ++i) {
+        bool has = names.contains("/dir/file-" + std::to_string(i));
+        if (has != (i % 2 == 1)) { std::cerr << "string key mismatch at " << i << "\n"; return 1; }
+    }
+    std::cout << "string keys OK\n";
+    return 0;
+}
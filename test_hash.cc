@@ -0,0 +1,35 @@
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "cache/path_hash.h"
+
+int main() {
+    // Object names are part of the on-disk layout: these values must never
+    // change without bumping fs_layout::kLayoutVersion.
+    const struct { const char* path; const char* hex; } golden[] = {
+        {"",             "b3a6fce0dab18bb942340d17fae15d8e"},
+        {"/",            "a13302a2d871ef7f503f101617bc395c"},
+        {"/foo/bar.txt", "9a438f456576e8c2965d09287bb80904"},
+    };
+    for (auto& g : golden) {
+        std::string got = path_hash_hex(g.path);
+        if (got != g.hex) {
+            std::cerr << "hash of \"" << g.path << "\" = " << got << ", expected " << g.hex << "\n";
+            return 1;
+        }
+    }
+    std::cout << "golden hashes OK\n";
+
+    std::set<std::string> seen;
+    for (int i = 0; i < 100000; ++i) {
+        std::string p = "/dataset/part-" + std::to_string(i) + std::string(i % 200, 'x');
+        std::string h = path_hash_hex(p);
+        if (h.size() != kPathHashHexLen || !seen.insert(h).second) {
+            std::cerr << "collision or bad length for " << p << "\n";
+            return 1;
+        }
+    }
+    std::cout << "100000 distinct paths OK\n";
+    return 0;
+}
@@ -89,7 +89,22 @@ int main() {
                   << std::string(buf2.data(), n2) << "\"\n";
     }
 
-    // 8) Cleanup
+    // 8) One request scattered across several buffers
+    {
+        char a[5], b[2], c[64];
+        iovec iov[3] = {{a, sizeof(a)}, {b, sizeof(b)}, {c, sizeof(c)}};
+        ssize_t n3 = cache_fs::backend_read_range("/" + fname, iov, 3, 0);
+        if (n3 != static_cast<ssize_t>(content.size()) ||
+            std::string(a, 5) + std::string(b, 2) + std::string(c, n3 - 7) != content) {
+            std::cerr << "scattered read failed (" << n3 << ")\n";
+            cache_cleanup();
+            kill(pid, SIGTERM); waitpid(pid, nullptr, 0);
+            return 1;
+        }
+        std::cout << "Scattered read OK\n";
+    }
+
+    // 9) Cleanup
     cache_cleanup();
     std::cout << "cache_cleanup OK\n";
 
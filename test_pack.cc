@@ -0,0 +1,192 @@
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "cache/cache_manager.h"
+#include "cache/fs_layout.h"
+#include "cache/pack_store.h"
+#include "cache/path_hash.h"
+
+static PackKey key_of(int i) {
+    PathHash h = path_hash128("/small/" + std::to_string(i));
+    return PackKey{h.hi, h.lo, 0, 12};
+}
+
+static std::string payload(int i, char tag) {
+    return std::string(100 + i % 900, static_cast<char>(tag + i % 26));
+}
+
+static bool verify(PackStore& pack, int from, int to, char tag) {
+    char buf[4096];
+    for (int i = from; i < to; ++i) {
+        std::string want = payload(i, tag);
+        ssize_t n = pack.read(key_of(i), buf, sizeof(buf));
+        if (n != static_cast<ssize_t>(want.size()) || std::memcmp(buf, want.data(), n) != 0) {
+            std::cerr << "record " << i << " lost or corrupted (" << n << ")\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::size_t count_files(const std::string& root, const std::string& ext) {
+    std::size_t n = 0;
+    for (auto& f : std::filesystem::recursive_directory_iterator(root))
+        if (f.path().extension() == ext) ++n;
+    return n;
+}
+
+int main() {
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    const std::string dir = fs_layout::pack_dir("./cache_dir");
+    constexpr int kRecords = 2000;
+
+    // Small segments so a few thousand records span many of them.
+    {
+        PackStore pack(dir, 64 * 1024);
+        if (!pack.init()) return 1;
+        for (int i = 0; i < kRecords; ++i) {
+            std::string p = payload(i, 'a');
+            if (pack.write(key_of(i), p.data(), p.size()) != static_cast<ssize_t>(p.size())) return 1;
+        }
+        if (!verify(pack, 0, kRecords, 'a')) return 1;
+        if (pack.stats().records != kRecords || pack.stats().segments < 10) {
+            std::cerr << "unexpected pack layout\n";
+            return 1;
+        }
+    }
+    std::cout << "packed writes OK\n";
+
+    // Rewrites and erases leave dead bytes that the cleaner reclaims.
+    {
+        PackStore pack(dir, 64 * 1024);
+        if (!pack.init() || !verify(pack, 0, kRecords, 'a')) return 1;
+        for (int i = 0; i < kRecords / 2; ++i) {
+            std::string p = payload(i, 'A');
+            pack.write(key_of(i), p.data(), p.size());
+        }
+        for (int i = kRecords / 2; i < kRecords * 3 / 4; ++i) pack.erase(key_of(i));
+        std::size_t before = pack.stats().segments;
+        while (pack.collect()) {}
+        PackStore::Stats st = pack.stats();
+        if (st.collected == 0 || st.segments >= before || st.dead_bytes * 2 > st.live_bytes) {
+            std::cerr << "cleaner reclaimed nothing (" << before << " -> " << st.segments << " segments)\n";
+            return 1;
+        }
+        if (!verify(pack, 0, kRecords / 2, 'A') || !verify(pack, kRecords * 3 / 4, kRecords, 'a')) return 1;
+    }
+    {
+        PackStore pack(dir, 64 * 1024);
+        if (!pack.init() || !verify(pack, 0, kRecords / 2, 'A') || !verify(pack, kRecords * 3 / 4, kRecords, 'a')) return 1;
+        char buf[4096];
+        for (int i = kRecords / 2; i < kRecords * 3 / 4; ++i) {
+            if (pack.read(key_of(i), buf, sizeof(buf)) != -ENOENT) {
+                std::cerr << "erased record " << i << " came back\n";
+                return 1;
+            }
+        }
+    }
+    std::cout << "segment cleaning OK\n";
+
+    // A damaged record reads as a miss.
+    fs::remove_all("./cache_dir");
+    {
+        PackStore pack(dir);
+        if (!pack.init()) return 1;
+        std::string p = payload(7, 'a');
+        pack.write(key_of(7), p.data(), p.size());
+        int fd = ::open(fs_layout::segment_path(dir, 0).c_str(), O_WRONLY);
+        ::pwrite(fd, "X", 1, 64);
+        ::close(fd);
+        char buf[4096];
+        if (pack.read(key_of(7), buf, sizeof(buf)) != -EIO || pack.read(key_of(7), buf, sizeof(buf)) != -ENOENT) {
+            std::cerr << "corrupt record served\n";
+            return 1;
+        }
+    }
+    std::cout << "checksums OK\n";
+
+    // An object's records go together, whatever their block size.
+    fs::remove_all("./cache_dir");
+    {
+        PackStore pack(dir);
+        if (!pack.init()) return 1;
+        PathHash h = path_hash128("/grown");
+        std::string p = payload(3, 'g');
+        for (std::uint32_t blk = 0; blk < 6; ++blk)
+            for (std::uint32_t shift : {12u, 16u}) pack.write(PackKey{h.hi, h.lo, blk, shift}, p.data(), p.size());
+        pack.write(key_of(9), p.data(), p.size());
+        if (pack.erase_object(h.hi, h.lo) != 12 || pack.stats().records != 1) {
+            std::cerr << "object not erased whole\n";
+            return 1;
+        }
+    }
+    {
+        PackStore pack(dir);
+        if (!pack.init() || pack.stats().records != 1) {
+            std::cerr << "erased object came back\n";
+            return 1;
+        }
+    }
+    std::cout << "object erase OK\n";
+
+    // Through the cache, small files land in segments, not part files.
+    fs::remove_all("./cache_dir");
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.inline_max_size = 0;
+    if (cache_init_opts("./cache_dir", &opts) != 0) return 1;
+    for (int i = 0; i < 50; ++i) {
+        std::string path = "/cfg/" + std::to_string(i) + ".json";
+        std::string data = payload(i, 'k');
+        std::vector<char> back(data.size());
+        cache_hint_size(path.c_str(), data.size());
+        if (cache_store_file(path.c_str(), data.data(), data.size(), 0) != 0 ||
+            cache_read_file(path.c_str(), back.data(), back.size(), 0) != static_cast<ssize_t>(data.size()) ||
+            std::memcmp(back.data(), data.data(), data.size()) != 0) {
+            std::cerr << "round trip failed for " << path << "\n";
+            return 1;
+        }
+    }
+    cache_stats st;
+    cache_get_stats(&st);
+    if (count_files("./cache_dir", ".blk") != 0 || count_files("./cache_dir", ".seg") != 1 || st.pack_records != 50) {
+        std::cerr << "small files not packed (" << st.pack_records << " records)\n";
+        return 1;
+    }
+    std::cout << "small files packed OK\n";
+
+    // A packed file that grows past pack_max_size moves out of the segments.
+    {
+        const std::string path = "/grow/" + std::to_string(::getpid()) + ".log";
+        std::string data = payload(1, 'x') + std::string(100 * 1024, 'y');
+        cache_hint_size(path.c_str(), data.size());
+        if (cache_store_file(path.c_str(), data.data(), data.size(), 0) != 0) return 1;
+        cache_get_stats(&st);
+        if (st.pack_records != 52) {
+            std::cerr << "grown file not packed (" << st.pack_records << " records)\n";
+            return 1;
+        }
+        std::string more(opts.pack_max_size, 'z');
+        if (cache_store_file(path.c_str(), more.data(), more.size(), data.size()) != 0) return 1;
+        data += more;
+        std::vector<char> back(data.size());
+        cache_get_stats(&st);
+        if (st.pack_records != 50 ||
+            cache_read_file(path.c_str(), back.data(), back.size(), 0) != static_cast<ssize_t>(data.size()) ||
+            std::memcmp(back.data(), data.data(), data.size()) != 0) {
+            std::cerr << "grown file still packed or lost (" << st.pack_records << " records)\n";
+            return 1;
+        }
+    }
+    std::cout << "grown files unpacked OK\n";
+
+    cache_cleanup();
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "cache/block_store.h"
+#include "cache/cache_manager.h"
+#include "cache/fs_layout.h"
+#include "cache/path_hash.h"
+
+static constexpr std::size_t kBlock  = 4096;
+static constexpr std::size_t kBlocks = 512;
+
+int cache_evict_gb(double gb);
+
+static std::string name_of(const char* path) {
+    return path_hash_hex(path) + ".b12";
+}
+
+static std::string part_of(const std::string& name) {
+    char path[fs_layout::kPathMax];
+    fs_layout::format_part_path(path, "./cache_dir", name, 0);
+    return path;
+}
+
+static long extents(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+    std::vector<char> mem(sizeof(fiemap) + 1024 * sizeof(fiemap_extent));
+    auto* fm = reinterpret_cast<fiemap*>(mem.data());
+    fm->fm_length       = FIEMAP_MAX_OFFSET;
+    fm->fm_extent_count = 1024;
+    long n = 0;
+    if (::ioctl(fd, FS_IOC_FIEMAP, fm) == 0)
+        for (unsigned i = 0; i < fm->fm_mapped_extents; ++i)
+            if (!(fm->fm_extents[i].fe_flags & FIEMAP_EXTENT_UNWRITTEN)) ++n;
+    ::close(fd);
+    return n;
+}
+
+static void sync_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    ::fdatasync(fd);
+    ::close(fd);
+}
+
+// Blocks of two objects written in turn, each forced to disk on its own, as
+// concurrent streams filling the cache would.
+static bool fill_interleaved(BlockStore& store, const std::string& a, const std::string& b, std::size_t skip) {
+    char buf[kBlock];
+    for (std::size_t i = 0; i < kBlocks; ++i) {
+        if (i == skip) continue;
+        for (const std::string* name : {&a, &b}) {
+            std::memset(buf, static_cast<char>('a' + i % 26), kBlock);
+            if (store.write(*name, buf, kBlock, i * kBlock, false) != static_cast<ssize_t>(kBlock)) return false;
+            sync_file(part_of(*name));
+        }
+    }
+    return true;
+}
+
+static bool verify(BlockStore& store, const std::string& name, std::size_t skip) {
+    char buf[kBlock];
+    for (std::size_t i = 0; i < kBlocks; ++i) {
+        if (i == skip) {
+            if (store.holds(name, i * kBlock)) {
+                std::cerr << "hole at block " << i << " filled in\n";
+                return false;
+            }
+            continue;
+        }
+        if (store.read(name, buf, kBlock, i * kBlock) != static_cast<ssize_t>(kBlock) ||
+            buf[0] != static_cast<char>('a' + i % 26) || buf[kBlock - 1] != buf[0]) {
+            std::cerr << "block " << i << " lost or corrupted\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    BlockStore store("./cache_dir", kBlock);
+    if (!store.init()) return 1;
+
+    // Reserved extents keep an object contiguous however its blocks arrive;
+    // unwritten blocks still read as absent.
+    const std::string reserved = name_of("/prealloc/reserved");
+    const std::string scattered = name_of("/prealloc/scattered");
+    if (!store.reserve(reserved, kBlocks * kBlock) || store.holds(reserved, 0)) {
+        std::cerr << "reserve failed or reads as data\n";
+        return 1;
+    }
+    if (!fill_interleaved(store, reserved, scattered, 5) || !verify(store, reserved, 5)) return 1;
+    long contiguous = extents(part_of(reserved));
+    long fragmented = extents(part_of(scattered));
+    if (contiguous > 4 || fragmented <= contiguous) {
+        std::cerr << "reserved object in " << contiguous << " extents, unreserved in " << fragmented << "\n";
+        return 1;
+    }
+    std::cout << "preallocation OK (" << contiguous << " vs " << fragmented << " extents)\n";
+
+    // The defragmenter rewrites only the fragmented file, keeping its data
+    // and holes.
+    if (store.defragment() != 1 || extents(part_of(scattered)) >= fragmented) {
+        std::cerr << "fragmented part file not rewritten\n";
+        return 1;
+    }
+    if (!verify(store, scattered, 5) || store.defragment() != 0) return 1;
+    for (auto& f : fs::recursive_directory_iterator("./cache_dir")) {
+        if (f.path().extension() == ".defrag") {
+            std::cerr << "temporary file left behind\n";
+            return 1;
+        }
+    }
+    std::cout << "defragmentation OK (" << extents(part_of(scattered)) << " extents)\n";
+
+    if (!store.delete_object(path_hash_hex("/prealloc/reserved")) || fs::exists(part_of(reserved))) return 1;
+    fs::remove_all("./cache_dir");
+
+    // Caching one block of a large file reserves all of it, and eviction
+    // counts the reserved space.
+    {
+        if (cache_init("./cache_dir", 0) != 0) return 1;
+        const std::string big = "/prealloc/" + std::to_string(::getpid());
+        const std::size_t size = 64 * 1024 * 1024;
+        cache_hint_size(big.c_str(), size);
+        std::vector<char> block(64 * 1024, 'z');
+        if (cache_store_file(big.c_str(), block.data(), block.size(), 0) != 0) return 1;
+        char part[fs_layout::kPathMax];
+        fs_layout::format_part_path(part, "./cache_dir", path_hash_hex(big) + ".b16", 0);
+        struct stat st{};
+        for (int i = 0; i < 500 && !(::stat(part, &st) == 0 && std::size_t(st.st_blocks) * 512 >= size); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (std::size_t(st.st_blocks) * 512 < size || std::size_t(st.st_size) > block.size()) {
+            std::cerr << "large file not reserved: " << st.st_blocks * 512 << " bytes allocated\n";
+            return 1;
+        }
+        cache_evict_gb(32.0 / 1024);
+        char c;
+        if (fs::exists(part) || cache_read_file(big.c_str(), &c, 1, 0) != -ENOENT) {
+            std::cerr << "reserved space not counted by eviction\n";
+            return 1;
+        }
+        cache_cleanup();
+        fs::remove_all("./cache_dir");
+    }
+    std::cout << "eviction of reserved space OK\n";
+    std::cout << "Prealloc test OK\n";
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cache/cache_manager.h"
+#include "cache/cache_stats.h"
+#include "cache/readahead.h"
+#include "cache/thread_pool.h"
+
+static constexpr std::size_t kBlock = 4096;
+
+static std::uint64_t loads() {
+    cache_stats st;
+    cache_get_stats(&st);
+    return st.disk_hits + st.backend_reads;
+}
+
+int main() {
+    // A bounded pool refuses prefetches once their queue is full and takes
+    // them again once a worker frees a slot. Demand work is never refused.
+    {
+        std::mutex m;
+        std::condition_variable cv;
+        bool open = false;
+        ThreadPool pool(1, 2);
+        pool.enqueue([&] {
+            std::unique_lock<std::mutex> l(m);
+            cv.wait(l, [&] { return open; });
+        });
+        while (pool.pending()) std::this_thread::yield();
+        std::atomic<int> ran{0};
+        bool a = pool.try_post([&] { ++ran; }, IoPriority::kPrefetch);
+        bool b = pool.try_post([&] { ++ran; }, IoPriority::kPrefetch);
+        bool c = pool.try_post([&] { ++ran; }, IoPriority::kPrefetch);
+        if (!a || !b || c || pool.pending() != 2) {
+            std::cerr << "bounded queue accepted " << a << b << c << "\n";
+            return 1;
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (!pool.try_post([&] { ++ran; })) {
+                std::cerr << "demand task refused\n";
+                return 1;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> l(m);
+            open = true;
+        }
+        cv.notify_all();
+        pool.enqueue([&] { ++ran; }, IoPriority::kPrefetch).wait();
+        if (ran != 7) return 1;
+    }
+    // A plan that could not be queued is asked for again on the next access.
+    {
+        Readahead ra;
+        ra.access(0, 0, 4, 32);
+        ra.access(1, 0, 4, 32);
+        Readahead::Plan p = ra.access(2, 0, 4, 32);
+        ra.retract(p);
+        Readahead::Plan again = ra.access(3, 0, 4, 32);
+        if (!p.count || ra.stats().issued != again.count || again.first != p.first + 1) {
+            std::cerr << "retracted plan not reissued\n";
+            return 1;
+        }
+    }
+    std::cout << "prefetch backpressure OK\n";
+
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    fs::create_directories("./cache_dir");
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.block_size = kBlock;
+    opts.pack_max_size = 0;
+    if (cache_init_opts("./cache_dir", &opts) != 0) return 1;
+
+    // Readers racing each other and readahead over a cold file fetch each
+    // block once.
+    const std::size_t blocks = 64;
+    {
+        std::ofstream("./cache_dir/cold.bin", std::ios::binary) << std::string(blocks * kBlock, 'c');
+    }
+    cache_hint_size("/cold.bin", blocks * kBlock);
+    std::uint64_t before = loads();
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 8; ++t) {
+        readers.emplace_back([&] {
+            char buf[kBlock];
+            for (std::size_t blk = 0; blk < blocks; ++blk) cache_read_file("/cold.bin", buf, kBlock, blk * kBlock);
+        });
+    }
+    for (auto& r : readers) r.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (loads() - before != blocks) {
+        std::cerr << "cold blocks fetched " << loads() - before << " times for " << blocks << "\n";
+        return 1;
+    }
+    std::cout << "in-flight dedup OK\n";
+
+    // Closing a file cancels its readahead and the loads behind it stop.
+    const std::size_t big = 4096;
+    {
+        std::ofstream("./cache_dir/big.bin", std::ios::binary) << std::string(big * kBlock, 'b');
+    }
+    cache_hint_size("/big.bin", big * kBlock);
+    char buf[kBlock];
+    for (std::size_t blk = 0; blk < 64; ++blk) cache_read_file("/big.bin", buf, kBlock, blk * kBlock);
+    if (cache_close_file("/big.bin") != 0 || cache_close_file("/never-opened") != 0) return 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::uint64_t settled = loads();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    cache_file_stats fst;
+    if (cache_get_file_stats("/big.bin", &fst) != 0 || loads() != settled || fst.prefetch_issued >= big) {
+        std::cerr << "prefetch continued after close: " << loads() - settled << " loads\n";
+        return 1;
+    }
+    std::cout << "cancel on close OK\n";
+    cache_cleanup();
+    fs::remove_all("./cache_dir");
+    std::cout << "Prefetch test OK\n";
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend/request_queue.h"
+#include "cache/thread_pool.h"
+
+using namespace std::chrono_literals;
+
+int main() {
+    // A free worker runs the most urgent queued task first, oldest first
+    // within a class.
+    {
+        std::mutex m;
+        std::condition_variable cv;
+        bool open = false;
+        std::vector<std::string> order;
+        ThreadPool pool(1);
+        pool.enqueue([&] {
+            std::unique_lock<std::mutex> l(m);
+            cv.wait(l, [&] { return open; });
+        });
+        while (pool.pending()) std::this_thread::yield();
+        auto note = [&](const char* what) { return [&order, what] { order.push_back(what); }; };
+        pool.enqueue(note("scrub"), IoPriority::kBackground);
+        pool.enqueue(note("prefetch1"), IoPriority::kPrefetch);
+        pool.enqueue(note("flush"), IoPriority::kWriteBack);
+        pool.enqueue(note("prefetch2"), IoPriority::kPrefetch);
+        auto last = pool.enqueue(note("demand"), IoPriority::kDemand);
+        if (pool.pending(IoPriority::kPrefetch) != 2 || pool.pending() != 5) return 1;
+        {
+            std::lock_guard<std::mutex> l(m);
+            open = true;
+        }
+        cv.notify_all();
+        while (pool.pending()) std::this_thread::sleep_for(1ms);
+        last.wait();
+        std::this_thread::sleep_for(10ms);
+        const std::vector<std::string> want{"demand", "prefetch1", "prefetch2", "flush", "scrub"};
+        if (order != want) {
+            std::cerr << "pool ran:";
+            for (auto& o : order) std::cerr << " " << o;
+            std::cerr << "\n";
+            return 1;
+        }
+    }
+    std::cout << "pool priorities OK\n";
+
+    // Prefetches filling the backend queue leave a slot for a demand read,
+    // and a waiting demand read goes before waiting prefetches.
+    {
+        cache_fs::RequestQueue q(4);
+        for (int i = 0; i < 3; ++i) q.acquire(IoPriority::kPrefetch);
+        std::atomic<bool> prefetched{false};
+        std::thread more([&] {
+            q.acquire(IoPriority::kPrefetch);
+            prefetched = true;
+        });
+        std::this_thread::sleep_for(20ms);
+        if (prefetched) {
+            std::cerr << "prefetch took the demand slot\n";
+            return 1;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        q.acquire(IoPriority::kDemand);
+        if (std::chrono::steady_clock::now() - t0 > 10ms) {
+            std::cerr << "demand read waited behind prefetches\n";
+            return 1;
+        }
+
+        std::atomic<bool> second_demand{false};
+        std::thread demand([&] {
+            q.acquire(IoPriority::kDemand);
+            second_demand = true;
+        });
+        std::this_thread::sleep_for(20ms);
+        q.release();   // the first demand read finishes
+        demand.join();
+        std::this_thread::sleep_for(20ms);
+        if (!second_demand || prefetched) {
+            std::cerr << "freed slot not given to the demand read\n";
+            return 1;
+        }
+        q.release();
+        q.release();   // a prefetch finishes
+        more.join();
+        if (!prefetched || q.active() != 3) return 1;
+        for (int i = 0; i < 3; ++i) q.release();
+    }
+    std::cout << "backend request priorities OK\n";
+    std::cout << "Priority test OK\n";
+    return 0;
+}
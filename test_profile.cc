@@ -0,0 +1,125 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "cache/cache_manager.h"
+#include "cache/cache_stats.h"
+
+static constexpr std::size_t kBlock = 64 * 1024;
+static constexpr std::size_t kBlocks = 256;
+
+static std::vector<char> g_data;
+
+static bool init() {
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.eager_fetch_max = 0;
+    return cache_init_opts("./cache_dir", &opts) == 0;
+}
+
+static bool read_blocks(const std::string& path, std::size_t first, std::size_t count) {
+    std::vector<char> buf(count * kBlock);
+    ssize_t n = cache_read_file(path.c_str(), buf.data(), buf.size(), first * kBlock);
+    return n == static_cast<ssize_t>(buf.size()) &&
+           std::equal(buf.begin(), buf.end(), g_data.begin() + first * kBlock);
+}
+
+static unsigned long long loaded(const cache_stats& st) { return st.disk_hits + st.backend_reads; }
+
+// Waits for the pool to load what the replay asked for, from the blocks
+// cached before the restart.
+static cache_stats settle(unsigned long long blocks) {
+    cache_stats st;
+    for (int i = 0; i < 200; ++i) {
+        cache_get_stats(&st);
+        if (loaded(st) >= blocks) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    cache_get_stats(&st);
+    return st;
+}
+
+// With no backend, blocks come from the file under the cache root.
+int main() {
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    // cache_meta.db outlives the run, so each run uses fresh paths.
+    const std::string dir = "/" + std::to_string(::getpid());
+    const std::string parquet = dir + "/data.parquet", scan = dir + "/scan.bin", other = dir + "/other.bin";
+    const std::string shared = dir + "/shared.bin";
+    fs::create_directories("./cache_dir" + dir);
+    g_data.resize(kBlocks * kBlock);
+    for (std::size_t i = 0; i < g_data.size(); ++i) g_data[i] = static_cast<char>(i * 11 + i / kBlock);
+    for (const std::string& p : {parquet, scan, other, shared}) std::ofstream("./cache_dir" + p).write(g_data.data(), g_data.size());
+    if (!init()) return 1;
+    for (const std::string& p : {parquet, scan, other, shared}) cache_hint_size(p.c_str(), g_data.size());
+
+    // Footer first, then two column chunks.
+    cache_open_file(parquet.c_str());
+    if (!read_blocks(parquet, kBlocks - 1, 1) || !read_blocks(parquet, 10, 3) || !read_blocks(parquet, 120, 1)) return 1;
+    cache_close_file(parquet.c_str());
+    // Scattered reads: only the first AccessProfile ranges are kept.
+    cache_open_file(scan.c_str());
+    for (std::size_t b = 0; b < 200; b += 2)
+        if (!read_blocks(scan, b, 1)) return 1;
+    cache_close_file(scan.c_str());
+
+    // After a restart the profile is replayed on open, before any read.
+    cache_cleanup();
+    if (!init()) return 1;
+    cache_open_file(parquet.c_str());
+    cache_stats st = settle(5);
+    if (st.profile_replays != 1 || st.profile_blocks != 5 || loaded(st) != 5) {
+        std::cerr << "replay prefetched " << st.profile_blocks << " blocks, loaded " << loaded(st) << "\n";
+        return 1;
+    }
+    const unsigned long long misses = st.ram_misses;
+    if (!read_blocks(parquet, kBlocks - 1, 1) || !read_blocks(parquet, 10, 3) || !read_blocks(parquet, 120, 1)) return 1;
+    cache_get_stats(&st);
+    if (st.ram_misses != misses) {
+        std::cerr << st.ram_misses - misses << " profiled reads missed RAM\n";
+        return 1;
+    }
+    cache_close_file(parquet.c_str());
+    std::cout << "profile replayed OK\n";
+
+    // Profiles are bounded, and files never read have none.
+    cache_open_file(other.c_str());
+    cache_close_file(other.c_str());
+    cache_open_file(scan.c_str());
+    cache_get_stats(&st);
+    if (st.profile_replays != 2 || st.profile_blocks != 5 + 64) {
+        std::cerr << "scattered profile replayed " << st.profile_blocks - 5 << " blocks\n";
+        return 1;
+    }
+    std::cout << "profile bounded OK\n";
+
+    // A file open twice records until its last close, and the first close
+    // does not cut the other handle's profile short.
+    cache_open_file(shared.c_str());
+    cache_open_file(shared.c_str());
+    if (!read_blocks(shared, 5, 1)) return 1;
+    cache_close_file(shared.c_str());
+    if (!read_blocks(shared, 40, 2)) return 1;
+    cache_close_file(shared.c_str());
+    cache_open_file(shared.c_str());
+    cache_get_stats(&st);
+    if (st.profile_replays != 3 || st.profile_blocks != 5 + 64 + 3) {
+        std::cerr << "profile of a file open twice replayed " << st.profile_blocks - 69 << " blocks\n";
+        return 1;
+    }
+    cache_close_file(shared.c_str());
+    std::cout << "overlapping opens OK\n";
+
+    settle(st.profile_blocks);
+    cache_cleanup();
+    fs::remove_all("./cache_dir");
+    std::cout << "Access profile test OK\n";
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "backend/backend.h"
+#include "cache/cache_manager.h"
+#include "cache/cache_stats.h"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr std::size_t kBlock = 1024 * 1024;
+static constexpr std::size_t kChunk = 64 * 1024;
+static constexpr auto kChunkDelay   = std::chrono::milliseconds(20);
+
+static std::vector<char> g_data;
+static std::atomic<int> g_requests{0};
+
+// Answers range GETs for any path with g_data, sent a chunk at a time to
+// stand in for a slow link.
+static void serve(int fd) {
+    char req[4096];
+    ssize_t n = ::recv(fd, req, sizeof(req) - 1, 0);
+    if (n > 0) {
+        req[n] = 0;
+        ++g_requests;
+        std::size_t first = 0, last = g_data.size() - 1;
+        if (const char* r = std::strstr(req, "Range: bytes=")) std::sscanf(r, "Range: bytes=%zu-%zu", &first, &last);
+        last = std::min(last, g_data.size() - 1);
+        std::string hdr = "HTTP/1.1 206 Partial Content\r\nContent-Length: " + std::to_string(last - first + 1) +
+                          "\r\nConnection: close\r\n\r\n";
+        ::send(fd, hdr.data(), hdr.size(), MSG_NOSIGNAL);
+        for (std::size_t off = first; off <= last; off += kChunk) {
+            std::this_thread::sleep_for(kChunkDelay);
+            std::size_t len = std::min(kChunk, last + 1 - off);
+            if (::send(fd, g_data.data() + off, len, MSG_NOSIGNAL) != static_cast<ssize_t>(len)) break;
+        }
+    }
+    ::close(fd);
+}
+
+static double ms_since(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+int main() {
+    g_data.resize(2 * kBlock);
+    for (std::size_t i = 0; i < g_data.size(); ++i) g_data[i] = static_cast<char>(i * 13 + i / 4096);
+
+    int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (lfd < 0 || ::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(lfd, 16) != 0 ||
+        ::getsockname(lfd, reinterpret_cast<sockaddr*>(&addr), &alen) != 0) {
+        std::cerr << "cannot listen\n";
+        return 1;
+    }
+    std::thread([lfd] {
+        for (;;) {
+            int fd = ::accept(lfd, nullptr, nullptr);
+            if (fd < 0) return;
+            std::thread(serve, fd).detach();
+        }
+    }).detach();
+
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    fs::create_directories("./cache_dir");
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.block_size = kBlock;
+    opts.pack_max_size = 0;
+    if (cache_init_opts("./cache_dir", &opts) != 0) return 1;
+    if (!cache_fs::create_backend("http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)))) return 1;
+    cache_hint_size("/slow.bin", g_data.size());
+
+    // A cold 4 KiB read returns once its bytes are in, long before the
+    // 16 chunks of its block.
+    const double full_block_ms = kBlock / kChunk * kChunkDelay.count();
+    char small[4096];
+    auto t0 = Clock::now();
+    ssize_t got = cache_read_file("/slow.bin", small, sizeof(small), 0);
+    double first_ms = ms_since(t0);
+    if (got != static_cast<ssize_t>(sizeof(small)) || !std::equal(small, small + got, g_data.begin())) {
+        std::cerr << "cold small read returned " << got << " bytes or wrong data\n";
+        return 1;
+    }
+    if (first_ms > full_block_ms / 2) {
+        std::cerr << "first 4 KiB took " << first_ms << " ms of a " << full_block_ms << " ms block\n";
+        return 1;
+    }
+    std::cout << "time to first byte " << first_ms << " ms (block " << full_block_ms << " ms) OK\n";
+
+    // A second reader further into the block waits for its own bytes on the
+    // same fetch.
+    got = cache_read_file("/slow.bin", small, sizeof(small), kBlock / 2);
+    if (got != static_cast<ssize_t>(sizeof(small)) || !std::equal(small, small + got, g_data.begin() + kBlock / 2)) {
+        std::cerr << "read behind the fill returned wrong data\n";
+        return 1;
+    }
+
+    // The rest of the block lands in the cache from that one request.
+    std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(full_block_ms)));
+    std::vector<char> whole(kBlock);
+    got = cache_read_file("/slow.bin", whole.data(), whole.size(), 0);
+    cache_stats st;
+    cache_get_stats(&st);
+    if (got != static_cast<ssize_t>(kBlock) || !std::equal(whole.begin(), whole.end(), g_data.begin()) ||
+        g_requests != 1 || st.backend_reads != 1) {
+        std::cerr << "block fetched by " << g_requests << " requests, " << st.backend_reads << " backend reads\n";
+        return 1;
+    }
+    std::cout << "background completion OK\n";
+
+    cache_cleanup();
+    ::shutdown(lfd, SHUT_RDWR);
+    ::close(lfd);
+    fs::remove_all("./cache_dir");
+    std::cout << "Progressive fill test OK\n";
+    return 0;
+}
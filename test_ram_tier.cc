@@ -0,0 +1,83 @@
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cache/buffer_pool.h"
+#include "cache/cache_manager.h"
+#include "cache/ram_tier.h"
+
+static RamTier::Handle put_block(RamTier& ram, BlockKey key, char fill) {
+    BlockBuffer buf = BufferPool::instance().acquire(4096);
+    std::memset(buf.data(), fill, 4096);
+    return ram.put(key, std::move(buf), 4096);
+}
+
+int main() {
+    // One shard of 16 blocks: 12 protected, the rest on probation.
+    RamTier ram(16 * 4096, 1);
+    for (BlockKey k = 0; k < 8; ++k) put_block(ram, k, 'a');
+    for (BlockKey k = 0; k < 8; ++k) ram.get(k);
+    RamTier::Handle held = ram.get(0);
+
+    // A scan of one-touch blocks must not push out the re-used set.
+    for (BlockKey k = 100; k < 200; ++k) put_block(ram, k, 's');
+    for (BlockKey k = 0; k < 8; ++k) {
+        if (!ram.get(k)) {
+            std::cerr << "hot block " << k << " flushed by scan\n";
+            return 1;
+        }
+    }
+    RamTier::Stats st = ram.stats();
+    if (st.bytes > ram.capacity() || st.blocks != 16) {
+        std::cerr << "budget exceeded: " << st.bytes << " bytes in " << st.blocks << " blocks\n";
+        return 1;
+    }
+    std::cout << "scan resistance and byte budget OK\n";
+
+    put_block(ram, 0, 'b');
+    ram.erase_object(0);
+    if (ram.get(0) || held->data()[0] != 'a' || held->len != 4096) {
+        std::cerr << "held handle changed or object not erased\n";
+        return 1;
+    }
+    std::cout << "handles outlive replacement OK\n";
+
+    RamTier shared(64 * 4096);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&shared, t] {
+            for (BlockKey k = 0; k < 20000; ++k) {
+                BlockKey key = make_block_key(t, k % 97);
+                if (!shared.get(key)) put_block(shared, key, static_cast<char>(t));
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    if (shared.stats().bytes > shared.capacity()) {
+        std::cerr << "sharded tier over budget\n";
+        return 1;
+    }
+    std::cout << "concurrent access OK\n";
+
+    if (cache_init("./cache_dir", 5) != 0) {
+        std::cerr << "cache_init failed\n";
+        return 1;
+    }
+    const char* path = "/hot.txt";
+    const char* data = "hot block contents";
+    char buf[64] = {0};
+    cache_store_file(path, data, std::strlen(data), 0);
+    cache_read_file(path, buf, std::strlen(data), 0);
+    cache_read_file(path, buf, std::strlen(data), 0);
+    cache_stats stats;
+    cache_get_stats(&stats);
+    if (std::strcmp(buf, data) != 0 || stats.ram_hits != 1 || stats.ram_misses != 1 || stats.disk_hits != 1) {
+        std::cerr << "unexpected stats: ram " << stats.ram_hits << "/" << stats.ram_misses
+                  << " disk " << stats.disk_hits << "\n";
+        return 1;
+    }
+    std::cout << "RAM hit ratio " << stats.ram_hit_ratio << " OK\n";
+    cache_cleanup();
+    return 0;
+}
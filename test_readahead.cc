@@ -0,0 +1,116 @@
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache/cache_manager.h"
+#include "cache/readahead.h"
+
+// Feeds `count` accesses from `first` at `stride` and returns the blocks
+// requested ahead, in order.
+static std::vector<std::size_t> drive(Readahead& ra, std::size_t first, long stride, std::size_t count,
+                                      std::size_t end = 0) {
+    std::vector<std::size_t> got;
+    for (std::size_t i = 0; i < count; ++i) {
+        Readahead::Plan p = ra.access(first + i * stride, end, 4, 32);
+        for (std::size_t k = 0; k < p.count; ++k) got.push_back(p.first + k * p.stride);
+    }
+    return got;
+}
+
+// Every requested block lies on the pattern, ahead of where it was asked.
+static bool on_pattern(const std::vector<std::size_t>& got, std::size_t first, long stride) {
+    for (std::size_t b : got) {
+        long steps = (static_cast<long>(b) - static_cast<long>(first)) / stride;
+        if (steps <= 0 || first + steps * stride != b) return false;
+    }
+    return !got.empty();
+}
+
+int main() {
+    // Sequential: the window ramps up to its cap and every block is used.
+    {
+        Readahead ra;
+        std::vector<std::size_t> got = drive(ra, 0, 1, 200);
+        if (!on_pattern(got, 0, 1) || ra.window() != 32 || ra.stats().hits < 150 || ra.stats().wasted != 0) {
+            std::cerr << "sequential: window " << ra.window() << " hits " << ra.stats().hits << "\n";
+            return 1;
+        }
+    }
+    // Backward and strided patterns are followed too, and stop at the file edges.
+    {
+        Readahead back;
+        std::vector<std::size_t> got = drive(back, 100, -1, 50);
+        if (!on_pattern(got, 100, -1) || back.stride() != -1) {
+            std::cerr << "backward pattern not followed\n";
+            return 1;
+        }
+        Readahead low;
+        for (std::size_t b : drive(low, 6, -1, 6)) {
+            if (b > 6) return 1;
+        }
+        Readahead strided;
+        got = drive(strided, 10, 7, 40, 200);
+        if (!on_pattern(got, 10, 7) || strided.stride() != 7) {
+            std::cerr << "strided pattern not followed\n";
+            return 1;
+        }
+        for (std::size_t b : got) {
+            if (b >= 200) {
+                std::cerr << "prefetch past end of file\n";
+                return 1;
+            }
+        }
+    }
+    // A broken pattern cancels what is outstanding and shrinks the window.
+    {
+        Readahead ra;
+        drive(ra, 0, 1, 40);
+        std::size_t window = ra.window();
+        std::uint32_t gen = ra.gen();
+        ra.access(5000, 0, 4, 32);
+        if (ra.gen() == gen || ra.stats().wasted == 0 || ra.window() >= window || ra.stride() != 0) {
+            std::cerr << "broken pattern not cancelled\n";
+            return 1;
+        }
+        std::uint64_t issued = ra.stats().issued;
+        drive(ra, 9000, 13, 1);
+        ra.access(20, 0, 4, 32);
+        if (ra.stats().issued != issued) {
+            std::cerr << "random access prefetched\n";
+            return 1;
+        }
+    }
+    std::cout << "readahead patterns OK\n";
+
+    // Through the cache, per-file counters report the pattern's accuracy.
+    std::filesystem::remove_all("./cache_dir");
+    cache_options opts;
+    cache_default_options(&opts);
+    opts.block_size = 4096;
+    opts.pack_max_size = 0;
+    if (cache_init_opts("./cache_dir", &opts) != 0) return 1;
+    const char* path = "/stream.bin";
+    std::vector<char> data(256 * 4096, 'r');
+    cache_hint_size(path, data.size());
+    cache_store_file(path, data.data(), data.size(), 0);
+    char buf[4096];
+    for (std::size_t blk = 0; blk < 128; ++blk) cache_read_file(path, buf, sizeof(buf), blk * 4096);
+    for (std::size_t blk : {200, 7, 150}) cache_read_file(path, buf, sizeof(buf), blk * 4096);
+
+    cache_file_stats fst;
+    cache_stats st;
+    if (cache_get_file_stats(path, &fst) != 0 || cache_get_file_stats("/never-read", &fst) != -ENOENT) return 1;
+    cache_get_file_stats(path, &fst);
+    cache_get_stats(&st);
+    if (fst.prefetch_accuracy < 0.5 || fst.prefetch_wasted_bytes == 0 || fst.prefetch_wasted_bytes % 4096 ||
+        st.prefetch_issued != fst.prefetch_issued || st.prefetch_hits != fst.prefetch_hits) {
+        std::cerr << "file stats: issued " << fst.prefetch_issued << " hits " << fst.prefetch_hits
+                  << " wasted " << fst.prefetch_wasted_bytes << "\n";
+        return 1;
+    }
+    std::cout << "per-file prefetch stats OK (accuracy " << fst.prefetch_accuracy << ")\n";
+    cache_cleanup();
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <arpa/inet.h>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "backend/backend.h"
+#include "cache/cache_manager.h"
+
+static std::map<std::string, std::vector<char>> g_files;
+static std::map<std::string, int> g_requests;
+static std::mutex g_mu;
+
+// Answers range GETs from a copy of g_files taken at request time.
+static void serve(int fd) {
+    char req[4096];
+    ssize_t n = ::recv(fd, req, sizeof(req) - 1, 0);
+    if (n > 0) {
+        req[n] = 0;
+        char path[256] = "";
+        std::sscanf(req, "GET %255s", path);
+        std::vector<char> data;
+        {
+            std::lock_guard<std::mutex> g(g_mu);
+            ++g_requests[path];
+            data = g_files[path];
+        }
+        std::size_t first = 0, last = data.size() - 1;
+        if (const char* r = std::strstr(req, "Range: bytes=")) std::sscanf(r, "Range: bytes=%zu-%zu", &first, &last);
+        last = std::min(last, data.size() - 1);
+        std::string hdr = "HTTP/1.1 206 Partial Content\r\nContent-Length: " + std::to_string(last - first + 1) +
+                          "\r\nConnection: close\r\n\r\n";
+        ::send(fd, hdr.data(), hdr.size(), MSG_NOSIGNAL);
+        ::send(fd, data.data() + first, last + 1 - first, MSG_NOSIGNAL);
+    }
+    ::close(fd);
+}
+
+static void set_file(const std::string& path, std::size_t size, char seed) {
+    std::lock_guard<std::mutex> g(g_mu);
+    std::vector<char>& data = g_files[path];
+    data.resize(size);
+    for (std::size_t i = 0; i < size; ++i) data[i] = static_cast<char>(seed + i * 7 + i / 4096);
+}
+
+static int requests(const std::string& path) {
+    std::lock_guard<std::mutex> g(g_mu);
+    return g_requests[path];
+}
+
+static bool read_all(const std::string& path) {
+    std::vector<char> want;
+    {
+        std::lock_guard<std::mutex> g(g_mu);
+        want = g_files[path];
+    }
+    std::vector<char> got(want.size());
+    for (std::size_t off = 0; off < want.size(); off += 32 * 1024) {
+        std::size_t len = std::min<std::size_t>(32 * 1024, want.size() - off);
+        if (cache_read_file(path.c_str(), got.data() + off, len, off) != static_cast<ssize_t>(len)) return false;
+    }
+    return got == want;
+}
+
+int main() {
+    int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (lfd < 0 || ::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(lfd, 16) != 0 ||
+        ::getsockname(lfd, reinterpret_cast<sockaddr*>(&addr), &alen) != 0) {
+        std::cerr << "cannot listen\n";
+        return 1;
+    }
+    std::thread([lfd] {
+        for (;;) {
+            int fd = ::accept(lfd, nullptr, nullptr);
+            if (fd < 0) return;
+            std::thread(serve, fd).detach();
+        }
+    }).detach();
+
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    fs::create_directories("./cache_dir");
+    auto init = [] {
+        cache_options opts;
+        cache_default_options(&opts);
+        return cache_init_opts("./cache_dir", &opts) == 0;
+    };
+    if (!init() || !cache_fs::create_backend("http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)))) return 1;
+
+    // cache_meta.db outlives the run, so each run uses a fresh path.
+    const std::string path = "/" + std::to_string(::getpid()) + "/app.log";
+    set_file(path, 100 * 1024, 'a');
+    cache_hint_size(path.c_str(), 100 * 1024);
+    if (!read_all(path)) return 1;
+    const int fetched = requests(path);
+    if (!read_all(path) || requests(path) != fetched) {
+        std::cerr << "second read not served from the cache\n";
+        return 1;
+    }
+
+    // The origin rewrites the file; its new size marks the cached copy stale.
+    set_file(path, 150 * 1024, 'b');
+    cache_hint_size(path.c_str(), 150 * 1024);
+    if (!read_all(path)) {
+        std::cerr << "stale blocks served after the origin changed\n";
+        return 1;
+    }
+    std::cout << "origin change OK\n";
+
+    // Bytes written through the cache are read back, and the origin
+    // reporting the size they made keeps them.
+    std::string patch(70 * 1024, 'w');
+    {
+        std::lock_guard<std::mutex> g(g_mu);
+        std::vector<char>& data = g_files[path];
+        data.resize(200 * 1024);
+        std::memcpy(data.data() + 130 * 1024, patch.data(), patch.size());
+    }
+    if (cache_store_file(path.c_str(), patch.data(), patch.size(), 130 * 1024) != 0) return 1;
+    cache_hint_size(path.c_str(), 200 * 1024);
+    const int before = requests(path);
+    if (!read_all(path) || requests(path) != before) {
+        std::cerr << "write not served from the cache (" << requests(path) - before << " requests)\n";
+        return 1;
+    }
+    std::cout << "write through OK\n";
+
+    // A change made while unmounted shows when the size is next reported.
+    cache_cleanup();
+    set_file(path, 120 * 1024, 'c');
+    if (!init()) return 1;
+    cache_hint_size(path.c_str(), 120 * 1024);
+    if (!read_all(path)) {
+        std::cerr << "stale blocks served after a restart\n";
+        return 1;
+    }
+    std::cout << "change across restart OK\n";
+
+    cache_cleanup();
+    ::shutdown(lfd, SHUT_RDWR);
+    ::close(lfd);
+    fs::remove_all("./cache_dir");
+    std::cout << "Stale data test OK\n";
+    return 0;
+}
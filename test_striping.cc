@@ -0,0 +1,105 @@
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache/block_store.h"
+#include "cache/path_hash.h"
+
+static constexpr std::size_t kBlock = 4096;
+
+static std::string name_of(int i) {
+    return path_hash_hex("/striped/" + std::to_string(i)) + ".b12";
+}
+
+// One block at the start of each of `stripes` stripes of `objects` objects.
+static bool fill(BlockStore& store, int objects, int stripes, char tag) {
+    char buf[kBlock];
+    for (int i = 0; i < objects; ++i) {
+        for (int s = 0; s < stripes; ++s) {
+            std::memset(buf, tag + (i + s) % 16, kBlock);
+            if (store.write(name_of(i), buf, kBlock, s * BlockStore::kStripeSize, false) != static_cast<ssize_t>(kBlock)) {
+                std::cerr << "write of object " << i << " stripe " << s << " failed\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool verify(BlockStore& store, int objects, int stripes, char tag) {
+    char buf[kBlock];
+    for (int i = 0; i < objects; ++i) {
+        for (int s = 0; s < stripes; ++s) {
+            char want = tag + (i + s) % 16;
+            if (store.read(name_of(i), buf, kBlock, s * BlockStore::kStripeSize) != static_cast<ssize_t>(kBlock) ||
+                buf[0] != want || buf[kBlock - 1] != want) {
+                std::cerr << "object " << i << " stripe " << s << " lost or corrupted\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    namespace fs = std::filesystem;
+    fs::remove_all("./cache_dir");
+    const std::vector<StoreRoot> roots = {{"./cache_dir/ssd0", 0}, {"./cache_dir/ssd1", 0}, {"./cache_dir/ssd2", 0}};
+
+    // Stripes spread over every device and are found again after a restart.
+    {
+        BlockStore store(roots, kBlock);
+        if (!store.init() || !fill(store, 16, 4, 'a') || !verify(store, 16, 4, 'a')) return 1;
+        for (auto& d : store.devices()) {
+            if (d.used < 8 * kBlock) {
+                std::cerr << "device " << d.root << " holds only " << d.used << " bytes\n";
+                return 1;
+            }
+        }
+    }
+    {
+        BlockStore store(roots, kBlock);
+        if (!store.init() || !verify(store, 16, 4, 'a')) return 1;
+        char buf[kBlock];
+        if (store.read(name_of(99), buf, kBlock, 0) >= 0 || store.holds(name_of(0), kBlock)) {
+            std::cerr << "unwritten block reported present\n";
+            return 1;
+        }
+    }
+
+    // A device at its cap takes no new stripes but keeps serving old ones.
+    fs::remove_all("./cache_dir");
+    {
+        std::vector<StoreRoot> capped = roots;
+        capped[0].capacity = 4 * kBlock;
+        BlockStore store(capped, kBlock);
+        if (!store.init() || !fill(store, 16, 4, 'a') || !verify(store, 16, 4, 'a')) return 1;
+        auto devs = store.devices();
+        if (devs[0].used > 5 * kBlock) {
+            std::cerr << "capped device grew to " << devs[0].used << " bytes\n";
+            return 1;
+        }
+        if (!fill(store, 16, 4, 'k') || !verify(store, 16, 4, 'k')) return 1;
+    }
+
+    // A device that fails is taken out and its stripes land elsewhere.
+    fs::remove_all("./cache_dir");
+    {
+        BlockStore store(roots, kBlock);
+        if (!store.init() || !fill(store, 16, 4, 'a')) return 1;
+        fs::remove_all("./cache_dir/ssd1");
+        char buf[kBlock];
+        for (int i = 0; i < 16; ++i) store.write(name_of(100 + i), buf, kBlock, 0, false);
+        if (store.devices()[1].healthy) {
+            std::cerr << "failed device still in use\n";
+            return 1;
+        }
+        if (!fill(store, 16, 4, 'k') || !verify(store, 16, 4, 'k')) return 1;
+    }
+
+    fs::remove_all("./cache_dir");
+    std::cout << "Striping test OK\n";
+    return 0;
+}
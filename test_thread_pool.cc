@@ -0,0 +1,92 @@
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cache/task.h"
+#include "cache/thread_pool.h"
+#include "cache/work_deque.h"
+
+int main() {
+    // Tasks hold move-only callables, small ones in place and large ones on
+    // the heap, and destroy them exactly once.
+    {
+        auto counter = std::make_shared<int>(0);
+        Task small([p = std::make_unique<int>(7), counter] { *counter += *p; });
+        char pad[200] = {1};
+        Task big([pad, counter] { *counter += pad[0]; });
+        Task moved(std::move(small));
+        if (small || !moved || !big) return 1;
+        moved();
+        big();
+        big = std::move(moved);
+        big();
+        big.reset();
+        if (*counter != 15 || counter.use_count() != 1) {
+            std::cerr << "task callables mishandled\n";
+            return 1;
+        }
+    }
+    std::cout << "task type OK\n";
+
+    // Owner and thieves racing on one deque take every task exactly once.
+    {
+        WorkDeque dq;
+        const int n = 200000;
+        std::vector<std::atomic<int>> runs(n);
+        std::atomic<bool> done{false};
+        std::vector<std::thread> thieves;
+        for (int t = 0; t < 3; ++t) {
+            thieves.emplace_back([&] {
+                Task got;
+                while (!done || !dq.empty()) {
+                    if (dq.steal(got)) got();
+                    else std::this_thread::yield();
+                }
+            });
+        }
+        Task got;
+        for (int i = 0; i < n; ++i) {
+            Task t([&runs, i] { ++runs[i]; });
+            while (!dq.push(t)) {
+                if (dq.pop(got)) got();
+            }
+            if (i % 3 == 0 && dq.pop(got)) got();
+        }
+        while (dq.pop(got)) got();
+        done = true;
+        for (auto& t : thieves) t.join();
+        for (int i = 0; i < n; ++i) {
+            if (runs[i] != 1) {
+                std::cerr << "task " << i << " ran " << runs[i] << " times\n";
+                return 1;
+            }
+        }
+    }
+    std::cout << "deque steal OK\n";
+
+    // Work a busy worker posts for itself is stolen by idle ones; the parent
+    // here only finishes once its children have run elsewhere.
+    {
+        ThreadPool pool(4);
+        std::atomic<int> children{0};
+        auto parent = pool.enqueue([&] {
+            for (int i = 0; i < 8; ++i) pool.post([&] { ++children; });
+            while (children < 8) std::this_thread::yield();
+        });
+        if (parent.wait_for(std::chrono::seconds(10)) != std::future_status::ready) {
+            std::cerr << "children of a busy worker were not stolen\n";
+            return 1;
+        }
+        std::atomic<int> ran{0};
+        for (int i = 0; i < 10000; ++i) pool.post([&] { ++ran; });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (ran < 10000 && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+        if (ran != 10000 || pool.pending()) return 1;
+    }
+    std::cout << "work stealing OK\n";
+    std::cout << "Thread pool test OK\n";
+    return 0;
+}
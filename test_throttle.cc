@@ -0,0 +1,118 @@
+#include <chrono>
+#include <iostream>
+
+#include "backend/rate_limiter.h"
+
+using cache_fs::RateLimiter;
+using cache_fs::TrafficClass;
+
+static double seconds_for(RateLimiter& l, TrafficClass cls, int n, std::size_t bytes) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) l.acquire(cls, bytes);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main() {
+    // Unlimited classes never wait.
+    {
+        RateLimiter l;
+        if (seconds_for(l, TrafficClass::kPrefetch, 1000, 1 << 20) > 0.1 || l.stats(TrafficClass::kPrefetch).throttled)
+            return 1;
+    }
+    std::cout << "unlimited OK\n";
+
+    // 20 requests a second: a second's burst goes at once, the next five
+    // are spaced 50 ms apart.
+    {
+        RateLimiter l;
+        l.set_limit(TrafficClass::kPrefetch, {0, 20});
+        double sec = seconds_for(l, TrafficClass::kPrefetch, 25, 0);
+        cache_fs::ThrottleStats s = l.stats(TrafficClass::kPrefetch);
+        if (sec < 0.2 || sec > 1.0 || s.throttled != 5 || s.requests != 25 || s.wait_sec <= 0) {
+            std::cerr << "request rate: " << sec << " s, " << s.throttled << " throttled\n";
+            return 1;
+        }
+    }
+    std::cout << "request rate OK\n";
+
+    // 1 MiB/s: two 512 KiB uploads empty the bucket, the third goes into
+    // debt and the fourth waits for it to be paid, about half a second.
+    {
+        RateLimiter l;
+        l.set_limit(TrafficClass::kWriteBack, {1 << 20, 0});
+        double sec = seconds_for(l, TrafficClass::kWriteBack, 4, 512 * 1024);
+        if (sec < 0.4 || sec > 1.5) {
+            std::cerr << "byte rate: " << sec << " s\n";
+            return 1;
+        }
+    }
+    std::cout << "byte rate OK\n";
+
+    // Prefetch borrows what idle demand leaves above half its bucket, and
+    // demand still has that half for itself.
+    {
+        RateLimiter l;
+        l.set_limit(TrafficClass::kDemand, {0, 100});
+        l.set_limit(TrafficClass::kPrefetch, {0, 10});
+        double sec = seconds_for(l, TrafficClass::kPrefetch, 55, 0);
+        cache_fs::ThrottleStats s = l.stats(TrafficClass::kPrefetch);
+        if (sec > 0.3 || s.borrowed < 40) {
+            std::cerr << "borrowing: " << sec << " s, " << s.borrowed << " borrowed\n";
+            return 1;
+        }
+        if (seconds_for(l, TrafficClass::kDemand, 45, 0) > 0.1 || l.stats(TrafficClass::kDemand).throttled) {
+            std::cerr << "demand lost its reserve\n";
+            return 1;
+        }
+    }
+    std::cout << "borrowing OK\n";
+
+    // A transfer larger than the lender's surplus takes only the surplus;
+    // the borrower owes the rest and demand keeps half its bucket.
+    {
+        RateLimiter l;
+        l.set_limit(TrafficClass::kDemand, {1 << 20, 0});
+        l.set_limit(TrafficClass::kPrefetch, {64 * 1024, 0});
+        l.acquire(TrafficClass::kPrefetch, 64 * 1024);
+        if (seconds_for(l, TrafficClass::kPrefetch, 1, 64 << 20) > 0.1 || l.stats(TrafficClass::kPrefetch).borrowed != 1)
+            return 1;
+        if (seconds_for(l, TrafficClass::kDemand, 2, 256 * 1024) > 0.1 || l.stats(TrafficClass::kDemand).throttled) {
+            std::cerr << "large prefetch left demand below half its bucket\n";
+            return 1;
+        }
+        if (seconds_for(l, TrafficClass::kPrefetch, 1, 0) < 0.5) {
+            std::cerr << "prefetch did not pay for what it did not borrow\n";
+            return 1;
+        }
+    }
+    std::cout << "borrowing bounded OK\n";
+
+    // Borrowing only goes down: demand never takes prefetch's tokens.
+    {
+        RateLimiter l;
+        l.set_limit(TrafficClass::kDemand, {0, 10});
+        l.set_limit(TrafficClass::kPrefetch, {0, 1000});
+        double sec = seconds_for(l, TrafficClass::kDemand, 13, 0);
+        if (sec < 0.2 || l.stats(TrafficClass::kDemand).borrowed) {
+            std::cerr << "demand borrowed from prefetch\n";
+            return 1;
+        }
+    }
+    std::cout << "borrow direction OK\n";
+
+    // Metadata bytes charged after the response hold back the next lookup.
+    {
+        RateLimiter l;
+        l.set_limit(TrafficClass::kMetadata, {64 * 1024, 0});
+        l.acquire(TrafficClass::kMetadata, 0);
+        l.charge(TrafficClass::kMetadata, 96 * 1024);
+        double sec = seconds_for(l, TrafficClass::kMetadata, 1, 0);
+        if (sec < 0.3 || l.stats(TrafficClass::kMetadata).bytes != 96 * 1024) {
+            std::cerr << "charged bytes: " << sec << " s\n";
+            return 1;
+        }
+    }
+    std::cout << "charged bytes OK\n";
+    std::cout << "Throttle test OK\n";
+    return 0;
+}
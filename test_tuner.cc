@@ -0,0 +1,82 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "backend/inflight_tuner.h"
+#include "backend/request_queue.h"
+
+using namespace std::chrono_literals;
+
+int main() {
+    // Without a measured rate the limit stays where it started.
+    {
+        cache_fs::InflightTuner t(2, 16, 4);
+        for (int i = 0; i < 40; ++i) t.complete(0.05, 64 * 1024, cache_fs::LinkEstimate{});
+        if (t.stats().limit != 4) {
+            std::cerr << "limit moved without a rate: " << t.stats().limit << "\n";
+            return 1;
+        }
+    }
+    std::cout << "unmeasured link OK\n";
+
+    // 50 ms and 10 MB/s hold 500 KB in flight: 1 + 500000 / 65536 rounds up
+    // to 9 requests of 64 KiB. The limit climbs there and stays.
+    cache_fs::InflightTuner t(2, 16, 4);
+    const cache_fs::LinkEstimate link{0.05, 10e6, 100};
+    for (int i = 0; i < 200; ++i) t.complete(0.05, 64 * 1024, link);
+    cache_fs::InflightStats s = t.stats();
+    if (s.target != 9 || s.limit != 9 || s.backoffs) {
+        std::cerr << "limit " << s.limit << " target " << s.target << " backoffs " << s.backoffs << "\n";
+        return 1;
+    }
+    std::cout << "additive increase OK\n";
+
+    // Requests waiting well past the usual time to first byte halve it
+    // within two windows of completions.
+    for (int i = 0; i < 18 && !t.stats().backoffs; ++i) t.complete(0.4, 64 * 1024, link);
+    s = t.stats();
+    if (s.limit != 4 || s.backoffs != 1) {
+        std::cerr << "after queueing: limit " << s.limit << " backoffs " << s.backoffs << "\n";
+        return 1;
+    }
+    for (int i = 0; i < 100; ++i) t.complete(0.4, 64 * 1024, link);
+    if (t.stats().limit != 2) return 1;
+    std::cout << "multiplicative decrease OK\n";
+
+    // Growing the request queue admits a waiting prefetch at once.
+    {
+        cache_fs::RequestQueue q(4);
+        for (int i = 0; i < 3; ++i) q.acquire(IoPriority::kPrefetch);
+        std::atomic<bool> prefetched{false};
+        std::thread more([&] {
+            q.acquire(IoPriority::kPrefetch);
+            prefetched = true;
+        });
+        std::this_thread::sleep_for(20ms);
+        if (prefetched) return 1;
+        q.resize(8);
+        more.join();
+        if (q.active() != 4) return 1;
+        // Shrinking lets running requests finish but starts no new one
+        // until they are under the new count.
+        q.resize(2);
+        for (int i = 0; i < 2; ++i) q.release();
+        std::atomic<bool> admitted{false};
+        std::thread demand([&] {
+            q.acquire(IoPriority::kDemand);
+            admitted = true;
+        });
+        std::this_thread::sleep_for(20ms);
+        if (admitted) {
+            std::cerr << "request started over the shrunk limit\n";
+            return 1;
+        }
+        q.release();
+        demand.join();
+        for (int i = 0; i < 2; ++i) q.release();
+    }
+    std::cout << "queue resize OK\n";
+    std::cout << "Tuner test OK\n";
+    return 0;
+}